@@ -0,0 +1,111 @@
+#include "archive_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void InitArchiveList(ArchiveList* list) {
+    memset(list, 0, sizeof(*list));
+    list->activeIndex = -1;
+}
+
+void FreeArchiveList(ArchiveList* list) {
+    free(list->entries);
+    free(list->pool);
+    InitArchiveList(list);
+}
+
+Bool LoadArchiveManifest(ArchiveList* list, char* blob, size_t length) {
+    ArchiveManifestHeader header;
+    if (length < sizeof(header)) {
+        printf("Archive manifest too short\n");
+        return FALSE;
+    }
+    memcpy(&header, blob, sizeof(header));
+
+    if (memcmp(header.magic, ARCHIVE_MANIFEST_MAGIC, 4) != 0 || header.headerSize != sizeof(header)) {
+        printf("Not an archive manifest\n");
+        return FALSE;
+    }
+    if (header.version != ARCHIVE_MANIFEST_VERSION) {
+        printf("Archive manifest version %d, expected %d\n", header.version, ARCHIVE_MANIFEST_VERSION);
+        return FALSE;
+    }
+    size_t stringBase = sizeof(header) + (size_t) header.entryCount * sizeof(ArchiveManifestEntry);
+    if ((uint64_t) stringBase + header.stringPoolSize != length) {
+        printf("Archive manifest size mismatch\n");
+        return FALSE;
+    }
+    if (HashBytes(blob + sizeof(header), length - sizeof(header)) != header.checksum) {
+        printf("Archive manifest checksum mismatch\n");
+        return FALSE;
+    }
+
+    ArchiveEntry* entries = (ArchiveEntry*) malloc((header.entryCount ? header.entryCount : 1) * sizeof(ArchiveEntry));
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        ArchiveManifestEntry record;
+        memcpy(&record, blob + sizeof(header) + i * sizeof(record), sizeof(record));
+
+        // both strings have to end inside the pool, on their terminator
+        if ((uint64_t) record.nameOffset + record.nameLength >= header.stringPoolSize ||
+            (uint64_t) record.pathOffset + record.pathLength >= header.stringPoolSize ||
+            blob[stringBase + record.nameOffset + record.nameLength] != '\0' ||
+            blob[stringBase + record.pathOffset + record.pathLength] != '\0') {
+            printf("Archive manifest entry %u is malformed\n", i);
+            free(entries);
+            return FALSE;
+        }
+
+        // offsets are kept relative to the blob, which becomes the pool
+        entries[i] = (ArchiveEntry){
+                .nameOffset = (uint32_t) stringBase + record.nameOffset,
+                .nameLength = record.nameLength,
+                .pathOffset = (uint32_t) stringBase + record.pathOffset,
+                .pathLength = record.pathLength,
+        };
+    }
+
+    FreeArchiveList(list);
+    list->entries = entries;
+    list->count = (int) header.entryCount;
+    list->capacity = list->count;
+    list->pool = blob;
+    list->poolSize = length;
+    list->poolCapacity = length;
+    list->activeIndex = list->count > 0 ? 0 : -1;
+    return TRUE;
+}
+
+static uint32_t AppendToPool(ArchiveList* list, const char* text, size_t length) {
+    if (list->poolSize + length + 1 > list->poolCapacity) {
+        size_t capacity = list->poolCapacity ? list->poolCapacity : 1024;
+        while (list->poolSize + length + 1 > capacity) capacity *= 2;
+        list->pool = (char*) realloc(list->pool, capacity);
+        list->poolCapacity = capacity;
+    }
+
+    uint32_t offset = (uint32_t) list->poolSize;
+    memcpy(list->pool + offset, text, length);
+    list->pool[offset + length] = '\0';
+    list->poolSize += length + 1;
+    return offset;
+}
+
+void AddArchive(ArchiveList* list, const char* name, const char* path) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 64;
+        list->entries = (ArchiveEntry*) realloc(list->entries, list->capacity * sizeof(ArchiveEntry));
+    }
+
+    ArchiveEntry* entry = &list->entries[list->count];
+    entry->nameLength = (uint32_t) strlen(name);
+    entry->nameOffset = AppendToPool(list, name, entry->nameLength);
+    entry->pathLength = (uint32_t) strlen(path);
+    entry->pathOffset = AppendToPool(list, path, entry->pathLength);
+
+    // the first entry is the main page, open at startup
+    if (list->count == 0) {
+        list->activeIndex = 0;
+    }
+    list->count++;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <clay.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+// Archive manifest written by gen_archive_list.py, loaded in one piece at startup.
+// Layout (little endian): header, entry records, string pool of NUL-terminated names and paths.
+#define ARCHIVE_MANIFEST_MAGIC "BARC"
+#define ARCHIVE_MANIFEST_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t entryCount;
+    uint32_t stringPoolSize;
+    uint64_t checksum; // HashBytes over everything after the header
+} ArchiveManifestHeader;
+
+typedef struct {
+    uint32_t nameOffset; // into the string pool
+    uint32_t nameLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+} ArchiveManifestEntry;
+
+// Offsets rather than pointers, so the pool can grow as entries are added
+typedef struct {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+} ArchiveEntry;
+
+// Every archive entry, their strings in one pool; both grow as needed
+typedef struct {
+    ArchiveEntry* entries;
+    int count;
+    int capacity;
+
+    char* pool;
+    size_t poolSize;
+    size_t poolCapacity;
+
+    int activeIndex; // -1 when no entry is open
+} ArchiveList;
+
+void InitArchiveList(ArchiveList* list);
+void FreeArchiveList(ArchiveList* list);
+
+// Replaces the list with the manifest's entries. Takes ownership of blob on success, whose strings then serve as the
+// pool as they are; on failure the caller still owns it.
+Bool LoadArchiveManifest(ArchiveList* list, char* blob, size_t length);
+void AddArchive(ArchiveList* list, const char* name, const char* path);
+
+static inline Clay_String GetArchiveName(const ArchiveList* list, int index) {
+    const ArchiveEntry* entry = &list->entries[index];
+    return (Clay_String){.length = (int32_t) entry->nameLength, .chars = list->pool + entry->nameOffset};
+}
+
+// NUL-terminated
+static inline const char* GetArchivePath(const ArchiveList* list, int index) {
+    return list->pool + list->entries[index].pathOffset;
+}
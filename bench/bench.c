@@ -0,0 +1,553 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <clay.h>
+
+#include "font_loader.h"
+#include "markdown.h"
+#include "preprocess.h"
+#include "renderer.c"
+#include "util.h"
+
+// Headless benchmark for the markdown -> RenderCommand -> Clay layout pipeline.
+// Nothing here opens a window: fonts are fixed-metric stand-ins for the canvas atlases,
+// so the numbers reflect preprocessing, parsing, measuring and layout cost only.
+
+#define BENCH_VIEWPORT_WIDTH 1280
+#define BENCH_VIEWPORT_HEIGHT 800
+
+#define BENCH_CJK_BASE 0x4E00
+#define BENCH_CJK_GLYPHS 3500
+
+/* ---------- allocation accounting ---------- */
+
+// atomic since parse-parallel allocates from several threads
+static _Atomic size_t benchAllocCount = 0;
+static _Atomic size_t benchAllocBytes = 0;
+
+#if defined(__GLIBC__)
+// Interpose the allocator for the whole process (cmark included) and forward to glibc.
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    benchAllocCount++;
+    benchAllocBytes += size;
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    benchAllocCount++;
+    benchAllocBytes += count * size;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    benchAllocCount++;
+    benchAllocBytes += size;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+#define BENCH_ALLOC_TRACKING 1
+#else
+#define BENCH_ALLOC_TRACKING 0
+#endif
+
+typedef struct {
+    double startTime;
+    size_t startAllocCount;
+    size_t startAllocBytes;
+} PhaseProbe;
+
+typedef struct {
+    double milliseconds;
+    size_t allocCount;
+    size_t allocBytes;
+} PhaseResult;
+
+static double NowMilliseconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static PhaseProbe BeginPhase() {
+    return (PhaseProbe){
+            .startTime = NowMilliseconds(),
+            .startAllocCount = benchAllocCount,
+            .startAllocBytes = benchAllocBytes,
+    };
+}
+
+static PhaseResult EndPhase(PhaseProbe probe) {
+    return (PhaseResult){
+            .milliseconds = NowMilliseconds() - probe.startTime,
+            .allocCount = benchAllocCount - probe.startAllocCount,
+            .allocBytes = benchAllocBytes - probe.startAllocBytes,
+    };
+}
+
+/* ---------- corpus generation ---------- */
+
+typedef enum {
+    CORPUS_PROSE,
+    CORPUS_CJK,
+    CORPUS_LISTS,
+    CORPUS_CODE,
+    CORPUS_KIND_COUNT,
+} CorpusKind;
+
+static const char* corpusKindNames[CORPUS_KIND_COUNT] = {"prose", "cjk", "lists", "code"};
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+    uint32_t seed;
+} Corpus;
+
+static const char* latinWords[] = {
+        "the", "renderer", "layout", "of", "markdown", "glyph", "atlas", "and", "a", "scroll",
+        "container", "measures", "every", "word", "before", "drawing", "it", "with", "clay", "raylib",
+        "webassembly", "performance", "is", "not", "optional", "when", "posts", "grow", "long", "enough",
+};
+
+static uint32_t NextRandom(Corpus* corpus) {
+    // xorshift32, deterministic so runs are comparable
+    uint32_t x = corpus->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    corpus->seed = x;
+    return x;
+}
+
+static void CorpusAppend(Corpus* corpus, const char* text, size_t length) {
+    if (corpus->length + length + 1 > corpus->capacity) {
+        while (corpus->length + length + 1 > corpus->capacity) {
+            corpus->capacity = corpus->capacity ? corpus->capacity * 2 : 4096;
+        }
+        corpus->data = (char*) realloc(corpus->data, corpus->capacity);
+    }
+    memcpy(corpus->data + corpus->length, text, length);
+    corpus->length += length;
+    corpus->data[corpus->length] = '\0';
+}
+
+static void CorpusAppendString(Corpus* corpus, const char* text) {
+    CorpusAppend(corpus, text, strlen(text));
+}
+
+static void CorpusAppendCodepoint(Corpus* corpus, int codepoint) {
+    int byteCount = 0;
+    const char* utf8 = CodepointToUTF8(codepoint, &byteCount);
+    CorpusAppend(corpus, utf8, byteCount);
+}
+
+static void AppendLatinSentence(Corpus* corpus, int wordCount) {
+    for (int i = 0; i < wordCount; i++) {
+        const char* word = latinWords[NextRandom(corpus) % (sizeof(latinWords) / sizeof(latinWords[0]))];
+        uint32_t decoration = NextRandom(corpus) % 16;
+        if (i > 0) CorpusAppendString(corpus, " ");
+        if (decoration == 0) {
+            CorpusAppendString(corpus, "**");
+            CorpusAppendString(corpus, word);
+            CorpusAppendString(corpus, "**");
+        } else if (decoration == 1) {
+            CorpusAppendString(corpus, "*");
+            CorpusAppendString(corpus, word);
+            CorpusAppendString(corpus, "*");
+        } else if (decoration == 2) {
+            CorpusAppendString(corpus, "`");
+            CorpusAppendString(corpus, word);
+            CorpusAppendString(corpus, "`");
+        } else {
+            CorpusAppendString(corpus, word);
+        }
+    }
+    CorpusAppendString(corpus, ".");
+}
+
+static void AppendCjkSentence(Corpus* corpus, int charCount) {
+    for (int i = 0; i < charCount; i++) {
+        uint32_t roll = NextRandom(corpus) % 64;
+        if (roll == 0) {
+            CorpusAppendString(corpus, "，");
+        } else if (roll == 1) {
+            CorpusAppendString(corpus, " Clay ");
+        } else if (roll == 2) {
+            // rare character outside the preloaded glyph set, exercises the fallback path
+            CorpusAppendCodepoint(corpus, BENCH_CJK_BASE + BENCH_CJK_GLYPHS + (NextRandom(corpus) % 2000));
+        } else {
+            CorpusAppendCodepoint(corpus, BENCH_CJK_BASE + (NextRandom(corpus) % BENCH_CJK_GLYPHS));
+        }
+    }
+    CorpusAppendString(corpus, "。");
+}
+
+static void AppendBlock(Corpus* corpus, CorpusKind kind, int blockIndex) {
+    char heading[64];
+    if (blockIndex % 12 == 0) {
+        snprintf(heading, sizeof(heading), "%s Section %d\n\n", (blockIndex % 24 == 0) ? "#" : "##", blockIndex / 12);
+        CorpusAppendString(corpus, heading);
+    }
+
+    switch (kind) {
+        case CORPUS_PROSE: {
+            int sentences = 2 + NextRandom(corpus) % 4;
+            for (int i = 0; i < sentences; i++) {
+                if (i > 0) CorpusAppendString(corpus, (NextRandom(corpus) % 3 == 0) ? "\n" : " ");
+                AppendLatinSentence(corpus, 6 + NextRandom(corpus) % 14);
+            }
+            CorpusAppendString(corpus, "\n\n");
+            break;
+        }
+        case CORPUS_CJK: {
+            int sentences = 2 + NextRandom(corpus) % 4;
+            for (int i = 0; i < sentences; i++) {
+                AppendCjkSentence(corpus, 12 + NextRandom(corpus) % 40);
+            }
+            CorpusAppendString(corpus, "\n\n");
+            break;
+        }
+        case CORPUS_LISTS: {
+            Bool ordered = NextRandom(corpus) % 2;
+            int items = 3 + NextRandom(corpus) % 6;
+            char marker[16];
+            for (int i = 0; i < items; i++) {
+                snprintf(marker, sizeof(marker), ordered ? "%d. " : "- ", i + 1);
+                CorpusAppendString(corpus, marker);
+                AppendLatinSentence(corpus, 3 + NextRandom(corpus) % 8);
+                CorpusAppendString(corpus, "\n");
+                if (NextRandom(corpus) % 4 == 0) {
+                    CorpusAppendString(corpus, "    - ");
+                    AppendLatinSentence(corpus, 2 + NextRandom(corpus) % 5);
+                    CorpusAppendString(corpus, "\n");
+                }
+            }
+            CorpusAppendString(corpus, "\n> ");
+            AppendLatinSentence(corpus, 8 + NextRandom(corpus) % 10);
+            CorpusAppendString(corpus, "\n> ");
+            AppendCjkSentence(corpus, 10 + NextRandom(corpus) % 20);
+            CorpusAppendString(corpus, "\n\n");
+            break;
+        }
+        case CORPUS_CODE: {
+            AppendLatinSentence(corpus, 5 + NextRandom(corpus) % 10);
+            CorpusAppendString(corpus, "\n\n```c\n");
+            int lines = 4 + NextRandom(corpus) % 16;
+            for (int i = 0; i < lines; i++) {
+                char line[128];
+                snprintf(line, sizeof(line), "    int value%u = Compute(%u, buffer[%u]);\n",
+                         NextRandom(corpus) % 100, NextRandom(corpus) % 1000, NextRandom(corpus) % 64);
+                CorpusAppendString(corpus, line);
+            }
+            CorpusAppendString(corpus, "```\n\n");
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static Corpus GenerateCorpus(CorpusKind kind, size_t targetSize) {
+    Corpus corpus = {.seed = 0x9E3779B9u ^ (uint32_t) (kind * 7919 + targetSize)};
+    int blockIndex = 0;
+    while (corpus.length < targetSize) {
+        AppendBlock(&corpus, kind, blockIndex++);
+    }
+    return corpus;
+}
+
+/* ---------- fonts ---------- */
+
+static FontAtlas benchFonts[16];
+
+static void LoadBenchFonts() {
+    int* codepoints;
+    DYNARRAY_INIT(codepoints, 4096);
+    for (int cp = 32; cp < 127; cp++) DYNARRAY_PUSHBACK(codepoints, cp);
+    for (int cp = 0x3000; cp < 0x3040; cp++) DYNARRAY_PUSHBACK(codepoints, cp);
+    for (int cp = BENCH_CJK_BASE; cp < BENCH_CJK_BASE + BENCH_CJK_GLYPHS; cp++) DYNARRAY_PUSHBACK(codepoints, cp);
+    for (int cp = 0xFF00; cp < 0xFF5F; cp++) DYNARRAY_PUSHBACK(codepoints, cp);
+
+    int normalIds[] = {ZHCN_FONT_NORMAL, ZHCN_FONT_NORMAL_BOLD, ZHCN_FONT_NORMAL_ITALIC, ZHCN_FONT_NORMAL_BOLD_ITALIC};
+    int bigIds[] = {ZHCN_FONT_BIG, ZHCN_FONT_BIG_BOLD, ZHCN_FONT_BIG_ITALIC, ZHCN_FONT_BIG_BOLD_ITALIC};
+    for (int i = 0; i < 4; i++) {
+        benchFonts[normalIds[i]] = LoadFixedMetricFont(18, codepoints, DYNARRAY_SIZE(codepoints));
+        benchFonts[bigIds[i]] = LoadFixedMetricFont(48, codepoints, DYNARRAY_SIZE(codepoints));
+    }
+    benchFonts[CODE_FONT_MONOSPACE] = LoadFixedMetricFont(18, codepoints, DYNARRAY_SIZE(codepoints));
+
+    DYNARRAY_FREE(codepoints);
+}
+
+static void UnloadBenchFonts() {
+    for (int i = 0; i < 16; i++) {
+        if (benchFonts[i].font.glyphs) {
+            UnloadFontAtlas(&benchFonts[i]);
+        }
+    }
+}
+
+/* ---------- clay ---------- */
+
+static void* clayMemory = NULL;
+
+static void HandleBenchClayError(Clay_ErrorData errorData) {
+    fprintf(stderr, "Clay error: %.*s\n", errorData.errorText.length, errorData.errorText.chars);
+}
+
+static void ResetClay(int commandCount) {
+    // every command may become an element, and clay splits text into words for measuring
+    Clay_SetMaxElementCount(commandCount + 1024);
+    Clay_SetMaxMeasureTextCacheWordCount(commandCount * 16 + 16384);
+
+    uint64_t clayMemorySize = Clay_MinMemorySize();
+    free(clayMemory);
+    clayMemory = malloc(clayMemorySize);
+
+    Clay_Arena arena = Clay_CreateArenaWithCapacityAndMemory(clayMemorySize, clayMemory);
+    Clay_Initialize(arena, (Clay_Dimensions){BENCH_VIEWPORT_WIDTH, BENCH_VIEWPORT_HEIGHT}, (Clay_ErrorHandler){HandleBenchClayError});
+    Clay_SetMeasureTextFunction(Raylib_MeasureText, benchFonts);
+}
+
+/* ---------- runner ---------- */
+
+typedef struct {
+    int iterations;
+    size_t maxSize;
+    size_t maxLayoutSize;
+    int kindFilter;
+    int threads;
+    Bool csv;
+} BenchOptions;
+
+static void ReportPhase(const BenchOptions* options, const char* kind, size_t size, const char* phase, PhaseResult result, int iterations, int itemCount) {
+    double ms = result.milliseconds / iterations;
+    double allocs = (double) result.allocCount / iterations;
+    double allocBytes = (double) result.allocBytes / iterations;
+    if (options->csv) {
+        printf("%s,%zu,%s,%.4f,%.0f,%.0f,%d\n", kind, size, phase, ms, allocs, allocBytes, itemCount);
+    } else {
+        printf("%-6s %10zu  %-13s %10.3f ms %12.0f %14.0f %10d\n", kind, size, phase, ms, allocs, allocBytes, itemCount);
+    }
+}
+
+static void ReportSkipped(const BenchOptions* options, const char* kind, size_t size, const char* phase) {
+    if (options->csv) {
+        printf("%s,%zu,%s,,,,\n", kind, size, phase);
+    } else {
+        printf("%-6s %10zu  %-13s %13s\n", kind, size, phase, "skipped");
+    }
+}
+
+static void ReportCacheStats(const BenchOptions* options, const char* kind, size_t size, const char* phase, MeasureCacheStats stats) {
+    double hitRate = (stats.hits + stats.misses) ? 100.0 * stats.hits / (double) (stats.hits + stats.misses) : 0.0;
+    if (options->csv) {
+        printf("%s,%zu,%s,,%llu,%llu,%d\n", kind, size, phase, (unsigned long long) stats.hits, (unsigned long long) stats.misses, stats.entryCount);
+    } else {
+        printf("%-6s %10zu  %-13s %12.1f%% hits %llu / misses %llu / evicted %llu\n", kind, size, phase, hitRate,
+               (unsigned long long) stats.hits, (unsigned long long) stats.misses, (unsigned long long) stats.evictions);
+    }
+}
+
+// The parallel parse has to produce exactly what the serial one does, list numbers and styles included
+static Bool IsSameDocument(const MarkdownDocument* a, const MarkdownDocument* b) {
+    if (a->commandCount != b->commandCount) return FALSE;
+    for (int i = 0; i < a->commandCount; i++) {
+        const RenderCommand* x = &a->commands[i];
+        const RenderCommand* y = &b->commands[i];
+        if (x->type != y->type || x->blockType != y->blockType || x->length != y->length) return FALSE;
+        if (x->type != CMD_TEXT) continue;
+        if (x->styleId != y->styleId || memcmp(x->chars, y->chars, x->length) != 0) return FALSE;
+
+        const Clay_TextElementConfig* s = &a->styles[x->styleId];
+        const Clay_TextElementConfig* t = &b->styles[y->styleId];
+        if (s->fontId != t->fontId || s->fontSize != t->fontSize || s->lineHeight != t->lineHeight ||
+            s->letterSpacing != t->letterSpacing || s->wrapMode != t->wrapMode ||
+            memcmp(&s->textColor, &t->textColor, sizeof(s->textColor)) != 0) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void RunMeasurePhase(const MarkdownDocument* document, int* outMeasured) {
+    int measured = 0;
+    for (int i = 0; i < document->commandCount; i++) {
+        const RenderCommand* cmd = &document->commands[i];
+        if (cmd->type != CMD_TEXT) continue;
+
+        Clay_TextElementConfig config = document->styles[cmd->styleId];
+        Clay_StringSlice slice = {.length = cmd->length, .chars = cmd->chars, .baseChars = cmd->chars};
+        Raylib_MeasureText(slice, &config, benchFonts);
+        measured++;
+    }
+    *outMeasured = measured;
+}
+
+static void RunLayoutPhase(const MarkdownDocument* document, int* outRenderCommands) {
+    Clay_BeginLayout();
+    MarkdownRenderer(document);
+    Clay_RenderCommandArray renderCommands = Clay_EndLayout();
+    *outRenderCommands = renderCommands.length;
+}
+
+static void RunCorpus(const BenchOptions* options, CorpusKind kind, size_t size) {
+    const char* kindName = corpusKindNames[kind];
+    Corpus corpus = GenerateCorpus(kind, size);
+
+    char* source = NULL;
+    size_t sourceLength = 0;
+    PhaseProbe probe = BeginPhase();
+    for (int i = 0; i < options->iterations; i++) {
+        free(source);
+        source = PreprocessMarkdown(corpus.data, corpus.length, &sourceLength);
+    }
+    ReportPhase(options, kindName, corpus.length, "preprocess", EndPhase(probe), options->iterations, (int) sourceLength);
+
+    MarkdownDocument document = {0};
+    probe = BeginPhase();
+    for (int i = 0; i < options->iterations; i++) {
+        FreeMarkdownDocument(&document);
+        document = ParseMarkdownDocument(source, sourceLength);
+    }
+    ReportPhase(options, kindName, corpus.length, "parse", EndPhase(probe), options->iterations, document.commandCount);
+
+    if (options->threads > 1) {
+        MarkdownDocument parallel = {0};
+        probe = BeginPhase();
+        for (int i = 0; i < options->iterations; i++) {
+            FreeMarkdownDocument(&parallel);
+            // the document takes the copy; the copy itself isn't part of the parse, but it's cheap next to it
+            char* copy = (char*) malloc(sourceLength + 1);
+            memcpy(copy, source, sourceLength + 1);
+            parallel = AdoptMarkdownDocumentParallel(copy, sourceLength, options->threads);
+        }
+        ReportPhase(options, kindName, corpus.length, "parse-threads", EndPhase(probe), options->iterations, parallel.commandCount);
+        if (!IsSameDocument(&document, &parallel)) {
+            printf("%s %zu: parallel parse differs from the serial one\n", kindName, corpus.length);
+        }
+        FreeMarkdownDocument(&parallel);
+    }
+
+    // start every corpus from an empty word cache so the numbers don't depend on run order
+    Raylib_ClearMeasureCache();
+    Raylib_ResetMeasureCacheStats();
+
+    int measured = 0;
+    probe = BeginPhase();
+    for (int i = 0; i < options->iterations; i++) {
+        RunMeasurePhase(&document, &measured);
+    }
+    ReportPhase(options, kindName, corpus.length, "measure", EndPhase(probe), options->iterations, measured);
+
+    MeasureCacheStats cacheStats = Raylib_GetMeasureCacheStats();
+    ReportCacheStats(options, kindName, corpus.length, "measure-cache", cacheStats);
+
+    if (corpus.length <= options->maxLayoutSize) {
+        ResetClay(document.commandCount);
+
+        // the first frame fills clay's per-word measure cache, the following ones are steady state
+        int renderCommandCount = 0;
+        probe = BeginPhase();
+        RunLayoutPhase(&document, &renderCommandCount);
+        ReportPhase(options, kindName, corpus.length, "layout-cold", EndPhase(probe), 1, renderCommandCount);
+
+        probe = BeginPhase();
+        for (int i = 0; i < options->iterations; i++) {
+            RunLayoutPhase(&document, &renderCommandCount);
+        }
+        ReportPhase(options, kindName, corpus.length, "layout-warm", EndPhase(probe), options->iterations, renderCommandCount);
+        ReportCacheStats(options, kindName, corpus.length, "layout-cache", Raylib_GetMeasureCacheStats());
+    } else {
+        ReportSkipped(options, kindName, corpus.length, "layout-cold");
+        ReportSkipped(options, kindName, corpus.length, "layout-warm");
+    }
+
+    FreeMarkdownDocument(&document);
+    free(source);
+    free(corpus.data);
+}
+
+static size_t ParseSize(const char* text) {
+    char* end = NULL;
+    double value = strtod(text, &end);
+    if (end && (*end == 'k' || *end == 'K')) value *= 1024;
+    if (end && (*end == 'm' || *end == 'M')) value *= 1024 * 1024;
+    return (size_t) value;
+}
+
+static void PrintUsage(const char* program) {
+    printf("usage: %s [--iterations N] [--max-size SIZE] [--max-layout-size SIZE] [--kind prose|cjk|lists|code] [--threads N] [--csv]\n", program);
+    printf("  sizes accept k/m suffixes, e.g. --max-size 8m\n");
+    printf("  --threads also runs the parallel parse on N threads (default: all cores) and checks it against the serial one\n");
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options = {
+            .iterations = 3,
+            .maxSize = 50 * 1024 * 1024,
+            .maxLayoutSize = 8 * 1024 * 1024,
+            .kindFilter = -1,
+            .threads = GetDefaultParseThreadCount(),
+            .csv = FALSE,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+            options.iterations = atoi(argv[++i]);
+            if (options.iterations < 1) options.iterations = 1;
+        } else if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            options.maxSize = ParseSize(argv[++i]);
+        } else if (strcmp(argv[i], "--max-layout-size") == 0 && i + 1 < argc) {
+            options.maxLayoutSize = ParseSize(argv[++i]);
+        } else if (strcmp(argv[i], "--kind") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            for (int k = 0; k < CORPUS_KIND_COUNT; k++) {
+                if (strcmp(name, corpusKindNames[k]) == 0) options.kindFilter = k;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0) {
+            options.csv = TRUE;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    const size_t sizes[] = {1024, 64 * 1024, 1024 * 1024, 8 * 1024 * 1024, 50 * 1024 * 1024};
+
+    LoadBenchFonts();
+
+    if (options.csv) {
+        printf("kind,bytes,phase,ms,allocs,alloc_bytes,items\n");
+    } else {
+        printf("%-6s %10s  %-13s %13s %12s %14s %10s\n", "kind", "bytes", "phase", "time", "allocs", "alloc bytes", "items");
+        if (!BENCH_ALLOC_TRACKING) {
+            printf("(allocation tracking unavailable on this libc)\n");
+        }
+    }
+
+    for (int kind = 0; kind < CORPUS_KIND_COUNT; kind++) {
+        if (options.kindFilter >= 0 && kind != options.kindFilter) continue;
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            if (sizes[s] > options.maxSize) continue;
+            RunCorpus(&options, (CorpusKind) kind, sizes[s]);
+        }
+    }
+
+    UnloadBenchFonts();
+    free(clayMemory);
+    return 0;
+}
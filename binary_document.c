@@ -0,0 +1,245 @@
+#include "binary_document.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Static_assert(sizeof(BinaryDocumentHeader) == 32, "binary document header must stay 32 bytes");
+_Static_assert(sizeof(BinaryStyleRecord) == 16, "binary style record must stay 16 bytes");
+_Static_assert(sizeof(BinaryCommandRecord) == 12, "binary command record must stay 12 bytes");
+
+// With 32-bit pointers a command record turns into a RenderCommand by rewriting its offset into a pointer
+#if UINTPTR_MAX == 0xFFFFFFFFu
+#define BINARY_DOCUMENT_IN_PLACE 1
+_Static_assert(sizeof(RenderCommand) == sizeof(BinaryCommandRecord), "RenderCommand no longer matches the record");
+_Static_assert(offsetof(RenderCommand, chars) == offsetof(BinaryCommandRecord, offset), "RenderCommand no longer matches the record");
+#else
+#define BINARY_DOCUMENT_IN_PLACE 0
+#endif
+
+Bool IsBinaryDocumentPath(const char* path) {
+    size_t length = strlen(path);
+    size_t extensionLength = strlen(BINARY_DOCUMENT_EXTENSION);
+    return length >= extensionLength && strcmp(path + length - extensionLength, BINARY_DOCUMENT_EXTENSION) == 0;
+}
+
+/* ---------- writing ---------- */
+
+typedef struct {
+    uint64_t hash;
+    uint32_t offset;
+    int32_t length; // -1 for an empty slot
+} PoolSlot;
+
+typedef struct {
+    char* data;
+    size_t size;
+    size_t capacity;
+
+    PoolSlot* slots;
+    size_t slotMask;
+    size_t slotCount;
+} StringPool;
+
+static void InitStringPool(StringPool* pool, size_t expectedStrings) {
+    memset(pool, 0, sizeof(*pool));
+    size_t slotTotal = 64;
+    while (slotTotal < expectedStrings * 2) slotTotal <<= 1;
+    pool->slots = (PoolSlot*) malloc(slotTotal * sizeof(PoolSlot));
+    for (size_t i = 0; i < slotTotal; i++) {
+        pool->slots[i].length = -1;
+    }
+    pool->slotMask = slotTotal - 1;
+}
+
+static uint32_t AddToStringPool(StringPool* pool, const char* chars, int32_t length) {
+    uint64_t hash = HashBytes(chars, (size_t) length);
+    size_t index = (size_t) hash & pool->slotMask;
+    while (pool->slots[index].length >= 0) {
+        PoolSlot* slot = &pool->slots[index];
+        if (slot->hash == hash && slot->length == length && memcmp(pool->data + slot->offset, chars, length) == 0) {
+            return slot->offset;
+        }
+        index = (index + 1) & pool->slotMask;
+    }
+
+    if (pool->size + length > pool->capacity) {
+        pool->capacity = pool->capacity ? pool->capacity : 4096;
+        while (pool->size + length > pool->capacity) pool->capacity *= 2;
+        pool->data = (char*) realloc(pool->data, pool->capacity);
+    }
+
+    uint32_t offset = (uint32_t) pool->size;
+    memcpy(pool->data + pool->size, chars, length);
+    pool->size += length;
+    pool->slots[index] = (PoolSlot){.hash = hash, .offset = offset, .length = length};
+    pool->slotCount++;
+    return offset;
+}
+
+char* SerializeMarkdownDocument(const MarkdownDocument* document, size_t* outLength) {
+    StringPool pool;
+    InitStringPool(&pool, document->commandCount);
+
+    size_t styleBytes = document->styleCount * sizeof(BinaryStyleRecord);
+    size_t commandBytes = document->commandCount * sizeof(BinaryCommandRecord);
+    BinaryCommandRecord* records = (BinaryCommandRecord*) malloc(commandBytes ? commandBytes : 1);
+
+    for (int i = 0; i < document->commandCount; i++) {
+        const RenderCommand* cmd = &document->commands[i];
+        records[i] = (BinaryCommandRecord){
+                .type = cmd->type,
+                .blockType = cmd->blockType,
+                .styleId = cmd->styleId,
+                .length = cmd->length,
+                .offset = cmd->length > 0 ? AddToStringPool(&pool, cmd->chars, cmd->length) : 0,
+        };
+    }
+
+    size_t payloadLength = styleBytes + commandBytes + pool.size;
+    size_t length = sizeof(BinaryDocumentHeader) + payloadLength;
+    char* blob = (char*) calloc(1, length);
+
+    BinaryStyleRecord* styles = (BinaryStyleRecord*) (blob + sizeof(BinaryDocumentHeader));
+    for (int i = 0; i < document->styleCount; i++) {
+        const Clay_TextElementConfig* style = &document->styles[i];
+        styles[i] = (BinaryStyleRecord){
+                .r = (uint8_t) style->textColor.r,
+                .g = (uint8_t) style->textColor.g,
+                .b = (uint8_t) style->textColor.b,
+                .a = (uint8_t) style->textColor.a,
+                .fontId = style->fontId,
+                .fontSize = style->fontSize,
+                .letterSpacing = style->letterSpacing,
+                .lineHeight = style->lineHeight,
+                .wrapMode = (uint8_t) style->wrapMode,
+                .textAlignment = (uint8_t) style->textAlignment,
+        };
+    }
+    memcpy(blob + sizeof(BinaryDocumentHeader) + styleBytes, records, commandBytes);
+    memcpy(blob + sizeof(BinaryDocumentHeader) + styleBytes + commandBytes, pool.data, pool.size);
+
+    BinaryDocumentHeader header = {
+            .version = BINARY_DOCUMENT_VERSION,
+            .headerSize = sizeof(BinaryDocumentHeader),
+            .styleCount = (uint32_t) document->styleCount,
+            .commandCount = (uint32_t) document->commandCount,
+            .stringPoolSize = (uint32_t) pool.size,
+            .checksum = HashBytes(blob + sizeof(BinaryDocumentHeader), payloadLength),
+    };
+    memcpy(header.magic, BINARY_DOCUMENT_MAGIC, 4);
+    memcpy(blob, &header, sizeof(header));
+
+    free(records);
+    free(pool.data);
+    free(pool.slots);
+
+    *outLength = length;
+    return blob;
+}
+
+/* ---------- loading ---------- */
+
+static Bool ValidateCommands(const BinaryCommandRecord* records, uint32_t count, uint32_t styleCount, uint32_t poolSize) {
+    int depth = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const BinaryCommandRecord* record = &records[i];
+        if (record->type > CMD_BLOCK_CLOSE || record->blockType > BT_HR || record->length < 0) {
+            return FALSE;
+        }
+        if (record->type == CMD_TEXT &&
+            (record->styleId >= styleCount || (uint64_t) record->offset + (uint64_t) record->length > poolSize)) {
+            return FALSE;
+        }
+        // clay's element stack has to balance out, whatever the file says
+        if (record->type == CMD_BLOCK_OPEN) depth++;
+        if (record->type == CMD_BLOCK_CLOSE && --depth < 0) {
+            return FALSE;
+        }
+    }
+    return depth == 0;
+}
+
+Bool LoadBinaryDocument(char* blob, size_t length, MarkdownDocument* outDocument) {
+    BinaryDocumentHeader header;
+    if (length < sizeof(header)) {
+        printf("Binary document too short\n");
+        return FALSE;
+    }
+    memcpy(&header, blob, sizeof(header));
+
+    if (memcmp(header.magic, BINARY_DOCUMENT_MAGIC, 4) != 0 || header.headerSize != sizeof(header)) {
+        printf("Not a binary document\n");
+        return FALSE;
+    }
+    if (header.version != BINARY_DOCUMENT_VERSION) {
+        printf("Binary document version %d, expected %d\n", header.version, BINARY_DOCUMENT_VERSION);
+        return FALSE;
+    }
+
+    uint64_t styleBytes = (uint64_t) header.styleCount * sizeof(BinaryStyleRecord);
+    uint64_t commandBytes = (uint64_t) header.commandCount * sizeof(BinaryCommandRecord);
+    uint64_t payloadLength = styleBytes + commandBytes + header.stringPoolSize;
+    if (sizeof(header) + payloadLength != length || header.styleCount > MARKDOWN_MAX_STYLES) {
+        printf("Binary document size mismatch\n");
+        return FALSE;
+    }
+    if (HashBytes(blob + sizeof(header), (size_t) payloadLength) != header.checksum) {
+        printf("Binary document checksum mismatch\n");
+        return FALSE;
+    }
+
+    const BinaryStyleRecord* styleRecords = (const BinaryStyleRecord*) (blob + sizeof(header));
+    BinaryCommandRecord* records = (BinaryCommandRecord*) (blob + sizeof(header) + styleBytes);
+    const char* pool = blob + sizeof(header) + styleBytes + commandBytes;
+    if (!ValidateCommands(records, header.commandCount, header.styleCount, header.stringPoolSize)) {
+        printf("Binary document has malformed commands\n");
+        return FALSE;
+    }
+
+    MarkdownDocument document = {.generation = NextMarkdownDocumentGeneration()};
+
+    // the style table is tiny, unpacking it beats matching clay's struct layout on disk
+    document.styleCount = (int) header.styleCount;
+    document.styles = (Clay_TextElementConfig*) calloc(header.styleCount ? header.styleCount : 1, sizeof(Clay_TextElementConfig));
+    for (uint32_t i = 0; i < header.styleCount; i++) {
+        const BinaryStyleRecord* record = &styleRecords[i];
+        document.styles[i] = (Clay_TextElementConfig){
+                .textColor = {record->r, record->g, record->b, record->a},
+                .fontId = record->fontId,
+                .fontSize = record->fontSize,
+                .letterSpacing = record->letterSpacing,
+                .lineHeight = record->lineHeight,
+                .wrapMode = (Clay_TextElementConfigWrapMode) record->wrapMode,
+                .textAlignment = (Clay_TextAlignment) record->textAlignment,
+        };
+    }
+
+    document.commandCount = (int) header.commandCount;
+#if BINARY_DOCUMENT_IN_PLACE
+    // pointer fix-ups only: each record becomes its RenderCommand right where it is
+    for (uint32_t i = 0; i < header.commandCount; i++) {
+        const char* chars = pool + records[i].offset;
+        RenderCommand* cmd = (RenderCommand*) &records[i];
+        cmd->chars = chars;
+    }
+    document.commands = (RenderCommand*) records;
+    document.commandsInSource = TRUE;
+#else
+    document.commands = (RenderCommand*) malloc((header.commandCount ? header.commandCount : 1) * sizeof(RenderCommand));
+    for (uint32_t i = 0; i < header.commandCount; i++) {
+        document.commands[i] = (RenderCommand){
+                .type = records[i].type,
+                .blockType = records[i].blockType,
+                .styleId = records[i].styleId,
+                .length = records[i].length,
+                .chars = pool + records[i].offset,
+        };
+    }
+#endif
+
+    document.ownedSource = blob;
+    document.sourceLength = length;
+    *outDocument = document;
+    return TRUE;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "markdown.h"
+#include "util.h"
+
+// Posts compiled ahead of time by burogu_compile, so the runtime can skip preprocessing and cmark.
+// Layout (little endian): header, style records, command records, string pool.
+// Bump the version whenever RenderCommand, the style resolution in markdown.c or the font ids change.
+#define BINARY_DOCUMENT_MAGIC "BDOC"
+#define BINARY_DOCUMENT_VERSION 1
+#define BINARY_DOCUMENT_EXTENSION ".bdoc"
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t styleCount;
+    uint32_t commandCount;
+    uint32_t stringPoolSize;
+    uint32_t reserved;
+    uint64_t checksum; // HashBytes over everything after the header
+} BinaryDocumentHeader;
+
+typedef struct {
+    uint8_t r, g, b, a;
+    uint16_t fontId;
+    uint16_t fontSize;
+    uint16_t letterSpacing;
+    uint16_t lineHeight;
+    uint8_t wrapMode;
+    uint8_t textAlignment;
+    uint16_t reserved;
+} BinaryStyleRecord;
+
+// Same size and field order as RenderCommand on wasm32, where commands are fixed up in place
+typedef struct {
+    uint8_t type;
+    uint8_t blockType;
+    uint16_t styleId;
+    int32_t length;
+    uint32_t offset; // into the string pool
+} BinaryCommandRecord;
+
+Bool IsBinaryDocumentPath(const char* path);
+
+// Returns a malloc'd blob, identical strings are stored once
+char* SerializeMarkdownDocument(const MarkdownDocument* document, size_t* outLength);
+
+// Validates the blob and builds a document on top of it; on success the document owns the blob,
+// on failure the caller still does
+Bool LoadBinaryDocument(char* blob, size_t length, MarkdownDocument* outDocument);
@@ -0,0 +1,137 @@
+#include "document_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void EvictEntry(DocumentCache* cache, DocumentCacheEntry* entry) {
+    cache->totalBytes -= entry->bytes;
+    FreeMarkdownDocument(&entry->document);
+    free(entry->path);
+    memset(entry, 0, sizeof(*entry));
+}
+
+static DocumentCacheEntry* FindLeastRecentlyUsed(DocumentCache* cache, const DocumentCacheEntry* keep) {
+    DocumentCacheEntry* oldest = NULL;
+    for (int i = 0; i < DOCUMENT_CACHE_MAX_ENTRIES; i++) {
+        DocumentCacheEntry* entry = &cache->entries[i];
+        if (!entry->path || entry == keep || entry->pinned) continue;
+        if (!oldest || entry->lastUsed < oldest->lastUsed) {
+            oldest = entry;
+        }
+    }
+    return oldest;
+}
+
+void InitDocumentCache(DocumentCache* cache, size_t budget) {
+    memset(cache, 0, sizeof(*cache));
+    cache->budget = budget;
+}
+
+void FreeDocumentCache(DocumentCache* cache) {
+    for (int i = 0; i < DOCUMENT_CACHE_MAX_ENTRIES; i++) {
+        if (cache->entries[i].path) {
+            EvictEntry(cache, &cache->entries[i]);
+        }
+    }
+}
+
+MarkdownDocument* FindCachedDocument(DocumentCache* cache, const char* path) {
+    for (int i = 0; i < DOCUMENT_CACHE_MAX_ENTRIES; i++) {
+        DocumentCacheEntry* entry = &cache->entries[i];
+        if (entry->path && strcmp(entry->path, path) == 0) {
+            entry->lastUsed = ++cache->useCounter;
+            cache->hits++;
+            return &entry->document;
+        }
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+Bool IsDocumentCached(const DocumentCache* cache, const char* path) {
+    for (int i = 0; i < DOCUMENT_CACHE_MAX_ENTRIES; i++) {
+        const DocumentCacheEntry* entry = &cache->entries[i];
+        if (entry->path && strcmp(entry->path, path) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+MarkdownDocument* CacheDocument(DocumentCache* cache, const char* path, MarkdownDocument document) {
+    DocumentCacheEntry* slot = NULL;
+    for (int i = 0; i < DOCUMENT_CACHE_MAX_ENTRIES; i++) {
+        DocumentCacheEntry* entry = &cache->entries[i];
+        if (entry->path && strcmp(entry->path, path) == 0) {
+            if (entry->pinned) {
+                // the copy on screen stays, the new one isn't needed
+                FreeMarkdownDocument(&document);
+                entry->lastUsed = ++cache->useCounter;
+                return &entry->document;
+            }
+            EvictEntry(cache, entry);
+            slot = entry;
+            break;
+        }
+        if (!entry->path && !slot) {
+            slot = entry;
+        }
+    }
+
+    if (!slot) {
+        slot = FindLeastRecentlyUsed(cache, NULL);
+        if (!slot) {
+            // only possible with a single slot that's pinned
+            FreeMarkdownDocument(&document);
+            return NULL;
+        }
+        EvictEntry(cache, slot);
+        cache->evictions++;
+    }
+
+    slot->path = strdup(path);
+    slot->document = document;
+    slot->bytes = GetMarkdownDocumentBytes(&document);
+    slot->lastUsed = ++cache->useCounter;
+    cache->totalBytes += slot->bytes;
+
+    // the new document is the one on screen, so it stays even if it's over budget on its own
+    while (cache->totalBytes > cache->budget) {
+        DocumentCacheEntry* oldest = FindLeastRecentlyUsed(cache, slot);
+        if (!oldest) break;
+        printf("Document cache over budget, evicting %s\n", oldest->path);
+        EvictEntry(cache, oldest);
+        cache->evictions++;
+    }
+
+    return &slot->document;
+}
+
+void PinCachedDocument(DocumentCache* cache, const MarkdownDocument* document) {
+    for (int i = 0; i < DOCUMENT_CACHE_MAX_ENTRIES; i++) {
+        DocumentCacheEntry* entry = &cache->entries[i];
+        entry->pinned = entry->path && &entry->document == document;
+    }
+}
+
+const char* GetCachedDocumentPath(const DocumentCache* cache, const MarkdownDocument* document) {
+    for (int i = 0; i < DOCUMENT_CACHE_MAX_ENTRIES; i++) {
+        const DocumentCacheEntry* entry = &cache->entries[i];
+        if (entry->path && &entry->document == document) {
+            return entry->path;
+        }
+    }
+    return NULL;
+}
+
+void DropCachedDocument(DocumentCache* cache, const char* path) {
+    for (int i = 0; i < DOCUMENT_CACHE_MAX_ENTRIES; i++) {
+        DocumentCacheEntry* entry = &cache->entries[i];
+        if (entry->path && !entry->pinned && strcmp(entry->path, path) == 0) {
+            EvictEntry(cache, entry);
+            return;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "markdown.h"
+#include "util.h"
+
+// Default heap budget for parsed documents kept around after navigating away from them
+#define DOCUMENT_CACHE_DEFAULT_BUDGET (32 * 1024 * 1024)
+#define DOCUMENT_CACHE_MAX_ENTRIES 32
+
+typedef struct {
+    char* path; // NULL for a free slot
+    MarkdownDocument document;
+    size_t bytes;
+    uint64_t lastUsed;
+    Bool pinned;
+} DocumentCacheEntry;
+
+typedef struct {
+    DocumentCacheEntry entries[DOCUMENT_CACHE_MAX_ENTRIES];
+    size_t budget;
+    size_t totalBytes;
+    uint64_t useCounter;
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} DocumentCache;
+
+void InitDocumentCache(DocumentCache* cache, size_t budget);
+void FreeDocumentCache(DocumentCache* cache);
+
+// The returned documents stay valid until they're evicted, which never happens to the newest or the pinned one
+MarkdownDocument* FindCachedDocument(DocumentCache* cache, const char* path);
+// Same as FindCachedDocument but doesn't count as a use
+Bool IsDocumentCached(const DocumentCache* cache, const char* path);
+// Takes ownership of the document, replacing any entry with the same path, then evicts down to the budget
+MarkdownDocument* CacheDocument(DocumentCache* cache, const char* path, MarkdownDocument document);
+// Keeps the document on screen alive while others are added, e.g. by prefetching; pass NULL to unpin
+void PinCachedDocument(DocumentCache* cache, const MarkdownDocument* document);
+// Path the document was cached under, NULL if it isn't in the cache
+const char* GetCachedDocumentPath(const DocumentCache* cache, const MarkdownDocument* document);
+// Forgets a document that went stale, unless it's the pinned one
+void DropCachedDocument(DocumentCache* cache, const char* path);
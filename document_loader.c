@@ -0,0 +1,260 @@
+#include "document_loader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static DocumentLoad* FindLoadByPath(DocumentLoader* loader, const char* path) {
+    for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS; i++) {
+        DocumentLoad* load = &loader->loads[i];
+        if (load->id != 0 && strcmp(load->path, path) == 0) {
+            return load;
+        }
+    }
+    return NULL;
+}
+
+static DocumentLoad* FindLoadById(DocumentLoader* loader, int requestId) {
+    for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS; i++) {
+        if (requestId != 0 && loader->loads[i].id == requestId) {
+            return &loader->loads[i];
+        }
+    }
+    return NULL;
+}
+
+static int CountLoads(const DocumentLoader* loader, LoadPurpose purpose) {
+    int count = 0;
+    for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS; i++) {
+        if (loader->loads[i].id != 0 && loader->loads[i].purpose == purpose) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static void ReleaseLoad(DocumentLoad* load) {
+    free(load->path);
+    memset(load, 0, sizeof(*load));
+}
+
+void InitDocumentLoader(DocumentLoader* loader, DocumentLoaderBackend backend, void (*onLoaded)(int, char*, size_t)) {
+    memset(loader, 0, sizeof(*loader));
+    loader->backend = backend;
+    loader->onLoaded = onLoaded;
+}
+
+int RequestDocumentLoad(DocumentLoader* loader, const char* path, LoadPurpose purpose) {
+    if (purpose == LOAD_PURPOSE_DISPLAY) {
+        // whatever was about to be displayed is still worth finishing, just not worth showing
+        for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS; i++) {
+            if (loader->loads[i].id != 0) {
+                loader->loads[i].purpose = LOAD_PURPOSE_PREFETCH;
+            }
+        }
+    }
+
+    DocumentLoad* existing = FindLoadByPath(loader, path);
+    if (existing) {
+        if (purpose == LOAD_PURPOSE_DISPLAY) {
+            existing->purpose = LOAD_PURPOSE_DISPLAY;
+        }
+        return existing->id;
+    }
+
+    if (purpose == LOAD_PURPOSE_PREFETCH && CountLoads(loader, LOAD_PURPOSE_PREFETCH) >= DOCUMENT_LOADER_MAX_PREFETCHES) {
+        return 0;
+    }
+
+    DocumentLoad* slot = NULL;
+    for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS && !slot; i++) {
+        if (loader->loads[i].id == 0) {
+            slot = &loader->loads[i];
+        }
+    }
+    if (!slot) {
+        if (purpose == LOAD_PURPOSE_PREFETCH) {
+            return 0;
+        }
+        // only demoted loads can be left at this point, give up the first one for the click
+        slot = &loader->loads[0];
+        loader->backend.cancel(loader, slot->id);
+        ReleaseLoad(slot);
+    }
+
+    if (++loader->nextRequestId <= 0) {
+        loader->nextRequestId = 1;
+    }
+    slot->id = loader->nextRequestId;
+    slot->path = strdup(path);
+    slot->purpose = purpose;
+
+    loader->backend.start(loader, slot->id, slot->path);
+    return slot->id;
+}
+
+void CancelDocumentPrefetch(DocumentLoader* loader, const char* path) {
+    DocumentLoad* load = FindLoadByPath(loader, path);
+    if (!load || load->purpose != LOAD_PURPOSE_PREFETCH) {
+        return;
+    }
+
+    loader->backend.cancel(loader, load->id);
+    ReleaseLoad(load);
+}
+
+Bool IsDocumentLoadPending(const DocumentLoader* loader, const char* path) {
+    return FindLoadByPath((DocumentLoader*) loader, path) != NULL;
+}
+
+const DocumentLoad* PeekDocumentLoad(const DocumentLoader* loader, int requestId) {
+    return FindLoadById((DocumentLoader*) loader, requestId);
+}
+
+Bool FinishDocumentLoad(DocumentLoader* loader, int requestId, DocumentLoad* outLoad) {
+    DocumentLoad* load = FindLoadById(loader, requestId);
+    if (!load) {
+        return FALSE;
+    }
+
+    *outLoad = *load;
+    memset(load, 0, sizeof(*load));
+    return TRUE;
+}
+
+void PollDocumentLoader(DocumentLoader* loader) {
+    if (loader->backend.poll) {
+        loader->backend.poll(loader);
+    }
+}
+
+/* ---------- file backend ---------- */
+
+static void StartFileLoad(DocumentLoader* loader, int requestId, const char* path) {
+    // nothing to do yet, the read happens on the next poll so results arrive asynchronously like fetch
+}
+
+typedef struct {
+    FILE* file;
+    size_t pieceSize;
+} FileStream;
+
+static void CloseFileStream(DocumentLoad* load) {
+    FileStream* stream = (FileStream*) load->backendData;
+    if (stream) {
+        fclose(stream->file);
+        free(stream);
+        load->backendData = NULL;
+    }
+}
+
+static void CancelFileLoad(DocumentLoader* loader, int requestId) {
+    DocumentLoad* load = FindLoadById(loader, requestId);
+    if (load) {
+        CloseFileStream(load);
+    }
+}
+
+static FILE* OpenLoadFile(const char* root, const char* path) {
+    char fullPath[1024];
+    snprintf(fullPath, sizeof(fullPath), "%s%s", root ? root : "", path);
+
+    FILE* file = fopen(fullPath, "rb");
+    if (!file) {
+        printf("Failed to open markdown file: %s\n", fullPath);
+    }
+    return file;
+}
+
+static char* ReadWholeFile(const char* root, const char* path, size_t* outLength) {
+    FILE* file = OpenLoadFile(root, path);
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buffer = (char*) malloc(fileSize + 1);
+    size_t read = fread(buffer, 1, fileSize, file);
+    buffer[read] = '\0';
+    *outLength = read;
+
+    fclose(file);
+    return buffer;
+}
+
+static void ReadFilePiece(DocumentLoader* loader, DocumentLoad* load) {
+    int requestId = load->id;
+    FileStream* stream = (FileStream*) load->backendData;
+    if (!stream) {
+        FILE* file = OpenLoadFile(loader->fileRoot, load->path);
+        if (!file) {
+            loader->onStreamEnd(requestId, FALSE);
+            return;
+        }
+        stream = (FileStream*) malloc(sizeof(FileStream));
+        stream->file = file;
+        stream->pieceSize = DOCUMENT_LOADER_FIRST_PIECE;
+        load->backendData = stream;
+    }
+
+    char* piece = (char*) malloc(stream->pieceSize);
+    size_t read = fread(piece, 1, stream->pieceSize, stream->file);
+    Bool more = read == stream->pieceSize;
+    Bool ok = more || !ferror(stream->file);
+    if (stream->pieceSize < DOCUMENT_LOADER_MAX_PIECE) {
+        stream->pieceSize *= 2;
+    }
+    if (!more) {
+        // closed before the end is reported, since that's when the request is claimed
+        CloseFileStream(load);
+    }
+
+    // load may be gone after either callback
+    if (read > 0) {
+        loader->onChunk(requestId, piece, read);
+    }
+    free(piece);
+    if (!more) {
+        loader->onStreamEnd(requestId, ok);
+    }
+}
+
+static void PollFileLoads(DocumentLoader* loader) {
+    if (loader->onChunk) {
+        // a piece of one load per poll, the one being waited for ahead of prefetches
+        DocumentLoad* next = NULL;
+        for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS; i++) {
+            DocumentLoad* load = &loader->loads[i];
+            if (load->id != 0 && (!next || (load->purpose == LOAD_PURPOSE_DISPLAY && next->purpose != LOAD_PURPOSE_DISPLAY))) {
+                next = load;
+            }
+        }
+        if (next) {
+            ReadFilePiece(loader, next);
+        }
+        return;
+    }
+
+    // one load per poll, like responses trickling in
+    for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS; i++) {
+        DocumentLoad* load = &loader->loads[i];
+        if (load->id == 0) continue;
+
+        int requestId = load->id;
+        size_t length = 0;
+        char* content = ReadWholeFile(loader->fileRoot, load->path, &length);
+        loader->onLoaded(requestId, content, length);
+        return;
+    }
+}
+
+DocumentLoaderBackend GetFileLoaderBackend() {
+    return (DocumentLoaderBackend){
+            .start = StartFileLoad,
+            .cancel = CancelFileLoad,
+            .poll = PollFileLoads,
+    };
+}
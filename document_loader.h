@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "util.h"
+
+#define DOCUMENT_LOADER_MAX_LOADS 16
+// Prefetches in flight at once; loads for a click are never held back by this
+#define DOCUMENT_LOADER_MAX_PREFETCHES 2
+// File backend reads when streaming: the first piece is small so the top of a post shows up right away, later ones
+// double up to the largest
+#define DOCUMENT_LOADER_FIRST_PIECE (64 * 1024)
+#define DOCUMENT_LOADER_MAX_PIECE (1024 * 1024)
+
+typedef enum {
+    LOAD_PURPOSE_DISPLAY,
+    LOAD_PURPOSE_PREFETCH,
+} LoadPurpose;
+
+typedef struct {
+    int id; // 0 for a free slot
+    char* path;
+    LoadPurpose purpose;
+    void* backendData; // released by the backend's cancel or before it reports the end
+} DocumentLoad;
+
+typedef struct DocumentLoader DocumentLoader;
+
+// Where the bytes come from: fetch() on the web, plain files for native builds and testing.
+// Backends report back through the loader's onLoaded callback, handing over a malloc'd buffer with the raw
+// file bytes (NULL on failure); the callback owns it from there and claims the request with FinishDocumentLoad.
+// When the loader has onChunk set, bytes are handed over as they arrive instead: any number of onChunk calls (the
+// buffer is only borrowed), then one onStreamEnd, which claims the request the same way.
+typedef struct {
+    void (*start)(DocumentLoader* loader, int requestId, const char* path);
+    void (*cancel)(DocumentLoader* loader, int requestId);
+    void (*poll)(DocumentLoader* loader); // optional
+} DocumentLoaderBackend;
+
+struct DocumentLoader {
+    DocumentLoaderBackend backend;
+    void (*onLoaded)(int requestId, char* content, size_t length);
+    // optional, streaming
+    void (*onChunk)(int requestId, const char* bytes, size_t length);
+    void (*onStreamEnd)(int requestId, Bool ok);
+    const char* fileRoot; // file backend only
+
+    DocumentLoad loads[DOCUMENT_LOADER_MAX_LOADS];
+    int nextRequestId;
+};
+
+void InitDocumentLoader(DocumentLoader* loader, DocumentLoaderBackend backend, void (*onLoaded)(int, char*, size_t));
+
+// Returns the request id, or 0 when a prefetch was turned down. A path already in flight is not requested twice;
+// asking to display it upgrades the existing load instead. Only one display load is kept, older ones become prefetches.
+int RequestDocumentLoad(DocumentLoader* loader, const char* path, LoadPurpose purpose);
+// Drops a prefetch that's no longer wanted; a load that has been asked to display is left alone
+void CancelDocumentPrefetch(DocumentLoader* loader, const char* path);
+Bool IsDocumentLoadPending(const DocumentLoader* loader, const char* path);
+// The request while it's in flight, NULL once it's finished or cancelled
+const DocumentLoad* PeekDocumentLoad(const DocumentLoader* loader, int requestId);
+// Removes the finished request and hands it to the caller, who frees outLoad->path. FALSE if it was cancelled.
+Bool FinishDocumentLoad(DocumentLoader* loader, int requestId, DocumentLoad* outLoad);
+void PollDocumentLoader(DocumentLoader* loader);
+
+// Reads <fileRoot><path> on the next poll, standing in for fetch; streamed a piece per poll when onChunk is set
+DocumentLoaderBackend GetFileLoaderBackend();
@@ -0,0 +1,140 @@
+#include "font_bundle.h"
+
+#include <raylib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Bool ValidateFontBundle(const unsigned char* bundle, size_t length) {
+    FontBundleHeader header;
+    if (length < sizeof(header)) {
+        printf("Font bundle too short\n");
+        return FALSE;
+    }
+    memcpy(&header, bundle, sizeof(header));
+
+    if (memcmp(header.magic, FONT_BUNDLE_MAGIC, 4) != 0 || header.headerSize != sizeof(header)) {
+        printf("Not a font bundle\n");
+        return FALSE;
+    }
+    if (header.version != FONT_BUNDLE_VERSION) {
+        printf("Font bundle version %d, expected %d\n", header.version, FONT_BUNDLE_VERSION);
+        return FALSE;
+    }
+    if (header.faceCount > FONT_BUNDLE_MAX_FACES ||
+        sizeof(header) + (uint64_t) header.faceCount * sizeof(FontBundleFace) > length) {
+        printf("Font bundle size mismatch\n");
+        return FALSE;
+    }
+    if (HashBytes(bundle + sizeof(header), length - sizeof(header)) != header.checksum) {
+        printf("Font bundle checksum mismatch\n");
+        return FALSE;
+    }
+
+    for (uint32_t i = 0; i < header.faceCount; i++) {
+        FontBundleFace face;
+        memcpy(&face, bundle + sizeof(header) + i * sizeof(FontBundleFace), sizeof(face));
+
+        uint64_t glyphEnd = (uint64_t) face.glyphOffset + (uint64_t) face.glyphCount * sizeof(FontBundleGlyph);
+        uint64_t pixelEnd = (uint64_t) face.pixelOffset + (uint64_t) face.atlasWidth * face.atlasHeight;
+        if (glyphEnd > length || pixelEnd > length || face.glyphCount == 0 || face.baseSize == 0) {
+            printf("Font bundle face %u is malformed\n", i);
+            return FALSE;
+        }
+
+        // distance field glyphs are copied with their falloff, which has to be inside the atlas too
+        uint32_t spread = face.distanceFieldSpread;
+        for (uint32_t g = 0; g < face.glyphCount; g++) {
+            FontBundleGlyph glyph;
+            memcpy(&glyph, bundle + face.glyphOffset + g * sizeof(FontBundleGlyph), sizeof(glyph));
+            if (glyph.x < spread || glyph.y < spread ||
+                (uint32_t) glyph.x + glyph.width + spread > face.atlasWidth ||
+                (uint32_t) glyph.y + glyph.height + spread > face.atlasHeight) {
+                printf("Font bundle face %u has a glyph outside its atlas\n", i);
+                return FALSE;
+            }
+        }
+    }
+
+    return TRUE;
+}
+
+static FontAtlas BindFace(const unsigned char* bundle, const FontBundleFace* face, GlyphAtlas* glyphAtlas, CanvasFontSpec canvas) {
+    Font font = {0};
+    font.baseSize = face->baseSize;
+    font.glyphCount = (int) face->glyphCount;
+    font.glyphPadding = face->distanceFieldSpread ? face->distanceFieldSpread : GLYPH_ATLAS_PADDING;
+    font.recs = (Rectangle*) calloc(face->glyphCount, sizeof(Rectangle));
+    font.glyphs = (GlyphInfo*) calloc(face->glyphCount, sizeof(GlyphInfo));
+    uint32_t* glyphSlots = (uint32_t*) malloc(face->glyphCount * sizeof(uint32_t));
+
+    // only the metrics are unpacked, pixels are copied into the glyph atlas when a glyph is first drawn
+    for (uint32_t i = 0; i < face->glyphCount; i++) {
+        FontBundleGlyph glyph;
+        memcpy(&glyph, bundle + face->glyphOffset + i * sizeof(FontBundleGlyph), sizeof(glyph));
+
+        font.glyphs[i].value = glyph.codepoint;
+        font.glyphs[i].offsetX = glyph.offsetX;
+        font.glyphs[i].offsetY = glyph.offsetY;
+        font.glyphs[i].advanceX = glyph.advanceX;
+        glyphSlots[i] = GLYPH_SLOT_NONE;
+    }
+
+    // canvas glyphs have to come out at the size the face was baked at
+    canvas.fontSize = face->baseSize;
+
+    FontAtlas atlas = {
+            .font = font,
+            .glyphCapacity = font.glyphCount,
+            .glyphAtlas = glyphAtlas,
+            .glyphSlots = glyphSlots,
+            .texelScale = 1.0f,
+            .distanceField = face->distanceFieldSpread != 0,
+            .bakedGlyphs = bundle + face->glyphOffset,
+            .bakedPixels = bundle + face->pixelOffset,
+            .bakedAtlasWidth = face->atlasWidth,
+            .bakedGlyphCount = font.glyphCount,
+            .canvas = canvas,
+    };
+
+    // codepoints that weren't baked come from the canvas when there is one, '?' otherwise
+    GlyphLookup closed = BuildGlyphLookup(&font);
+    atlas.missingGlyphIndex = closed.fallbackIndex;
+    if (canvas.name) {
+        UnloadGlyphLookup(&closed);
+        atlas.lookup = BuildOpenGlyphLookup(&font);
+    } else {
+        atlas.lookup = closed;
+    }
+    return atlas;
+}
+
+int LoadFontBundle(const unsigned char* bundle, size_t length, GlyphAtlas* glyphAtlas, FontAtlas* fonts, int fontSlots,
+                   const CanvasFontSpec* canvasFallbacks) {
+    if (!ValidateFontBundle(bundle, length)) {
+        return -1;
+    }
+
+    FontBundleHeader header;
+    memcpy(&header, bundle, sizeof(header));
+
+    int loaded = 0;
+    for (uint32_t i = 0; i < header.faceCount; i++) {
+        FontBundleFace face;
+        memcpy(&face, bundle + sizeof(header) + i * sizeof(FontBundleFace), sizeof(face));
+
+        if (face.fontId >= fontSlots) {
+            printf("Font bundle face %u targets slot %d, only %d slots\n", i, face.fontId, fontSlots);
+            continue;
+        }
+        if (fonts[face.fontId].font.glyphs) {
+            UnloadFontAtlas(&fonts[face.fontId]);
+        }
+
+        CanvasFontSpec canvas = canvasFallbacks ? canvasFallbacks[face.fontId] : (CanvasFontSpec){0};
+        fonts[face.fontId] = BindFace(bundle, &face, glyphAtlas, canvas);
+        loaded++;
+    }
+
+    return loaded;
+}
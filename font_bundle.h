@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "font_loader.h"
+#include "util.h"
+
+// Font atlases baked ahead of time by burogu_bake_fonts, so startup skips canvas rasterization.
+// Layout (little endian): header, face records, then per face its glyph records and coverage pixels.
+#define FONT_BUNDLE_MAGIC "BFNT"
+#define FONT_BUNDLE_VERSION 1
+#define FONT_BUNDLE_MAX_FACES 16
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t faceCount;
+    uint32_t reserved;
+    uint64_t checksum; // HashBytes over everything after the header
+} FontBundleHeader;
+
+typedef struct {
+    uint16_t fontId; // slot in the embedded font table
+    uint16_t baseSize;
+    uint16_t glyphPadding;
+    uint16_t atlasWidth;
+    uint16_t atlasHeight;
+    uint16_t distanceFieldSpread; // 0 for coverage faces, otherwise texels of falloff kept around every glyph
+    uint32_t glyphCount;
+    uint32_t glyphOffset; // from the start of the bundle
+    uint32_t pixelOffset; // atlasWidth * atlasHeight bytes of coverage or distance
+} FontBundleFace;
+
+typedef struct {
+    int32_t codepoint;
+    int16_t offsetX;
+    int16_t offsetY;
+    int16_t advanceX;
+    uint16_t x;
+    uint16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t reserved;
+} FontBundleGlyph;
+
+// Checks the header, checksum and that every face stays inside the bundle; needs no GL context
+Bool ValidateFontBundle(const unsigned char* bundle, size_t length);
+
+// Binds every face to fonts[face.fontId]; slots the bundle doesn't cover are left untouched. Glyphs are copied into
+// the glyph atlas as they're drawn, so the bundle has to outlive the fonts. canvasFallbacks (per slot, may be NULL)
+// supplies codepoints that weren't baked. Returns the number of faces loaded, or -1 if the bundle is rejected.
+int LoadFontBundle(const unsigned char* bundle, size_t length, GlyphAtlas* glyphAtlas, FontAtlas* fonts, int fontSlots,
+                   const CanvasFontSpec* canvasFallbacks);
@@ -1,120 +1,394 @@
 #include "font_loader.h"
 
+#include "font_bundle.h"
+
 #ifdef EMSCRIPTEN
 #include <emscripten.h>
 #include <emscripten/em_js.h>
 #endif
 
 #include <raylib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static GlyphLookup FillGlyphLookup(const Font* font, int fallbackIndex) {
+    GlyphLookup lookup = {0};
+    lookup.fallbackIndex = fallbackIndex;
+
+    for (int i = 0; i < GLYPH_LOOKUP_DIRECT_SIZE; i++) {
+        lookup.direct[i] = lookup.fallbackIndex;
+    }
+
+    lookup.pageMap = (unsigned short*) calloc(GLYPH_LOOKUP_PAGE_COUNT, sizeof(unsigned short));
+    for (int i = 0; i < font->glyphCount; i++) {
+        int codepoint = font->glyphs[i].value;
+        if (codepoint < GLYPH_LOOKUP_DIRECT_SIZE || codepoint >= 0x110000) continue;
+
+        int pageSlot = codepoint >> GLYPH_LOOKUP_PAGE_BITS;
+        if (lookup.pageMap[pageSlot] == 0) {
+            lookup.pageMap[pageSlot] = (unsigned short) (++lookup.pageCount);
+        }
+    }
+
+    lookup.pages = (int*) malloc((size_t) lookup.pageCount * GLYPH_LOOKUP_PAGE_SIZE * sizeof(int));
+    for (int i = 0; i < lookup.pageCount * GLYPH_LOOKUP_PAGE_SIZE; i++) {
+        lookup.pages[i] = lookup.fallbackIndex;
+    }
+
+    // walk backwards so the first glyph wins on duplicate codepoints, like GetGlyphIndex
+    for (int i = font->glyphCount - 1; i >= 0; i--) {
+        int codepoint = font->glyphs[i].value;
+        if (codepoint < 0 || codepoint >= 0x110000) continue;
+
+        if (codepoint < GLYPH_LOOKUP_DIRECT_SIZE) {
+            lookup.direct[codepoint] = i;
+        } else {
+            int page = lookup.pageMap[codepoint >> GLYPH_LOOKUP_PAGE_BITS] - 1;
+            lookup.pages[page * GLYPH_LOOKUP_PAGE_SIZE + (codepoint & (GLYPH_LOOKUP_PAGE_SIZE - 1))] = i;
+        }
+    }
+
+    return lookup;
+}
+
+GlyphLookup BuildGlyphLookup(const Font* font) {
+    int fallbackIndex = 0;
+    for (int i = 0; i < font->glyphCount; i++) {
+        if (font->glyphs[i].value == '?') {
+            fallbackIndex = i;
+            break;
+        }
+    }
+    return FillGlyphLookup(font, fallbackIndex);
+}
+
+GlyphLookup BuildOpenGlyphLookup(const Font* font) {
+    return FillGlyphLookup(font, -1);
+}
+
+void AddGlyphToLookup(GlyphLookup* lookup, int codepoint, int index) {
+    if (codepoint < 0 || codepoint >= 0x110000) return;
+
+    if (codepoint < GLYPH_LOOKUP_DIRECT_SIZE) {
+        lookup->direct[codepoint] = index;
+        return;
+    }
+
+    if (!lookup->pageMap) {
+        lookup->pageMap = (unsigned short*) calloc(GLYPH_LOOKUP_PAGE_COUNT, sizeof(unsigned short));
+    }
+    int pageSlot = codepoint >> GLYPH_LOOKUP_PAGE_BITS;
+    if (lookup->pageMap[pageSlot] == 0) {
+        lookup->pageCount++;
+        lookup->pages = (int*) realloc(lookup->pages, (size_t) lookup->pageCount * GLYPH_LOOKUP_PAGE_SIZE * sizeof(int));
+        int* page = &lookup->pages[(lookup->pageCount - 1) * GLYPH_LOOKUP_PAGE_SIZE];
+        for (int i = 0; i < GLYPH_LOOKUP_PAGE_SIZE; i++) {
+            page[i] = lookup->fallbackIndex;
+        }
+        lookup->pageMap[pageSlot] = (unsigned short) lookup->pageCount;
+    }
+
+    int page = lookup->pageMap[pageSlot] - 1;
+    lookup->pages[page * GLYPH_LOOKUP_PAGE_SIZE + (codepoint & (GLYPH_LOOKUP_PAGE_SIZE - 1))] = index;
+}
+
+void UnloadGlyphLookup(GlyphLookup* lookup) {
+    free(lookup->pageMap);
+    free(lookup->pages);
+    memset(lookup, 0, sizeof(*lookup));
+}
+
+static int AppendGlyph(FontAtlas* atlas, GlyphInfo glyph) {
+    Font* font = &atlas->font;
+    if (font->glyphCount == atlas->glyphCapacity) {
+        atlas->glyphCapacity = atlas->glyphCapacity ? atlas->glyphCapacity * 2 : 256;
+        font->glyphs = (GlyphInfo*) realloc(font->glyphs, atlas->glyphCapacity * sizeof(GlyphInfo));
+        font->recs = (Rectangle*) realloc(font->recs, atlas->glyphCapacity * sizeof(Rectangle));
+        atlas->glyphSlots = (uint32_t*) realloc(atlas->glyphSlots, atlas->glyphCapacity * sizeof(uint32_t));
+    }
+
+    int index = font->glyphCount++;
+    font->glyphs[index] = glyph;
+    font->recs[index] = (Rectangle){0};
+    atlas->glyphSlots[index] = GLYPH_SLOT_NONE;
+    return index;
+}
+
+// Packs one glyph, recording where it went; border texels around the glyph in src are packed too but kept out of the rec
+static Bool PackFontAtlasGlyph(FontAtlas* atlas, int index, const unsigned char* src, int width, int height, int stride,
+                               int border) {
+    Rectangle* rec = &atlas->font.recs[index];
+    if (!AddGlyphToAtlas(atlas->glyphAtlas, src, width, height, stride, &atlas->glyphSlots[index], rec)) {
+        atlas->glyphSlots[index] = GLYPH_SLOT_NONE;
+        return FALSE;
+    }
+
+    rec->x += border;
+    rec->y += border;
+    rec->width -= 2 * border;
+    rec->height -= 2 * border;
+    return TRUE;
+}
+
+#ifdef EMSCRIPTEN
+// canvas the glyphs are rasterized on before being packed, in physical pixels
+#define GLYPH_SCRATCH_SIZE 1024
 
 typedef struct {
-    float x, y, width, height, ascent, advance, bleedLeft;
+    int x, y, width, height; // physical pixels on the scratch canvas
 } GlyphRect;
 
 /* clang-format off */
-EM_JS(void, generate_system_font_atlas, (const char* fontName, int fontSize, const char* chars, const char* fontWeight, const char* fontStyle, unsigned char* pixelDest, GlyphRect* rectsDest, int atlasSize), {
-    const weight = UTF8ToString(fontWeight);
-    const style = UTF8ToString(fontStyle);
-    const name = UTF8ToString(fontName);
-    const text = UTF8ToString(chars);
-    const dpr = window.devicePixelRatio || 1;
+// Layout metrics only, no pixels: what measuring text needs
+EM_JS(void, measure_canvas_glyph, (const char* fontName, int fontSize, const char* fontWeight, const char* fontStyle, int codepoint, float* metricsDest), {
+    const ctx = Module.Burogu_GlyphContext(1, UTF8ToString(fontName), fontSize, UTF8ToString(fontWeight), UTF8ToString(fontStyle), 1);
+    const glyph = Module.Burogu_MeasureGlyph(ctx, String.fromCodePoint(codepoint), fontSize);
 
-    const canvas = document.createElement('canvas');
-    canvas.width = atlasSize * dpr;
-    canvas.height = atlasSize * dpr;
-    const ctx = canvas.getContext('2d', {willReadFrequently: true});
-
-    ctx.scale(dpr, dpr);
-    ctx.clearRect(0, 0, atlasSize, atlasSize);
-
-    ctx.font = `${style} ${weight} ${fontSize}px ${name}`;
-    ctx.textBaseline = "alphabetic";
-    ctx.fillStyle = "white";
+    HEAPF32[(metricsDest >> 2)] = -glyph.bleedLeft;
+    HEAPF32[(metricsDest >> 2) + 1] = fontSize - glyph.ascent;
+    HEAPF32[(metricsDest >> 2) + 2] = glyph.advance;
+});
 
-    let x = 0; let y = 0; const padding = 4;
+// Rasterizes codepoints in order until the scratch canvas is full, returns how many made it
+EM_JS(int, rasterize_glyph_batch, (const char* fontName, int fontSize, const char* fontWeight, const char* fontStyle, float scale, const int* codepoints, int count, unsigned char* coverageDest, GlyphRect* rectsDest, int scratchSize), {
+    const ctx = Module.Burogu_GlyphContext(scratchSize, UTF8ToString(fontName), fontSize, UTF8ToString(fontWeight), UTF8ToString(fontStyle), scale);
 
-    for (let i = 0; i < text.length; i++) {
-        const metrics = ctx.measureText(text[i]);
+    // shelf packing, rows as tall as their tallest glyph
+    let x = 0; let y = 0; let rowHeight = 0; const gap = 2;
+    let done = 0;
 
-        const ascent = Math.ceil(metrics.actualBoundingBoxAscent) || fontSize;
-        const descent = Math.ceil(metrics.actualBoundingBoxDescent) || 0;
-        const bleedLeft = Math.ceil(Math.abs(metrics.actualBoundingBoxLeft)) || 0;
+    for (; done < count; done++) {
+        const text = String.fromCodePoint(HEAP32[(codepoints >> 2) + done]);
+        const glyph = Module.Burogu_MeasureGlyph(ctx, text, fontSize);
 
-        const w = Math.ceil(metrics.width + bleedLeft + (metrics.actualBoundingBoxRight - metrics.width)) + 2;
-        const h = ascent + descent + 2;
+        const w = Math.ceil(glyph.width * scale);
+        const h = Math.ceil(glyph.height * scale);
 
-        if (x + w > atlasSize) {
+        if (x + w > scratchSize) {
             x = 0;
-            y += Math.ceil(fontSize * 1.2) + padding;
+            y += rowHeight + gap;
+            rowHeight = 0;
         }
-        
-        if (y + h > atlasSize) break;
+        if (y + h > scratchSize || w > scratchSize) break;
 
-        ctx.fillText(text[i], x + bleedLeft, y + ascent);
+        ctx.fillText(text, x / scale + glyph.bleedLeft, y / scale + glyph.ascent);
 
-        const offset = i * 28;
-        HEAPF32[(rectsDest + offset) >> 2] = x * dpr;
-        HEAPF32[(rectsDest + offset + 4) >> 2] = y * dpr;
-        HEAPF32[(rectsDest + offset + 8) >> 2] = w * dpr;
-        HEAPF32[(rectsDest + offset + 12) >> 2] = h * dpr;
-        HEAPF32[(rectsDest + offset + 16) >> 2] = ascent * dpr;
-        HEAPF32[(rectsDest + offset + 20) >> 2] = metrics.width * dpr;
-        HEAPF32[(rectsDest + offset + 24) >> 2] = bleedLeft * dpr;
+        const offset = (rectsDest >> 2) + done * 4;
+        HEAP32[offset] = x;
+        HEAP32[offset + 1] = y;
+        HEAP32[offset + 2] = w;
+        HEAP32[offset + 3] = h;
 
-        x += w + padding;
+        x += w + gap;
+        rowHeight = Math.max(rowHeight, h);
     }
 
-    const imgData = ctx.getImageData(0, 0, atlasSize * dpr, atlasSize * dpr).data;
-    HEAPU8.set(imgData, pixelDest);
+    // only the used rows, and only their alpha
+    const usedHeight = Math.min(scratchSize, y + rowHeight);
+    if (usedHeight > 0) {
+        const imgData = ctx.getImageData(0, 0, scratchSize, usedHeight).data;
+        for (let i = 0, n = scratchSize * usedHeight; i < n; i++) {
+            HEAPU8[coverageDest + i] = imgData[i * 4 + 3];
+        }
+    }
+
+    return done;
 });
 /* clang-format on */
 
-Font LoadFontAtlasFromJS(const char* fontName, int fontSize, const char* charset, const char* fontWeight, const char* fontStyle) {
-    int glyphCount = 0;
-    int* codepoints = LoadCodepoints(charset, &glyphCount);
+static void RasterizeCanvasGlyphs(FontAtlas* atlas, const int* glyphIndices, int count) {
+    int* codepoints = (int*) malloc(count * sizeof(int));
+    for (int i = 0; i < count; i++) {
+        codepoints[i] = atlas->font.glyphs[glyphIndices[i]].value;
+    }
+    unsigned char* coverage = (unsigned char*) malloc(GLYPH_SCRATCH_SIZE * GLYPH_SCRATCH_SIZE);
+    GlyphRect* rects = (GlyphRect*) malloc(count * sizeof(GlyphRect));
 
-    float dpr = emscripten_get_device_pixel_ratio();
-    int atlasSize = 1024;
+    unsigned char* field = NULL;
+    int spread = atlas->font.glyphPadding;
+    if (atlas->distanceField) {
+        int fieldSize = GLYPH_SCRATCH_SIZE + 2 * spread;
+        field = (unsigned char*) malloc((size_t) fieldSize * fieldSize);
+    }
 
-    int physicalWidth = (int) (atlasSize * dpr);
-    int physicalHeight = (int) (atlasSize * dpr);
+    const CanvasFontSpec* canvas = &atlas->canvas;
+    int done = 0;
+    while (done < count) {
+        int batch = rasterize_glyph_batch(canvas->name, canvas->fontSize, canvas->weight, canvas->style, atlas->texelScale,
+                                          codepoints + done, count - done, coverage, rects + done, GLYPH_SCRATCH_SIZE);
+        if (batch == 0) {
+            // a single glyph bigger than the scratch canvas, it stays blank
+            done++;
+            continue;
+        }
 
-    unsigned char* pixels = (unsigned char*) malloc(physicalWidth * physicalHeight * 4);
-    GlyphRect* rects = (GlyphRect*) malloc(glyphCount * sizeof(GlyphRect));
+        for (int i = done; i < done + batch; i++) {
+            const unsigned char* src = coverage + rects[i].y * GLYPH_SCRATCH_SIZE + rects[i].x;
+            if (!field) {
+                PackFontAtlasGlyph(atlas, glyphIndices[i], src, rects[i].width, rects[i].height, GLYPH_SCRATCH_SIZE, 0);
+                continue;
+            }
 
-    generate_system_font_atlas(fontName, fontSize, charset, fontWeight, fontStyle, pixels, rects, atlasSize);
+            int fieldWidth = rects[i].width + 2 * spread;
+            int fieldHeight = rects[i].height + 2 * spread;
+            BuildGlyphDistanceField(src, rects[i].width, rects[i].height, GLYPH_SCRATCH_SIZE, spread, field);
+            PackFontAtlasGlyph(atlas, glyphIndices[i], field, fieldWidth, fieldHeight, fieldWidth, spread);
+        }
+        done += batch;
+    }
 
-    Image img = {
-            .data = pixels,
-            .width = physicalWidth,
-            .height = physicalHeight,
-            .mipmaps = 1,
-            .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8,
-    };
+    free(field);
+    free(rects);
+    free(coverage);
+    free(codepoints);
+}
+#endif
+
+int AddFontAtlasGlyph(FontAtlas* atlas, int codepoint) {
+#ifdef EMSCRIPTEN
+    if (atlas->canvas.name && atlas->glyphAtlas) {
+        if (codepoint < 0 || codepoint >= 0x110000) {
+            return ResolveFontAtlasGlyph(atlas, '?');
+        }
+
+        const CanvasFontSpec* canvas = &atlas->canvas;
+        float metrics[3];
+        measure_canvas_glyph(canvas->name, canvas->fontSize, canvas->weight, canvas->style, codepoint, metrics);
+
+        int index = AppendGlyph(atlas, (GlyphInfo){
+                .value = codepoint,
+                .offsetX = (int) metrics[0],
+                .offsetY = (int) metrics[1],
+                .advanceX = (int) metrics[2],
+        });
+        AddGlyphToLookup(&atlas->lookup, codepoint, index);
+        return index;
+    }
+#endif
+
+    // nowhere to get it from, remember the substitute so the next lookup doesn't land here again
+    if (atlas->missingGlyphIndex >= 0) {
+        AddGlyphToLookup(&atlas->lookup, codepoint, atlas->missingGlyphIndex);
+    }
+    return atlas->missingGlyphIndex;
+}
+
+void RasterizeFontAtlasGlyphs(FontAtlas* atlas, const int* glyphIndices, int count) {
+    if (!atlas->glyphAtlas) return;
+
+    int* canvasGlyphs = (int*) malloc((count ? count : 1) * sizeof(int));
+    int canvasCount = 0;
+    int dropped = 0;
 
+    for (int i = 0; i < count; i++) {
+        int index = glyphIndices[i];
+        if (IsGlyphSlotResident(atlas->glyphAtlas, atlas->glyphSlots[index])) {
+            TouchGlyphSlot(atlas->glyphAtlas, atlas->glyphSlots[index]);
+            continue;
+        }
+
+        if (index >= atlas->bakedGlyphCount) {
+            canvasGlyphs[canvasCount++] = index;
+            continue;
+        }
+
+        // baked glyphs are a copy out of the bundle's own atlas, distance fields with their falloff
+        FontBundleGlyph baked;
+        memcpy(&baked, atlas->bakedGlyphs + index * sizeof(FontBundleGlyph), sizeof(baked));
+        int border = atlas->distanceField ? atlas->font.glyphPadding : 0;
+        const unsigned char* src =
+                atlas->bakedPixels + (size_t) (baked.y - border) * atlas->bakedAtlasWidth + (baked.x - border);
+        if (!PackFontAtlasGlyph(atlas, index, src, baked.width + 2 * border, baked.height + 2 * border,
+                                atlas->bakedAtlasWidth, border)) {
+            dropped++;
+        }
+    }
+
+#ifdef EMSCRIPTEN
+    if (canvasCount > 0) {
+        RasterizeCanvasGlyphs(atlas, canvasGlyphs, canvasCount);
+    }
+#endif
+    free(canvasGlyphs);
+
+    if (dropped > 0) {
+        printf("Glyph atlas full, %d glyphs skipped this frame\n", dropped);
+    }
+}
+
+FontAtlas CreateCanvasFontAtlas(GlyphAtlas* glyphAtlas, CanvasFontSpec canvas) {
     Font font = {0};
-    font.baseSize = fontSize;
-    font.glyphCount = glyphCount;
-    font.texture = LoadTextureFromImage(img);
+    font.baseSize = canvas.fontSize;
+    font.glyphPadding = GLYPH_ATLAS_PADDING;
 
-    GenTextureMipmaps(&font.texture);
-    SetTextureFilter(font.texture, TEXTURE_FILTER_TRILINEAR);
+    float texelScale = 1.0f;
+#ifdef EMSCRIPTEN
+    texelScale = (float) emscripten_get_device_pixel_ratio();
+#endif
 
-    font.recs = (Rectangle*) malloc(glyphCount * sizeof(Rectangle));
-    font.glyphs = (GlyphInfo*) malloc(glyphCount * sizeof(GlyphInfo));
+    return (FontAtlas){
+            .font = font,
+            .lookup = BuildOpenGlyphLookup(&font),
+            .glyphAtlas = glyphAtlas,
+            .texelScale = texelScale,
+            .canvas = canvas,
+            .missingGlyphIndex = -1,
+    };
+}
+
+FontAtlas CreateDistanceFieldFontAtlas(GlyphAtlas* glyphAtlas, CanvasFontSpec canvas) {
+    FontAtlas atlas = CreateCanvasFontAtlas(glyphAtlas, canvas);
+    atlas.font.glyphPadding = GLYPH_SDF_SPREAD;
+    atlas.texelScale = 1.0f;
+    atlas.distanceField = TRUE;
+    return atlas;
+}
 
-    for (int i = 0; i < glyphCount; i++) {
-        font.recs[i] = (Rectangle){rects[i].x, rects[i].y, rects[i].width, rects[i].height};
+FontAtlas ShareFontAtlasFace(FontAtlas* face) {
+    return (FontAtlas){
+            .font = {.baseSize = face->font.baseSize},
+            .sharedFace = face,
+            .missingGlyphIndex = -1,
+    };
+}
+
+FontAtlas LoadFixedMetricFont(int fontSize, const int* codepoints, int codepointCount) {
+    Font font = {0};
+    font.baseSize = fontSize;
+    font.glyphCount = codepointCount;
+    font.recs = (Rectangle*) malloc(codepointCount * sizeof(Rectangle));
+    font.glyphs = (GlyphInfo*) malloc(codepointCount * sizeof(GlyphInfo));
 
-        font.glyphs[i].value = codepoints[i];
-        font.glyphs[i].offsetX = (int) (-rects[i].bleedLeft / dpr);
-        font.glyphs[i].offsetY = (int) (fontSize - rects[i].ascent / dpr);
+    for (int i = 0; i < codepointCount; i++) {
+        // half-width for latin, full-width for everything from the CJK radicals block upwards
+        int advance = (codepoints[i] < 0x2E80) ? (fontSize + 1) / 2 : fontSize;
 
-        font.glyphs[i].advanceX = (int) (rects[i].advance / dpr);
+        font.recs[i] = (Rectangle){0, 0, (float) advance, (float) fontSize};
+        font.glyphs[i] = (GlyphInfo){
+                .value = codepoints[i],
+                .offsetX = 0,
+                .offsetY = 0,
+                .advanceX = advance,
+        };
     }
 
-    UnloadImage(img);
-    free(rects);
-    UnloadCodepoints(codepoints);
-    return font;
-}
\ No newline at end of file
+    FontAtlas atlas = {
+            .font = font,
+            .lookup = BuildGlyphLookup(&font),
+            .glyphCapacity = codepointCount,
+            .texelScale = 1.0f,
+    };
+    atlas.missingGlyphIndex = atlas.lookup.fallbackIndex;
+    return atlas;
+}
+
+void UnloadFontAtlas(FontAtlas* atlas) {
+    UnloadGlyphLookup(&atlas->lookup);
+
+    // the pixels belong to the shared glyph atlas, only the metrics are ours
+    free(atlas->font.recs);
+    free(atlas->font.glyphs);
+    free(atlas->glyphSlots);
+    memset(atlas, 0, sizeof(*atlas));
+}
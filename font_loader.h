@@ -1,5 +1,109 @@
 #pragma once
 
 #include <raylib.h>
+#include <stdint.h>
 
-Font LoadFontAtlasFromJS(const char* fontName, int fontSize, const char* charset, const char* fontWeight, const char* fontStyle);
\ No newline at end of file
+#include "glyph_atlas.h"
+
+// Codepoints below this are resolved through a flat table (Basic Latin through Latin Extended-B)
+#define GLYPH_LOOKUP_DIRECT_SIZE 0x250
+
+// Everything else goes through a two-level page table over the whole Unicode range
+#define GLYPH_LOOKUP_PAGE_BITS 8
+#define GLYPH_LOOKUP_PAGE_SIZE (1 << GLYPH_LOOKUP_PAGE_BITS)
+#define GLYPH_LOOKUP_PAGE_COUNT (0x110000 >> GLYPH_LOOKUP_PAGE_BITS)
+
+typedef struct {
+    int direct[GLYPH_LOOKUP_DIRECT_SIZE];
+    unsigned short* pageMap; // one slot per page, 0 = no glyphs in that page, otherwise page number + 1
+    int* pages;              // pageCount * GLYPH_LOOKUP_PAGE_SIZE glyph indices
+    int pageCount;
+    int fallbackIndex; // same fallback as raylib's GetGlyphIndex: '?' if present, glyph 0 otherwise
+} GlyphLookup;
+
+// Browser font a glyph can be rasterized from on demand
+typedef struct {
+    const char* name; // NULL when there is no canvas (native builds)
+    int fontSize;
+    const char* weight;
+    const char* style;
+} CanvasFontSpec;
+
+// Glyphs are added the first time a codepoint is measured and only rasterized into the shared glyph atlas once
+// drawn; a page being recycled just sends its glyphs back through rasterization. font.texture stays empty.
+typedef struct FontAtlas {
+    Font font;
+    GlyphLookup lookup; // fallbackIndex is -1 while codepoints can still be added
+    int glyphCapacity;
+
+    GlyphAtlas* glyphAtlas; // NULL for headless fonts
+    uint32_t* glyphSlots;   // where each glyph is packed, GLYPH_SLOT_NONE until it is first drawn
+    float texelScale;       // atlas texels per unit of font.baseSize, the DPR the glyphs were rasterized at
+
+    // distance field faces keep GLYPH_SDF_SPREAD texels of falloff around each rec (font.glyphPadding) and are drawn
+    // with the glyph atlas' distance field shader, which stays sharp at any size or DPR
+    Bool distanceField;
+    struct FontAtlas* sharedFace; // set when this slot measures and draws with another slot's glyphs
+
+    // the first bakedGlyphCount glyphs come from a baked font bundle, which has to outlive the font
+    const unsigned char* bakedGlyphs; // FontBundleGlyph records
+    const unsigned char* bakedPixels;
+    int bakedAtlasWidth;
+    int bakedGlyphCount;
+
+    CanvasFontSpec canvas; // everything else
+    int missingGlyphIndex; // drawn for codepoints that can't be added, -1 until there is a glyph to use
+} FontAtlas;
+
+// The font whose glyphs a slot actually uses
+static inline struct FontAtlas* ResolveFontAtlasFace(struct FontAtlas* atlas) {
+    return atlas->sharedFace ? atlas->sharedFace : atlas;
+}
+
+static inline int GetFontAtlasGlyphIndex(const FontAtlas* atlas, int codepoint) {
+    const GlyphLookup* lookup = &atlas->lookup;
+    if ((unsigned int) codepoint < GLYPH_LOOKUP_DIRECT_SIZE) {
+        return lookup->direct[codepoint];
+    }
+    if ((unsigned int) codepoint >= 0x110000 || !lookup->pageMap) {
+        return lookup->fallbackIndex;
+    }
+
+    unsigned short page = lookup->pageMap[codepoint >> GLYPH_LOOKUP_PAGE_BITS];
+    if (page == 0) {
+        return lookup->fallbackIndex;
+    }
+    return lookup->pages[(page - 1) * GLYPH_LOOKUP_PAGE_SIZE + (codepoint & (GLYPH_LOOKUP_PAGE_SIZE - 1))];
+}
+
+GlyphLookup BuildGlyphLookup(const Font* font);
+// Same, but codepoints the font doesn't have map to -1 instead of a fallback glyph
+GlyphLookup BuildOpenGlyphLookup(const Font* font);
+void AddGlyphToLookup(GlyphLookup* lookup, int codepoint, int index);
+void UnloadGlyphLookup(GlyphLookup* lookup);
+
+// Adds a codepoint the lookup doesn't know yet; returns its glyph index, missingGlyphIndex when it can't be added
+int AddFontAtlasGlyph(FontAtlas* atlas, int codepoint);
+
+static inline int ResolveFontAtlasGlyph(FontAtlas* atlas, int codepoint) {
+    int index = GetFontAtlasGlyphIndex(atlas, codepoint);
+    return (index >= 0) ? index : AddFontAtlasGlyph(atlas, codepoint);
+}
+
+// Packs the given glyphs into the shared glyph atlas (call UploadGlyphAtlas afterwards); glyphs already resident are
+// only touched. Glyphs that don't fit stay non-resident and aren't drawn this frame.
+void RasterizeFontAtlasGlyphs(FontAtlas* atlas, const int* glyphIndices, int count);
+
+// Empty font that picks up glyphs from the canvas as they're used
+FontAtlas CreateCanvasFontAtlas(GlyphAtlas* glyphAtlas, CanvasFontSpec canvas);
+// Same, but glyphs are stored as distance fields rasterized at canvas.fontSize regardless of DPR, so one face serves
+// every size the weight and style are drawn at
+FontAtlas CreateDistanceFieldFontAtlas(GlyphAtlas* glyphAtlas, CanvasFontSpec canvas);
+// Makes slot draw with face's glyphs; face has to outlive it
+FontAtlas ShareFontAtlasFace(FontAtlas* face);
+
+// Builds a texture-less font whose glyphs all share one advance per width class,
+// so text can be measured headlessly (benchmarks, native tooling).
+FontAtlas LoadFixedMetricFont(int fontSize, const int* codepoints, int codepointCount);
+
+void UnloadFontAtlas(FontAtlas* atlas);
@@ -0,0 +1,185 @@
+#include "frame_profiler.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+const char* const profilePhaseNames[PROFILE_PHASE_COUNT] = {
+        "input",
+        "document",
+        "layout",
+        "end layout",
+        "render",
+};
+
+const char* const profileCounterNames[PROFILE_COUNTER_COUNT] = {
+        "measure text",
+        "measure misses",
+        "glyph lookups",
+        "rectangles",
+        "borders",
+        "texts",
+        "images",
+        "scissors",
+        "custom",
+        "culled",
+        "texture switches",
+        "batch flushes",
+};
+
+static double NowSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+void InitFrameProfiler(FrameProfiler* profiler) {
+    memset(profiler, 0, sizeof(*profiler));
+    profiler->origin = NowSeconds();
+    profiler->activePhase = -1;
+}
+
+void BeginProfiledFrame(FrameProfiler* profiler) {
+    profiler->frameStart = NowSeconds();
+    profiler->activePhase = -1;
+    memset(&profiler->current, 0, sizeof(profiler->current));
+    profiler->current.start = profiler->frameStart - profiler->origin;
+}
+
+void EndProfiledPhase(FrameProfiler* profiler) {
+    if (profiler->activePhase < 0) {
+        return;
+    }
+
+    double now = NowSeconds();
+    FrameSample* sample = &profiler->current;
+    float duration = (float) ((now - profiler->phaseStart) * 1000.0);
+    sample->phases[profiler->activePhase] += duration;
+    if (sample->segmentCount < FRAME_PROFILER_MAX_SEGMENTS) {
+        sample->segments[sample->segmentCount++] = (ProfileSegment){
+                .phase = (uint8_t) profiler->activePhase,
+                .start = (float) ((profiler->phaseStart - profiler->frameStart) * 1000.0),
+                .duration = duration,
+        };
+    }
+    profiler->activePhase = -1;
+}
+
+void BeginProfiledPhase(FrameProfiler* profiler, ProfilePhase phase) {
+    EndProfiledPhase(profiler);
+    profiler->activePhase = phase;
+    profiler->phaseStart = NowSeconds();
+}
+
+void SetProfiledCounter(FrameProfiler* profiler, ProfileCounter counter, uint32_t value) {
+    profiler->current.counters[counter] = value;
+}
+
+void EndProfiledFrame(FrameProfiler* profiler) {
+    EndProfiledPhase(profiler);
+    profiler->current.total = (float) ((NowSeconds() - profiler->frameStart) * 1000.0);
+
+    profiler->frames[profiler->next] = profiler->current;
+    profiler->next = (profiler->next + 1) % FRAME_PROFILER_HISTORY;
+    if (profiler->count < FRAME_PROFILER_HISTORY) {
+        profiler->count++;
+    }
+}
+
+// The i-th frame kept, oldest first
+static const FrameSample* GetProfiledFrame(const FrameProfiler* profiler, int i) {
+    int first = profiler->count < FRAME_PROFILER_HISTORY ? 0 : profiler->next;
+    return &profiler->frames[(first + i) % FRAME_PROFILER_HISTORY];
+}
+
+const FrameSample* GetLastProfiledFrame(const FrameProfiler* profiler) {
+    return profiler->count > 0 ? GetProfiledFrame(profiler, profiler->count - 1) : NULL;
+}
+
+static int CompareFloats(const void* a, const void* b) {
+    float x = *(const float*) a;
+    float y = *(const float*) b;
+    return (x > y) - (x < y);
+}
+
+ProfilePercentiles GetProfiledPhasePercentiles(const FrameProfiler* profiler, int phase) {
+    ProfilePercentiles result = {0};
+    if (profiler->count == 0) {
+        return result;
+    }
+
+    float values[FRAME_PROFILER_HISTORY];
+    for (int i = 0; i < profiler->count; i++) {
+        const FrameSample* frame = GetProfiledFrame(profiler, i);
+        values[i] = phase == PROFILE_PHASE_COUNT ? frame->total : frame->phases[phase];
+    }
+    qsort(values, profiler->count, sizeof(float), CompareFloats);
+
+    // nearest rank
+    int last = profiler->count - 1;
+    result.p50 = values[last * 50 / 100];
+    result.p95 = values[last * 95 / 100];
+    result.p99 = values[last * 99 / 100];
+    result.max = values[last];
+    return result;
+}
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} TraceWriter;
+
+static void AppendTrace(TraceWriter* writer, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+
+    if (writer->length + needed + 1 > writer->capacity) {
+        size_t capacity = writer->capacity ? writer->capacity : 4096;
+        while (writer->length + needed + 1 > capacity) capacity *= 2;
+        writer->data = (char*) realloc(writer->data, capacity);
+        writer->capacity = capacity;
+    }
+    vsnprintf(writer->data + writer->length, needed + 1, format, args);
+    writer->length += needed;
+    va_end(args);
+}
+
+char* ExportFrameProfileTrace(const FrameProfiler* profiler, size_t* outLength) {
+    TraceWriter writer = {0};
+    AppendTrace(&writer, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    AppendTrace(&writer, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main loop\"}}");
+
+    // timestamps and durations are in microseconds
+    for (int i = 0; i < profiler->count; i++) {
+        const FrameSample* frame = GetProfiledFrame(profiler, i);
+        double frameStart = frame->start * 1000000.0;
+        AppendTrace(&writer, ",\n{\"name\":\"frame\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                    frameStart, frame->total * 1000.0);
+
+        for (int s = 0; s < frame->segmentCount; s++) {
+            const ProfileSegment* segment = &frame->segments[s];
+            AppendTrace(&writer, ",\n{\"name\":\"%s\",\"cat\":\"phase\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+                        profilePhaseNames[segment->phase], frameStart + segment->start * 1000.0,
+                        segment->duration * 1000.0);
+        }
+
+        AppendTrace(&writer, ",\n{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"args\":{", frameStart);
+        for (int c = 0; c < PROFILE_COUNTER_COUNT; c++) {
+            AppendTrace(&writer, "%s\"%s\":%u", c > 0 ? "," : "", profileCounterNames[c], frame->counters[c]);
+        }
+        AppendTrace(&writer, "}}");
+    }
+
+    AppendTrace(&writer, "\n]}\n");
+    if (outLength) {
+        *outLength = writer.length;
+    }
+    return writer.data;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+// Frames kept for the percentiles and the trace export, ten seconds at 60 fps
+#define FRAME_PROFILER_HISTORY 600
+// Phases a frame can go through, one entered twice counts twice
+#define FRAME_PROFILER_MAX_SEGMENTS 12
+
+typedef enum {
+    PROFILE_PHASE_INPUT,      // raylib input, the search box, pointer and scroll state
+    PROFILE_PHASE_DOCUMENT,   // loader polling, streamed parsing and prefetches
+    PROFILE_PHASE_LAYOUT,     // MainContainer declaring the layout
+    PROFILE_PHASE_END_LAYOUT, // Clay_EndLayout: measuring text, sizing and positioning
+    PROFILE_PHASE_RENDER,     // Clay_Raylib_Render up to the last batch handed to the GPU
+    PROFILE_PHASE_COUNT,
+} ProfilePhase;
+
+typedef enum {
+    PROFILE_COUNTER_MEASURE_TEXT,
+    PROFILE_COUNTER_MEASURE_MISSES,
+    PROFILE_COUNTER_GLYPH_LOOKUPS,
+    PROFILE_COUNTER_RECTANGLES,
+    PROFILE_COUNTER_BORDERS,
+    PROFILE_COUNTER_TEXTS,
+    PROFILE_COUNTER_IMAGES,
+    PROFILE_COUNTER_SCISSORS,
+    PROFILE_COUNTER_CUSTOM,
+    PROFILE_COUNTER_CULLED,
+    PROFILE_COUNTER_TEXTURE_SWITCHES,
+    PROFILE_COUNTER_BATCH_FLUSHES,
+    PROFILE_COUNTER_COUNT,
+} ProfileCounter;
+
+extern const char* const profilePhaseNames[PROFILE_PHASE_COUNT];
+extern const char* const profileCounterNames[PROFILE_COUNTER_COUNT];
+
+typedef struct {
+    uint8_t phase; // ProfilePhase
+    float start;   // ms after the frame started
+    float duration;
+} ProfileSegment;
+
+typedef struct {
+    double start; // seconds since the profiler was set up
+    float total;  // ms from BeginProfiledFrame to EndProfiledFrame
+    float phases[PROFILE_PHASE_COUNT];
+    ProfileSegment segments[FRAME_PROFILER_MAX_SEGMENTS];
+    int segmentCount;
+    uint32_t counters[PROFILE_COUNTER_COUNT];
+} FrameSample;
+
+// Times the frames that get drawn; a frame that's begun but never ended (the idle path) is simply dropped
+typedef struct {
+    FrameSample frames[FRAME_PROFILER_HISTORY]; // ring, oldest at next once it's full
+    int next;
+    int count;
+
+    FrameSample current;
+    double origin;
+    double frameStart;
+    double phaseStart;
+    int activePhase; // -1 between phases
+} FrameProfiler;
+
+typedef struct {
+    float p50;
+    float p95;
+    float p99;
+    float max;
+} ProfilePercentiles;
+
+void InitFrameProfiler(FrameProfiler* profiler);
+void BeginProfiledFrame(FrameProfiler* profiler);
+// Ends the phase that's running, if any
+void BeginProfiledPhase(FrameProfiler* profiler, ProfilePhase phase);
+void EndProfiledPhase(FrameProfiler* profiler);
+void SetProfiledCounter(FrameProfiler* profiler, ProfileCounter counter, uint32_t value);
+void EndProfiledFrame(FrameProfiler* profiler);
+
+// NULL before the first frame
+const FrameSample* GetLastProfiledFrame(const FrameProfiler* profiler);
+// Over the frames kept, in ms; PROFILE_PHASE_COUNT stands for the whole frame
+ProfilePercentiles GetProfiledPhasePercentiles(const FrameProfiler* profiler, int phase);
+// Chrome trace-event JSON of the frames kept (chrome://tracing or Perfetto): phases as complete events nested under
+// their frame, counters as counter events. Malloc'd and NUL-terminated.
+char* ExportFrameProfileTrace(const FrameProfiler* profiler, size_t* outLength);
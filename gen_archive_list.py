@@ -1,12 +1,134 @@
 import os
+import struct
 
-def generate_index(input_dir, output_file):
+# keep in step with archive_list.h and search_index.h / search_index.c
+ARCHIVE_MANIFEST_MAGIC = b"BARC"
+ARCHIVE_MANIFEST_VERSION = 1
+SEARCH_INDEX_MAGIC = b"BSIX"
+SEARCH_INDEX_VERSION = 1
+SEARCH_MAX_TOKEN_LENGTH = 32
+
+def served_file(input_dir, filename):
+    # prefer the precompiled document from burogu_compile when it is there
+    compiled = os.path.splitext(filename)[0] + ".bdoc"
+    return compiled if os.path.exists(os.path.join(input_dir, compiled)) else filename
+
+def list_posts(input_dir):
+    # (display name, markdown file), in the order they're listed; the search index numbers documents the same way
     files = sorted([f for f in os.listdir(input_dir) if f.endswith('.md')])
+    posts = [("Main Page", "_main.md")]
+    for filename in files:
+        if filename == "_main.md": continue
+        posts.append((os.path.splitext(filename)[0].replace('_', ' ').title(), filename))
+    return posts
+
+def generate_index(input_dir, posts, output_file):
     with open(output_file, 'w', encoding='utf-8') as f:
-        f.write("Main Page,_main.md\n")
-        for filename in files:
-            if filename == "_main.md": continue
-            display_name = os.path.splitext(filename)[0].replace('_', ' ').title()
-            f.write(f"{display_name},{filename}\n")
+        for display_name, filename in posts:
+            f.write(f"{display_name},{served_file(input_dir, filename)}\n")
+
+def generate_manifest(input_dir, posts, output_file):
+    # the same list as archives.txt, in the binary form the viewer loads in one piece
+    strings = bytearray()
+    records = b""
+    for display_name, filename in posts:
+        name = display_name.encode('utf-8')
+        path = served_file(input_dir, filename).encode('utf-8')
+        records += struct.pack("<IIII", len(strings), len(name), len(strings) + len(name) + 1, len(path))
+        strings += name + b"\0" + path + b"\0"
+
+    body = records + bytes(strings)
+    header = struct.pack("<4sHHIIQ", ARCHIVE_MANIFEST_MAGIC, ARCHIVE_MANIFEST_VERSION, 24, len(posts), len(strings),
+                         hash_bytes(body))
+    with open(output_file, 'wb') as f:
+        f.write(header + body)
+
+def is_cjk(c):
+    cp = ord(c)
+    return (0x3040 <= cp <= 0x30FF or 0x3400 <= cp <= 0x4DBF or 0x4E00 <= cp <= 0x9FFF or
+            0xAC00 <= cp <= 0xD7AF or 0xF900 <= cp <= 0xFAFF)
+
+def tokenize(text):
+    # lowercase ASCII words and CJK bigrams (a lone CJK character stays a unigram), same as TokenizeSearchQuery
+    tokens = set()
+    word = []
+    run = []
+
+    def flush_word():
+        if word:
+            tokens.add("".join(word).lower()[:SEARCH_MAX_TOKEN_LENGTH])
+            word.clear()
+
+    def flush_run():
+        if len(run) == 1:
+            tokens.add(run[0])
+        for i in range(len(run) - 1):
+            tokens.add(run[i] + run[i + 1])
+        run.clear()
+
+    for c in text:
+        if c.isascii() and c.isalnum():
+            flush_run()
+            word.append(c)
+        elif is_cjk(c):
+            flush_word()
+            run.append(c)
+        else:
+            flush_word()
+            flush_run()
+    flush_word()
+    flush_run()
+    return tokens
+
+def encode_varint(value, out):
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+
+def hash_bytes(data):
+    # HashBytes from util.h
+    mask = (1 << 64) - 1
+    h = 0xcbf29ce484222325
+    full = len(data) - len(data) % 8
+    for i in range(0, full, 8):
+        h = ((h ^ int.from_bytes(data[i:i + 8], 'little')) * 0x100000001b3) & mask
+        h ^= h >> 29
+    for b in data[full:]:
+        h = ((h ^ b) * 0x100000001b3) & mask
+    return h ^ (h >> 32)
+
+def generate_search_index(input_dir, posts, output_file):
+    postings = {}
+    for document, (display_name, filename) in enumerate(posts):
+        path = os.path.join(input_dir, filename)
+        text = display_name
+        if os.path.exists(path):
+            with open(path, 'r', encoding='utf-8', errors='replace') as f:
+                text += "\n" + f.read()
+        for token in tokenize(text):
+            postings.setdefault(token.encode('utf-8'), []).append(document)
+
+    terms = b""
+    records = b""
+    lists = bytearray()
+    for term in sorted(postings):
+        documents = postings[term]
+        records += struct.pack("<IHHII", len(terms), len(term), 0, len(lists), len(documents))
+        terms += term
+        previous = 0
+        for i, document in enumerate(documents):
+            encode_varint(document if i == 0 else document - previous, lists)
+            previous = document
+
+    body = records + terms + bytes(lists)
+    header = struct.pack("<4sHHIIIIQ", SEARCH_INDEX_MAGIC, SEARCH_INDEX_VERSION, 32, len(posts), len(postings),
+                         len(terms), len(lists), hash_bytes(body))
+    with open(output_file, 'wb') as f:
+        f.write(header + body)
+    print(f"Search index: {len(posts)} posts, {len(postings)} terms, {len(header) + len(body)} bytes")
 
-generate_index("markdown/", "markdown/archives.txt")
\ No newline at end of file
+posts = list_posts("markdown/")
+generate_index("markdown/", posts, "markdown/archives.txt")
+generate_manifest("markdown/", posts, "markdown/archives.bin")
+generate_search_index("markdown/", posts, "markdown/search.index")
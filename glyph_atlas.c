@@ -0,0 +1,408 @@
+#include "glyph_atlas.h"
+
+#include <math.h>
+#include <raylib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Red channel is the coverage on both backends: GL_LUMINANCE on WebGL, swizzled R8 on desktop GL
+// Distance field glyphs: the outline sits at 0.5, fwidth keeps the edge about a pixel wide at any scale
+#ifdef EMSCRIPTEN
+static const char* distanceFieldFragmentShader =
+        "#version 100\n"
+        "#extension GL_OES_standard_derivatives : enable\n"
+        "precision mediump float;\n"
+        "varying vec2 fragTexCoord;\n"
+        "varying vec4 fragColor;\n"
+        "uniform sampler2D texture0;\n"
+        "uniform vec4 colDiffuse;\n"
+        "void main() {\n"
+        "    float distance = texture2D(texture0, fragTexCoord).r;\n"
+        "    float smoothing = max(fwidth(distance) * 0.5, 0.001);\n"
+        "    float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);\n"
+        "    gl_FragColor = vec4(fragColor.rgb * colDiffuse.rgb, fragColor.a * colDiffuse.a * alpha);\n"
+        "}\n";
+#else
+static const char* distanceFieldFragmentShader =
+        "#version 330\n"
+        "in vec2 fragTexCoord;\n"
+        "in vec4 fragColor;\n"
+        "uniform sampler2D texture0;\n"
+        "uniform vec4 colDiffuse;\n"
+        "out vec4 finalColor;\n"
+        "void main() {\n"
+        "    float distance = texture(texture0, fragTexCoord).r;\n"
+        "    float smoothing = max(fwidth(distance) * 0.5, 0.001);\n"
+        "    float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);\n"
+        "    finalColor = vec4(fragColor.rgb * colDiffuse.rgb, fragColor.a * colDiffuse.a * alpha);\n"
+        "}\n";
+#endif
+
+#ifdef EMSCRIPTEN
+static const char* coverageFragmentShader =
+        "#version 100\n"
+        "precision mediump float;\n"
+        "varying vec2 fragTexCoord;\n"
+        "varying vec4 fragColor;\n"
+        "uniform sampler2D texture0;\n"
+        "uniform vec4 colDiffuse;\n"
+        "void main() {\n"
+        "    float coverage = texture2D(texture0, fragTexCoord).r;\n"
+        "    gl_FragColor = vec4(fragColor.rgb * colDiffuse.rgb, fragColor.a * colDiffuse.a * coverage);\n"
+        "}\n";
+#else
+static const char* coverageFragmentShader =
+        "#version 330\n"
+        "in vec2 fragTexCoord;\n"
+        "in vec4 fragColor;\n"
+        "uniform sampler2D texture0;\n"
+        "uniform vec4 colDiffuse;\n"
+        "out vec4 finalColor;\n"
+        "void main() {\n"
+        "    float coverage = texture(texture0, fragTexCoord).r;\n"
+        "    finalColor = vec4(fragColor.rgb * colDiffuse.rgb, fragColor.a * colDiffuse.a * coverage);\n"
+        "}\n";
+#endif
+
+void InitGlyphAtlas(GlyphAtlas* atlas, int pageSize, int pageBudget) {
+    memset(atlas, 0, sizeof(*atlas));
+    atlas->pageSize = pageSize;
+    atlas->pageBudget = (pageBudget > 0 && pageBudget <= GLYPH_ATLAS_MAX_PAGES) ? pageBudget : GLYPH_ATLAS_MAX_PAGES;
+    atlas->coverageShader = LoadShaderFromMemory(NULL, coverageFragmentShader);
+    atlas->distanceFieldShader = LoadShaderFromMemory(NULL, distanceFieldFragmentShader);
+}
+
+void FreeGlyphAtlas(GlyphAtlas* atlas) {
+    for (int i = 0; i < atlas->pageCount; i++) {
+        GlyphAtlasPage* page = &atlas->pages[i];
+        if (page->texture.id != 0) {
+            UnloadTexture(page->texture);
+        }
+        free(page->pixels);
+        free(page->skyline);
+    }
+    if (atlas->coverageShader.id != 0) {
+        UnloadShader(atlas->coverageShader);
+    }
+    if (atlas->distanceFieldShader.id != 0) {
+        UnloadShader(atlas->distanceFieldShader);
+    }
+    memset(atlas, 0, sizeof(*atlas));
+}
+
+void BeginGlyphAtlasFrame(GlyphAtlas* atlas) {
+    atlas->frame++;
+}
+
+static void MarkPageDirty(GlyphAtlasPage* page, int x, int y, int width, int height) {
+    if (x < page->dirtyMinX) page->dirtyMinX = x;
+    if (y < page->dirtyMinY) page->dirtyMinY = y;
+    if (x + width - 1 > page->dirtyMaxX) page->dirtyMaxX = x + width - 1;
+    if (y + height - 1 > page->dirtyMaxY) page->dirtyMaxY = y + height - 1;
+}
+
+static void ResetPage(GlyphAtlas* atlas, GlyphAtlasPage* page) {
+    page->skyline[0] = (SkylineNode){0, 0, atlas->pageSize};
+    page->skylineCount = 1;
+    page->lastUsedFrame = atlas->frame;
+    page->dirtyMinX = page->dirtyMinY = atlas->pageSize;
+    page->dirtyMaxX = page->dirtyMaxY = -1;
+}
+
+static GlyphAtlasPage* OpenPage(GlyphAtlas* atlas) {
+    if (atlas->pageCount == atlas->pageBudget) {
+        return NULL;
+    }
+
+    GlyphAtlasPage* page = &atlas->pages[atlas->pageCount++];
+    memset(page, 0, sizeof(*page));
+    page->pixels = (unsigned char*) calloc((size_t) atlas->pageSize * atlas->pageSize, 1);
+    // the skyline never has more nodes than the page has columns
+    page->skyline = (SkylineNode*) malloc((atlas->pageSize + 1) * sizeof(SkylineNode));
+    ResetPage(atlas, page);
+    return page;
+}
+
+// Clears the least recently drawn page for reuse; pages drawn from this frame still have quads in flight
+static GlyphAtlasPage* RecyclePage(GlyphAtlas* atlas) {
+    GlyphAtlasPage* oldest = NULL;
+    for (int i = 0; i < atlas->pageCount; i++) {
+        GlyphAtlasPage* page = &atlas->pages[i];
+        if (page->lastUsedFrame == atlas->frame) continue;
+        if (!oldest || page->lastUsedFrame < oldest->lastUsedFrame) {
+            oldest = page;
+        }
+    }
+    if (!oldest) {
+        return NULL;
+    }
+
+    memset(oldest->pixels, 0, (size_t) atlas->pageSize * atlas->pageSize);
+    oldest->generation++;
+    ResetPage(atlas, oldest);
+    MarkPageDirty(oldest, 0, 0, atlas->pageSize, atlas->pageSize);
+    return oldest;
+}
+
+// Height the rect would rest at if its left edge sat on node index, -1 if it doesn't fit there
+static int SkylineFitAt(const GlyphAtlasPage* page, int pageSize, int index, int width, int height) {
+    int x = page->skyline[index].x;
+    if (x + width > pageSize) {
+        return -1;
+    }
+
+    int y = 0;
+    int remaining = width;
+    for (int i = index; remaining > 0; i++) {
+        if (page->skyline[i].y > y) {
+            y = page->skyline[i].y;
+        }
+        remaining -= page->skyline[i].width;
+    }
+
+    return (y + height <= pageSize) ? y : -1;
+}
+
+// Bottom-left skyline: the lowest spot wins, ties go to the one wasting less width
+static Bool SkylinePack(GlyphAtlasPage* page, int pageSize, int width, int height, int* outX, int* outY) {
+    int bestIndex = -1;
+    int bestY = pageSize;
+    int bestWidth = pageSize + 1;
+
+    for (int i = 0; i < page->skylineCount; i++) {
+        int y = SkylineFitAt(page, pageSize, i, width, height);
+        if (y < 0) continue;
+        if (y < bestY || (y == bestY && page->skyline[i].width < bestWidth)) {
+            bestIndex = i;
+            bestY = y;
+            bestWidth = page->skyline[i].width;
+        }
+    }
+
+    if (bestIndex < 0) {
+        return FALSE;
+    }
+
+    int x = page->skyline[bestIndex].x;
+    SkylineNode placed = {x, bestY + height, width};
+
+    // drop or shrink the nodes the new one covers
+    int end = bestIndex;
+    while (end < page->skylineCount && page->skyline[end].x + page->skyline[end].width <= x + width) {
+        end++;
+    }
+    if (end < page->skylineCount && page->skyline[end].x < x + width) {
+        int cut = x + width - page->skyline[end].x;
+        page->skyline[end].x += cut;
+        page->skyline[end].width -= cut;
+    }
+
+    int removed = end - bestIndex;
+    memmove(&page->skyline[bestIndex + 1], &page->skyline[end], (page->skylineCount - end) * sizeof(SkylineNode));
+    page->skyline[bestIndex] = placed;
+    page->skylineCount += 1 - removed;
+
+    // merge neighbours at the same height so the node count stays small
+    for (int i = 0; i + 1 < page->skylineCount;) {
+        if (page->skyline[i].y == page->skyline[i + 1].y) {
+            page->skyline[i].width += page->skyline[i + 1].width;
+            memmove(&page->skyline[i + 1], &page->skyline[i + 2], (page->skylineCount - i - 2) * sizeof(SkylineNode));
+            page->skylineCount--;
+        } else {
+            i++;
+        }
+    }
+
+    *outX = x;
+    *outY = bestY;
+    return TRUE;
+}
+
+Bool AddGlyphToAtlas(GlyphAtlas* atlas, const unsigned char* coverage, int width, int height, int stride,
+                     uint32_t* outSlot, Rectangle* outRec) {
+    int paddedWidth = width + 2 * GLYPH_ATLAS_PADDING;
+    int paddedHeight = height + 2 * GLYPH_ATLAS_PADDING;
+    if (paddedWidth > atlas->pageSize || paddedHeight > atlas->pageSize) {
+        return FALSE;
+    }
+
+    GlyphAtlasPage* page = NULL;
+    int x = 0, y = 0;
+    for (int i = 0; i < atlas->pageCount; i++) {
+        if (SkylinePack(&atlas->pages[i], atlas->pageSize, paddedWidth, paddedHeight, &x, &y)) {
+            page = &atlas->pages[i];
+            break;
+        }
+    }
+    if (!page) {
+        page = OpenPage(atlas);
+        if (!page) {
+            page = RecyclePage(atlas);
+        }
+        if (!page) {
+            return FALSE;
+        }
+        SkylinePack(page, atlas->pageSize, paddedWidth, paddedHeight, &x, &y);
+    }
+
+    x += GLYPH_ATLAS_PADDING;
+    y += GLYPH_ATLAS_PADDING;
+    for (int row = 0; row < height; row++) {
+        memcpy(page->pixels + (size_t) (y + row) * atlas->pageSize + x, coverage + (size_t) row * stride, width);
+    }
+    MarkPageDirty(page, x, y, width, height);
+    page->lastUsedFrame = atlas->frame;
+
+    int pageIndex = (int) (page - atlas->pages);
+    *outSlot = ((uint32_t) pageIndex << GLYPH_SLOT_PAGE_SHIFT) | (page->generation & GLYPH_SLOT_GENERATION_MASK);
+    *outRec = (Rectangle){(float) x, (float) y, (float) width, (float) height};
+    return TRUE;
+}
+
+#define DISTANCE_FAR 1e20f
+
+// Felzenszwalb's squared distance transform along one row or column; v and z are scratch of n and n + 1
+static void DistanceTransform1D(const float* f, float* d, int n, int* v, float* z) {
+    int k = 0;
+    v[0] = 0;
+    z[0] = -DISTANCE_FAR;
+    z[1] = DISTANCE_FAR;
+
+    for (int q = 1; q < n; q++) {
+        float s = ((f[q] + (float) q * q) - (f[v[k]] + (float) v[k] * v[k])) / (float) (2 * q - 2 * v[k]);
+        while (s <= z[k]) {
+            k--;
+            s = ((f[q] + (float) q * q) - (f[v[k]] + (float) v[k] * v[k])) / (float) (2 * q - 2 * v[k]);
+        }
+        k++;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = DISTANCE_FAR;
+    }
+
+    k = 0;
+    for (int q = 0; q < n; q++) {
+        while (z[k + 1] < q) k++;
+        d[q] = (float) (q - v[k]) * (q - v[k]) + f[v[k]];
+    }
+}
+
+// Squared distance from every texel to the nearest texel where grid is 0
+static void DistanceTransform2D(float* grid, int width, int height) {
+    int n = width > height ? width : height;
+    float* f = (float*) malloc(n * sizeof(float));
+    float* d = (float*) malloc(n * sizeof(float));
+    int* v = (int*) malloc(n * sizeof(int));
+    float* z = (float*) malloc((n + 1) * sizeof(float));
+
+    for (int x = 0; x < width; x++) {
+        for (int y = 0; y < height; y++) f[y] = grid[y * width + x];
+        DistanceTransform1D(f, d, height, v, z);
+        for (int y = 0; y < height; y++) grid[y * width + x] = d[y];
+    }
+    for (int y = 0; y < height; y++) {
+        DistanceTransform1D(&grid[y * width], d, width, v, z);
+        memcpy(&grid[y * width], d, width * sizeof(float));
+    }
+
+    free(z);
+    free(v);
+    free(d);
+    free(f);
+}
+
+void BuildGlyphDistanceField(const unsigned char* coverage, int width, int height, int stride, int spread, unsigned char* out) {
+    int fieldWidth = width + 2 * spread;
+    int fieldHeight = height + 2 * spread;
+    size_t texels = (size_t) fieldWidth * fieldHeight;
+
+    // distance to the nearest inside texel, and to the nearest outside one
+    float* toInside = (float*) malloc(texels * sizeof(float));
+    float* toOutside = (float*) malloc(texels * sizeof(float));
+    for (int y = 0; y < fieldHeight; y++) {
+        for (int x = 0; x < fieldWidth; x++) {
+            int gx = x - spread;
+            int gy = y - spread;
+            Bool inBitmap = gx >= 0 && gy >= 0 && gx < width && gy < height;
+            Bool inside = inBitmap && coverage[gy * stride + gx] >= 128;
+            toInside[y * fieldWidth + x] = inside ? 0.0f : DISTANCE_FAR;
+            toOutside[y * fieldWidth + x] = inside ? DISTANCE_FAR : 0.0f;
+        }
+    }
+    DistanceTransform2D(toInside, fieldWidth, fieldHeight);
+    DistanceTransform2D(toOutside, fieldWidth, fieldHeight);
+
+    for (int y = 0; y < fieldHeight; y++) {
+        for (int x = 0; x < fieldWidth; x++) {
+            int gx = x - spread;
+            int gy = y - spread;
+            int value = (gx >= 0 && gy >= 0 && gx < width && gy < height) ? coverage[gy * stride + gx] : 0;
+
+            // positive outside; the outline runs between texel centers, antialiased texels know better where
+            float distance;
+            if (value > 0 && value < 255) {
+                distance = 0.5f - value / 255.0f;
+            } else if (value >= 128) {
+                distance = 0.5f - sqrtf(toOutside[y * fieldWidth + x]);
+            } else {
+                distance = sqrtf(toInside[y * fieldWidth + x]) - 0.5f;
+            }
+
+            float encoded = 0.5f - distance / (2.0f * spread);
+            if (encoded < 0.0f) encoded = 0.0f;
+            if (encoded > 1.0f) encoded = 1.0f;
+            out[y * fieldWidth + x] = (unsigned char) (encoded * 255.0f + 0.5f);
+        }
+    }
+
+    free(toOutside);
+    free(toInside);
+}
+
+void UploadGlyphAtlas(GlyphAtlas* atlas) {
+    unsigned char* staging = NULL;
+
+    for (int i = 0; i < atlas->pageCount; i++) {
+        GlyphAtlasPage* page = &atlas->pages[i];
+
+        if (page->texture.id == 0) {
+            Image img = {
+                    .data = page->pixels,
+                    .width = atlas->pageSize,
+                    .height = atlas->pageSize,
+                    .mipmaps = 1,
+                    .format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE,
+            };
+            page->texture = LoadTextureFromImage(img);
+            SetTextureFilter(page->texture, TEXTURE_FILTER_BILINEAR);
+        } else if (page->dirtyMinX <= page->dirtyMaxX) {
+            int width = page->dirtyMaxX - page->dirtyMinX + 1;
+            int height = page->dirtyMaxY - page->dirtyMinY + 1;
+            const unsigned char* src = page->pixels + (size_t) page->dirtyMinY * atlas->pageSize + page->dirtyMinX;
+
+            // glyphs trickle in a few at a time, so only the changed rectangle goes up, repacked to be contiguous
+            if (width != atlas->pageSize) {
+                if (!staging) {
+                    staging = (unsigned char*) malloc((size_t) atlas->pageSize * atlas->pageSize);
+                }
+                for (int row = 0; row < height; row++) {
+                    memcpy(staging + (size_t) row * width, src + (size_t) row * atlas->pageSize, width);
+                }
+                src = staging;
+            }
+
+            Rectangle rect = {(float) page->dirtyMinX, (float) page->dirtyMinY, (float) width, (float) height};
+            UpdateTextureRec(page->texture, rect, src);
+        }
+
+        page->dirtyMinX = page->dirtyMinY = atlas->pageSize;
+        page->dirtyMaxX = page->dirtyMaxY = -1;
+    }
+
+    free(staging);
+}
+
+size_t GetGlyphAtlasBytes(const GlyphAtlas* atlas) {
+    return (size_t) atlas->pageCount * atlas->pageSize * atlas->pageSize;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <raylib.h>
+#include <stdint.h>
+
+#include "util.h"
+
+// Glyphs from every face share these single-channel pages, holding coverage or a distance field depending on the face
+#define GLYPH_ATLAS_PAGE_SIZE 2048
+#define GLYPH_ATLAS_MAX_PAGES 8
+// pages kept before the least recently drawn one is cleared for reuse (4 MB each at the default size)
+#define GLYPH_ATLAS_DEFAULT_PAGE_BUDGET 4
+// empty texels kept around each glyph so bilinear sampling never picks up a neighbour
+#define GLYPH_ATLAS_PADDING 2
+// distance field glyphs carry this many texels of falloff on each side of the outline
+#define GLYPH_SDF_SPREAD 6
+
+typedef struct {
+    int x;
+    int y; // top of the free space from x to the next node
+    int width;
+} SkylineNode;
+
+typedef struct {
+    unsigned char* pixels; // CPU copy of the coverage, newly packed glyphs are uploaded from it
+    Texture2D texture;
+
+    SkylineNode* skyline;
+    int skylineCount;
+
+    // area changed since the last upload, empty when dirtyMinX > dirtyMaxX
+    int dirtyMinX, dirtyMinY;
+    int dirtyMaxX, dirtyMaxY;
+
+    uint32_t generation;    // bumped whenever the page is cleared, invalidating every slot on it
+    uint32_t lastUsedFrame;
+} GlyphAtlasPage;
+
+typedef struct {
+    GlyphAtlasPage pages[GLYPH_ATLAS_MAX_PAGES];
+    int pageCount;
+    int pageSize;
+    int pageBudget;
+    uint32_t frame;
+
+    Shader coverageShader;
+    Shader distanceFieldShader;
+} GlyphAtlas;
+
+// Where a glyph was packed: page in the top 8 bits, that page's generation at the time below
+#define GLYPH_SLOT_PAGE_SHIFT 24
+#define GLYPH_SLOT_GENERATION_MASK 0xFFFFFFu
+#define GLYPH_SLOT_NONE 0xFFFFFFFFu
+
+static inline int GetGlyphSlotPage(uint32_t slot) {
+    return (int) (slot >> GLYPH_SLOT_PAGE_SHIFT);
+}
+
+static inline Bool IsGlyphSlotResident(const GlyphAtlas* atlas, uint32_t slot) {
+    int page = GetGlyphSlotPage(slot);
+    return page < atlas->pageCount && (atlas->pages[page].generation & GLYPH_SLOT_GENERATION_MASK) == (slot & GLYPH_SLOT_GENERATION_MASK);
+}
+
+// Keeps the slot's page from being reused until the next frame
+static inline void TouchGlyphSlot(GlyphAtlas* atlas, uint32_t slot) {
+    atlas->pages[GetGlyphSlotPage(slot)].lastUsedFrame = atlas->frame;
+}
+
+// Loads the shaders, so it needs the GL context; pages are created as glyphs arrive
+void InitGlyphAtlas(GlyphAtlas* atlas, int pageSize, int pageBudget);
+void FreeGlyphAtlas(GlyphAtlas* atlas);
+
+// Starts a new frame for page LRU purposes; pages touched in the current frame are never reused
+void BeginGlyphAtlasFrame(GlyphAtlas* atlas);
+
+// Packs a width x height coverage bitmap (stride bytes per row) into the first page with room. Without room it opens
+// a page while under budget, otherwise clears the least recently drawn page. outRec excludes the padding.
+// Returns FALSE when every page was drawn from this frame and none has room.
+Bool AddGlyphToAtlas(GlyphAtlas* atlas, const unsigned char* coverage, int width, int height, int stride,
+                     uint32_t* outSlot, Rectangle* outRec);
+
+// Turns a width x height coverage bitmap into a signed distance field of (width + 2 * spread) x (height + 2 * spread)
+// texels: 128 on the outline, rising inside, falling to 0 spread texels outside
+void BuildGlyphDistanceField(const unsigned char* coverage, int width, int height, int stride, int spread, unsigned char* out);
+
+// Pushes whatever was packed since the last call to the GPU
+void UploadGlyphAtlas(GlyphAtlas* atlas);
+
+// Bytes of texture memory held by the pages
+size_t GetGlyphAtlasBytes(const GlyphAtlas* atlas);
@@ -0,0 +1,84 @@
+#include "live_reload.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+Bool StartLiveReload(LiveReloadWatcher* watcher, const char* directory) {
+    memset(watcher, 0, sizeof(*watcher));
+    watcher->fd = -1;
+    watcher->watch = -1;
+
+#ifdef __linux__
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd < 0) {
+        printf("Live reload: inotify unavailable (%s)\n", strerror(errno));
+        return FALSE;
+    }
+
+    watcher->watch = inotify_add_watch(watcher->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watcher->watch < 0) {
+        printf("Live reload: can't watch %s (%s)\n", directory, strerror(errno));
+        close(watcher->fd);
+        watcher->fd = -1;
+        return FALSE;
+    }
+
+    printf("Live reload: watching %s\n", directory);
+    return TRUE;
+#else
+    printf("Live reload: not supported on this platform\n");
+    return FALSE;
+#endif
+}
+
+void StopLiveReload(LiveReloadWatcher* watcher) {
+#ifdef __linux__
+    if (watcher->fd >= 0) {
+        close(watcher->fd);
+    }
+#endif
+    watcher->fd = -1;
+    watcher->watch = -1;
+}
+
+static void AddChange(LiveReloadWatcher* watcher, const char* name) {
+    for (int i = 0; i < watcher->changeCount; i++) {
+        if (strcmp(watcher->changes[i], name) == 0) return;
+    }
+    if (watcher->changeCount == LIVE_RELOAD_MAX_CHANGES) {
+        printf("Live reload: too many changes at once, dropping %s\n", name);
+        return;
+    }
+    snprintf(watcher->changes[watcher->changeCount++], LIVE_RELOAD_MAX_NAME, "%s", name);
+}
+
+int PollLiveReload(LiveReloadWatcher* watcher) {
+    watcher->changeCount = 0;
+
+#ifdef __linux__
+    if (watcher->fd < 0) return 0;
+
+    // aligned like the kernel's records, several events arrive per read
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;) {
+        ssize_t length = read(watcher->fd, buffer, sizeof(buffer));
+        if (length <= 0) break;
+
+        for (char* cursor = buffer; cursor < buffer + length;) {
+            struct inotify_event* event = (struct inotify_event*) cursor;
+            if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+                AddChange(watcher, event->name);
+            }
+            cursor += sizeof(struct inotify_event) + event->len;
+        }
+    }
+#endif
+
+    return watcher->changeCount;
+}
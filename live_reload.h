@@ -0,0 +1,24 @@
+#pragma once
+
+#include "util.h"
+
+// Changed files reported by one poll, later changes to the same file are folded in
+#define LIVE_RELOAD_MAX_CHANGES 16
+#define LIVE_RELOAD_MAX_NAME 256
+
+// Watches a directory for files written or moved into it (editors often save by renaming over the original).
+// inotify on Linux; elsewhere starting it fails and authoring falls back to reopening posts by hand.
+typedef struct {
+    int fd;
+    int watch;
+
+    char changes[LIVE_RELOAD_MAX_CHANGES][LIVE_RELOAD_MAX_NAME];
+    int changeCount;
+} LiveReloadWatcher;
+
+Bool StartLiveReload(LiveReloadWatcher* watcher, const char* directory);
+void StopLiveReload(LiveReloadWatcher* watcher);
+
+// Non-blocking; returns how many files changed since the last poll, their names (relative to the directory) are in
+// watcher->changes until the next call
+int PollLiveReload(LiveReloadWatcher* watcher);
@@ -2,33 +2,29 @@
 #ifdef EMSCRIPTEN
 #include <emscripten.h>
 #include <emscripten/em_js.h>
+#else
+#define EMSCRIPTEN_KEEPALIVE
 #endif
 
 #include <clay.h>
 
-#include <cmark.h>
-
+#include "archive_list.h"
+#include "binary_document.h"
+#include "document_cache.h"
+#include "document_loader.h"
+#include "font_bundle.h"
 #include "font_loader.h"
+#include "frame_profiler.h"
+#include "live_reload.h"
+#include "markdown.h"
+#include "markdown_stream.h"
+#include "preprocess.h"
 #include "renderer.c"
+#include "search_index.h"
 #include "util.h"
 
 #define SCROLL_SPEED 5.0f
 
-typedef struct {
-    int h1;
-    int h2;
-    int h3;
-    int body;
-    int small;
-} FontSizes;
-
-const FontSizes fontSizes = {
-        .h1 = 48.0f,
-        .h2 = 36.0f,
-        .h3 = 28.0f,
-        .body = 18.0f,
-        .small = 14.0f,
-};
 #define MARKDOWN_BASE_PATH "markdown/"
 
 #define FONT_NAME_NORMAL "-apple-system, BlinkMacSystemFont, 'Segoe UI', Roboto, 'Noto Sans SC', sans-serif"
@@ -40,564 +36,869 @@ const FontSizes fontSizes = {
 #define FONT_STYLE_NORMAL "normal"
 #define FONT_STYLE_ITALIC "italic"
 
-Font embeddedFonts[16];
-#define ZHCN_FONT_NORMAL 0
-#define ZHCN_FONT_BIG 1
-
-#define ZHCN_FONT_NORMAL_BOLD 2
-#define ZHCN_FONT_NORMAL_ITALIC 3
-#define ZHCN_FONT_NORMAL_BOLD_ITALIC 4
-
-#define ZHCN_FONT_BIG_BOLD 5
-#define ZHCN_FONT_BIG_ITALIC 6
-#define ZHCN_FONT_BIG_BOLD_ITALIC 7
-
-#define CODE_FONT_MONOSPACE 8
+FontAtlas embeddedFonts[16];
+GlyphAtlas glyphAtlas;
 
 double GetDevicePixelRatio() {
 #ifdef EMSCRIPTEN
     return emscripten_get_device_pixel_ratio();
 #else
-    return GetDevicePixelRatio();
+    return GetWindowScaleDPI().x;
 #endif
 }
 
-typedef struct {
-    Bool bold;
-    Bool italic;
-    Bool underline;
-    Bool strikethrough;
-
-    Bool monospace;
-} TextState;
-
 typedef enum {
-    CMD_BLOCK_OPEN,
-    CMD_TEXT,
-    CMD_BLOCK_CLOSE,
-} CommandType;
+    FRAME_DIRTY_NONE = 0,
+    FRAME_DIRTY_POINTER = 1 << 0,
+    FRAME_DIRTY_SCROLL = 1 << 1,
+    FRAME_DIRTY_RESIZE = 1 << 2,
+    FRAME_DIRTY_DOCUMENT = 1 << 3,
+    FRAME_DIRTY_ARCHIVES = 1 << 4,
+    FRAME_DIRTY_SEARCH = 1 << 5,
+    FRAME_DIRTY_PROFILER = 1 << 6,
+    FRAME_DIRTY_ALL = 0xFF,
+} FrameDirtyFlags;
+
+#define IDLE_SETTLE_FRAMES 1
+#define IDLE_THROTTLE_DELAY 2.0   // seconds without changes before the main loop slows down
+#define IDLE_FRAME_INTERVAL_MS 100 // main loop period while throttled
+
+unsigned int frameDirtyFlags = FRAME_DIRTY_ALL;
+int settleFramesLeft = 0;
+double lastActiveTime = 0.0;
+Bool mainLoopThrottled = FALSE;
+Bool frameDrawn = FALSE; // set by MainLoop when it got past the idle check
+
+Vector2 lastMousePosition;
+Bool lastMouseDown = FALSE;
+int lastScreenWidth = 0;
+int lastScreenHeight = 0;
+
+void SetMainLoopThrottled(Bool throttled) {
+    if (mainLoopThrottled == throttled) {
+        return;
+    }
+    mainLoopThrottled = throttled;
 
-typedef enum {
-    BT_NONE,
-    BT_HEADING,
-    BT_QUOTE,
-    BT_CODE,
-    BT_PARAGRAPH,
+#ifdef EMSCRIPTEN
+    if (throttled) {
+        emscripten_set_main_loop_timing(EM_TIMING_SETTIMEOUT, IDLE_FRAME_INTERVAL_MS);
+    } else {
+        emscripten_set_main_loop_timing(EM_TIMING_RAF, 1);
+    }
+#endif
+}
 
-    BT_LIST_CONTAINER,
-    BT_LIST_ITEM,
+// Called for changes that don't come from raylib input (fetch callbacks, archive list, ...)
+void MarkFrameDirty(unsigned int flags) {
+    frameDirtyFlags |= flags;
+    SetMainLoopThrottled(FALSE);
+}
 
-    BT_HR,
-} BlockType;
+unsigned int CollectInputDirtyFlags() {
+    unsigned int flags = FRAME_DIRTY_NONE;
 
-typedef struct {
-    CommandType type;
-    BlockType blockType;
-    Clay_String content;
-    Clay_TextElementConfig textConfig;
-    TextState textState;
-} RenderCommand;
+    Vector2 mousePos = GetMousePosition();
+    Bool mouseDown = IsMouseButtonDown(MOUSE_LEFT_BUTTON);
+    if (mousePos.x != lastMousePosition.x || mousePos.y != lastMousePosition.y || mouseDown != lastMouseDown) {
+        flags |= FRAME_DIRTY_POINTER;
+    }
+    lastMousePosition = mousePos;
+    lastMouseDown = mouseDown;
 
-typedef struct {
-    Clay_TextElementConfig config;
-    TextState state;
-} StyleFrame;
+    // clay only scrolls from wheel deltas here (drag scrolling is off), so there is no momentum to wait for
+    Vector2 wheelMove = GetMouseWheelMoveV();
+    if (wheelMove.x != 0.0f || wheelMove.y != 0.0f) {
+        flags |= FRAME_DIRTY_SCROLL;
+    }
 
+    int screenWidth = GetScreenWidth();
+    int screenHeight = GetScreenHeight();
+    if (screenWidth != lastScreenWidth || screenHeight != lastScreenHeight) {
+        flags |= FRAME_DIRTY_RESIZE;
+    }
+    lastScreenWidth = screenWidth;
+    lastScreenHeight = screenHeight;
 
-#define TEXT_ARENA_SIZE 1024 * 1024
-char textArenaMemory[TEXT_ARENA_SIZE];
-int textArenaOffset = 0;
+    return flags;
+}
 
-RenderCommand* globalRenderCommandCache;
-int globalRenderCommandCount;
-int needsParse = 1;
-char* needsParseFileContent;
+// Hovering an archive entry this long starts a prefetch, so sweeping over the list doesn't fetch everything
+#define PREFETCH_HOVER_DELAY 0.15
+// Idle this long and the entries next to the active one get prefetched
+#define PREFETCH_IDLE_DELAY 1.0
+// A prefetched document larger than this share of the cache budget is dropped rather than evicting others for it
+#define PREFETCH_MAX_BUDGET_SHARE 4
 
-#define MAX_ARCHIVES 128
+DocumentCache documentCache;
+DocumentLoader documentLoader;
+MarkdownDocument* currentDocument;
+int needsParse = 1;
+char* pendingDocumentPath;
 
-typedef struct {
-    Clay_String name;
-    Clay_String path;
-    bool active;
-} ArchiveEntry;
+void RequireMarkdownReparse(const char* fileName);
 
-ArchiveEntry archives[MAX_ARCHIVES];
-int archiveCount = 0;
+#ifdef BUROGU_LIVE_RELOAD
+// Native authoring: posts are read as markdown (never the compiled copies) and reparsed as they're saved
+LiveReloadWatcher liveReload;
+#endif
+Bool liveReloadActive = FALSE;
 
-Clay_String AllocateStringInArena(const char* str) {
-    if (!str) {
-        return (Clay_String){0};
-    }
+// large posts are parsed in top-level chunks on this many threads
+int parseThreadCount = 1;
 
-    if (textArenaOffset + strlen(str) + 1 > TEXT_ARENA_SIZE) {
-        printf("Text arena out of memory!\n");
-        return (Clay_String){0};
-    }
+// The markdown a compiled document was made from
+void GetMarkdownSourcePath(const char* binaryPath, char* out, size_t size) {
+    snprintf(out, size, "%.*s.md", (int) (strlen(binaryPath) - strlen(BINARY_DOCUMENT_EXTENSION)), binaryPath);
+}
 
-    char* dest = &textArenaMemory[textArenaOffset];
-    strcpy(dest, str);
-    textArenaOffset += strlen(str) + 1;
+int hoveredArchiveIndex = -1;
+int prefetchHoverIndex = -1;
+double prefetchHoverStart = 0.0;
+// one attempt per hover and per opened post, so failed or oversized prefetches aren't retried in a loop
+Bool prefetchHoverIssued = FALSE;
+Bool prefetchIdleIssued = FALSE;
 
-    return (Clay_String){.chars = dest, .length = (int) strlen(str)};
-}
+ArchiveList archiveList;
 
-void ResetTextArena() {
-    textArenaOffset = 0;
-}
+// Sidebar rows have a fixed height, so the visible ones follow from the scroll offset without laying out the rest
+#define ARCHIVE_ROW_HEIGHT 36
+#define ARCHIVE_ROW_GAP 8
+#define ARCHIVE_ROW_STRIDE (ARCHIVE_ROW_HEIGHT + ARCHIVE_ROW_GAP)
+// rows laid out beyond the visible ones, so a fast wheel flick doesn't show the spacer
+#define ARCHIVE_ROW_OVERSCAN 4
 
+#ifdef EMSCRIPTEN
 /* clang-format off */
-void RequestMarkdownLoadJS(const char* fileName) {
+void StartFetchJS(DocumentLoader* loader, int requestId, const char* fileName) {
     EM_ASM({
-        try {
-            const filename = UTF8ToString($0);
-            fetch(`markdown/${filename}`)
-                .then(response => {
-                    if (!response.ok) {
-                        throw new Error(`HTTP error! status: ${response.status}`);
-                    }
-                    return response.text();
-                })
-                .then(text => {
-                    const processed = Module.Burogu_Preprocess(text);
-                    const ptr = lengthBytesUTF8(processed) + 1;
-                    const stringOnWasmHeap = _malloc(ptr);
-                    stringToUTF8(processed, stringOnWasmHeap, ptr);
-
-                    console.log(`Loaded markdown file: ${filename}, size: ${text.length} bytes`);
-                    Module._OnFileLoaded(filename, stringOnWasmHeap);
-
-                    _free(stringOnWasmHeap);
-                })
-                .catch(e => {
-                    console.error("Failed to load markdown:", e);
+        const requestId = $0;
+        const filename = UTF8ToString($1);
+        const controller = new AbortController();
+        Module.Burogu_Fetches = Module.Burogu_Fetches || {};
+        Module.Burogu_Fetches[requestId] = controller;
+
+        // raw utf-8 goes onto the heap piece by piece as it arrives, decoding and parsing happen in C.
+        // OnFileChunk only borrows the copy
+        let size = 0;
+        const feed = bytes => {
+            const bytesOnWasmHeap = _malloc(bytes.length || 1);
+            HEAPU8.set(bytes, bytesOnWasmHeap);
+            Module._OnFileChunk(requestId, bytesOnWasmHeap, bytes.length);
+            _free(bytesOnWasmHeap);
+            size += bytes.length;
+        };
+
+        fetch(`markdown/${filename}`, { signal: controller.signal })
+            .then(response => {
+                if (!response.ok) {
+                    throw new Error(`HTTP error! status: ${response.status}`);
+                }
+                if (!response.body) {
+                    return response.arrayBuffer().then(buffer => feed(new Uint8Array(buffer)));
+                }
+                const reader = response.body.getReader();
+                const pump = () => reader.read().then(({ done, value }) => {
+                    if (done) return;
+                    feed(value);
+                    return pump();
                 });
-        } catch (e) {
-            console.error("Failed to load markdown:", e);
-        }
-    }, fileName);
+                return pump();
+            })
+            .then(() => {
+                console.log(`Loaded markdown file: ${filename}, size: ${size} bytes`);
+                Module._OnFileStreamEnd(requestId, 1);
+            })
+            .catch(e => {
+                if (e.name === 'AbortError') return;
+                console.error("Failed to load markdown:", e);
+                Module._OnFileStreamEnd(requestId, 0);
+            })
+            .finally(() => {
+                delete Module.Burogu_Fetches[requestId];
+            });
+    }, requestId, fileName);
+}
+
+void CancelFetchJS(DocumentLoader* loader, int requestId) {
+    EM_ASM({
+        const controller = Module.Burogu_Fetches && Module.Burogu_Fetches[$0];
+        if (controller) controller.abort();
+    }, requestId);
 }
 
 void RequestArchiveLoadJS() {
     EM_ASM({
-        fetch('markdown/archives.txt')
-            .then(response => response.text())
-            .then(text => {
-                const lines = text.split('\n');
-                lines.forEach(line => {
-                    const trimmed = line.trim();
-                    if (!trimmed || trimmed.startsWith('#')) return;
-
-                    const parts = trimmed.split(',');
-                    if (parts.length >= 2) {
-                        const name = parts[0].trim();
-                        const path = parts[1].trim();
-
-                        const namePtr = Module.Burogu_SafeAllocateUTF8(name);
-                        const pathPtr = Module.Burogu_SafeAllocateUTF8(path);
-                        Module._AddArchiveEntry(namePtr, pathPtr);
-                        _free(namePtr);
-                        _free(pathPtr);
-                    }
-                });
+        fetch('markdown/archives.bin')
+            .then(response => {
+                if (!response.ok) throw new Error(`HTTP error! status: ${response.status}`);
+                return response.arrayBuffer();
+            })
+            .then(buffer => {
+                // the whole manifest in one copy, OnArchiveManifestLoaded takes ownership of it
+                const bytes = new Uint8Array(buffer);
+                const ptr = _malloc(bytes.length);
+                HEAPU8.set(bytes, ptr);
+                Module._OnArchiveManifestLoaded(ptr, bytes.length);
             })
             .catch(err => console.error("Burogu Index Load Error:", err));
     });
 }
+
+void RequestSearchIndexLoadJS() {
+    EM_ASM({
+        fetch('markdown/search.index')
+            .then(response => {
+                if (!response.ok) throw new Error(`HTTP error! status: ${response.status}`);
+                return response.arrayBuffer();
+            })
+            .then(buffer => {
+                // OnSearchIndexLoaded takes ownership of the heap copy
+                const bytes = new Uint8Array(buffer);
+                const ptr = _malloc(bytes.length);
+                HEAPU8.set(bytes, ptr);
+                Module._OnSearchIndexLoaded(ptr, bytes.length);
+            })
+            .catch(err => console.error("Burogu Search Index Load Error:", err));
+    });
+}
 /* clang-format on */
+#endif
 
-EMSCRIPTEN_KEEPALIVE
-void OnFileLoaded(const char* fileName, const char* content) {
-    printf("File loaded: %s\n", fileName);
-    if (content) {
-        printf("Content length: %zu\n", strlen(content));
-        needsParseFileContent = strdup(content);
-    } else {
-        printf("Failed to load file: %s\n", fileName);
-    }
+Bool IsPendingDocument(const char* path) {
+    return pendingDocumentPath && strcmp(path, pendingDocumentPath) == 0;
 }
 
-EMSCRIPTEN_KEEPALIVE
-void AddArchiveEntry(char* name, char* path) {
-    if (archiveCount >= MAX_ARCHIVES) {
-        printf("Error: Maximum number of archives reached!\n");
+// Caches a freshly loaded document and shows it if it's the one being waited for; frees load->path
+void AcceptLoadedDocument(DocumentLoad* load, MarkdownDocument document) {
+    Bool display = IsPendingDocument(load->path);
+    if (!display && GetMarkdownDocumentBytes(&document) > documentCache.budget / PREFETCH_MAX_BUDGET_SHARE) {
+        printf("Prefetched document too large to keep: %s\n", load->path);
+        FreeMarkdownDocument(&document);
+        free(load->path);
         return;
     }
 
-    archives[archiveCount].name = (Clay_String){
-            .length = strlen(name),
-            .chars = strdup(name),
-    };
-    archives[archiveCount].path = (Clay_String){
-            .length = strlen(path),
-            .chars = strdup(path),
-    };
-    archives[archiveCount].active = (archiveCount == 0);
-
-    archiveCount++;
+    MarkdownDocument* cached = CacheDocument(&documentCache, load->path, document);
+    if (display && cached) {
+        currentDocument = cached;
+        PinCachedDocument(&documentCache, currentDocument);
+        needsParse = 0;
+        free(pendingDocumentPath);
+        pendingDocumentPath = NULL;
+        MarkFrameDirty(FRAME_DIRTY_DOCUMENT);
+
+        MeasureCacheStats stats = Raylib_GetMeasureCacheStats();
+        printf("Markdown parsed, measure cache: %llu hits, %llu misses, %d/%d entries\n",
+               (unsigned long long) stats.hits, (unsigned long long) stats.misses, stats.entryCount, stats.capacity);
+    }
 
-    printf("Added archive entry: %s -> %s\n", name, path);
+    free(load->path);
 }
 
-#define GLYPH_RANGE_FILE MARKDOWN_BASE_PATH "glyph_range.txt"
+// Takes ownership of content, a malloc'd buffer of length raw bytes (NULL if the load failed)
+void OnFileLoaded(int requestId, char* content, size_t length) {
+    DocumentLoad load;
+    if (!FinishDocumentLoad(&documentLoader, requestId, &load)) {
+        // cancelled while the response was on its way
+        free(content);
+        return;
+    }
 
-char* ReadGlyphRange() {
-    FILE* file = fopen(GLYPH_RANGE_FILE, "rb");
-    if (!file) {
-        printf("Failed to open glyph range file: %s\n", GLYPH_RANGE_FILE);
-        return NULL;
+    Bool display = IsPendingDocument(load.path);
+    printf("File loaded: %s%s\n", load.path, display ? "" : " (prefetch)");
+
+    if (!content) {
+        printf("Failed to load file: %s\n", load.path);
+        if (display && IsBinaryDocumentPath(load.path)) {
+            // not compiled (yet), the markdown next to it will do
+            char markdownPath[512];
+            GetMarkdownSourcePath(load.path, markdownPath, sizeof(markdownPath));
+            RequireMarkdownReparse(markdownPath);
+        }
+        free(load.path);
+        return;
     }
 
-    fseek(file, 0, SEEK_END);
-    long fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    MarkdownDocument document;
+    if (IsBinaryDocumentPath(load.path)) {
+        // compiled ahead of time: validate and fix up in place, no preprocessing and no cmark
+        if (!LoadBinaryDocument(content, length, &document)) {
+            printf("Failed to load binary document: %s\n", load.path);
+            free(content);
+            free(load.path);
+            return;
+        }
+    } else {
+        size_t sourceLength = 0;
+        char* source = PreprocessMarkdown(content, length, &sourceLength);
+        free(content);
+
+        if (liveReloadActive) {
+            // parsed block by block, so a save only reparses the blocks that changed
+            document = ParseMarkdownBlocks(source, sourceLength, NULL, NULL);
+            free(source);
+        } else {
+            // the document slices into the preprocessed text, so it adopts the buffer and takes it into the cache
+            document = AdoptMarkdownDocumentParallel(source, sourceLength, parseThreadCount);
+        }
+    }
 
-    char* buffer = (char*) malloc(fileSize + 1);
-    fread(buffer, 1, fileSize, file);
-    buffer[fileSize] = '\0';
+    AcceptLoadedDocument(&load, document);
+}
 
-    fclose(file);
+// Loads that arrive piece by piece: markdown is parsed as it comes in, compiled documents are collected whole
+typedef struct {
+    int requestId; // 0 for a free slot
+    Bool binary;
+    MarkdownStream stream;
+    char* raw;
+    size_t rawLength;
+    size_t rawCapacity;
+    Bool shown; // some of it is on screen already
+} StreamedLoad;
+
+StreamedLoad streamedLoads[DOCUMENT_LOADER_MAX_LOADS];
+double pendingDocumentRequestTime = 0.0;
+
+StreamedLoad* FindStreamedLoad(int requestId) {
+    for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS; i++) {
+        if (streamedLoads[i].requestId == requestId) {
+            return &streamedLoads[i];
+        }
+    }
+    return NULL;
+}
 
-    return buffer;
+void ReleaseStreamedLoad(StreamedLoad* streamed) {
+    if (currentDocument == &streamed->stream.document) {
+        // the partial document goes away with the stream
+        currentDocument = NULL;
+        needsParse = 1;
+    }
+    if (!streamed->binary) {
+        AbortMarkdownStream(&streamed->stream);
+    }
+    free(streamed->raw);
+    memset(streamed, 0, sizeof(*streamed));
 }
 
-Bool IsBlockPopStyleStackRequired(cmark_node_type type) {
-    return type == CMARK_NODE_HEADING || type == CMARK_NODE_BLOCK_QUOTE ||
-           type == CMARK_NODE_STRONG || type == CMARK_NODE_EMPH ||
-           type == CMARK_NODE_LIST;
+// Streams whose load was cancelled never see an end
+void DropCancelledStreams() {
+    for (int i = 0; i < DOCUMENT_LOADER_MAX_LOADS; i++) {
+        if (streamedLoads[i].requestId != 0 && !PeekDocumentLoad(&documentLoader, streamedLoads[i].requestId)) {
+            ReleaseStreamedLoad(&streamedLoads[i]);
+        }
+    }
 }
 
+EMSCRIPTEN_KEEPALIVE
+// bytes are only borrowed for the call
+void OnFileChunk(int requestId, const char* bytes, size_t length) {
+    const DocumentLoad* load = PeekDocumentLoad(&documentLoader, requestId);
+    if (!load) {
+        // cancelled while the response was on its way
+        return;
+    }
 
-RenderCommand* ParseMarkdownToCommands(const char* markdown, int* outCommandCount) {
-    cmark_node* root = cmark_parse_document(markdown, strlen(markdown), CMARK_OPT_DEFAULT);
-    if (!root) return NULL;
+    StreamedLoad* streamed = FindStreamedLoad(requestId);
+    if (!streamed) {
+        DropCancelledStreams();
+        // one slot per load the loader can hold, so a free one is always left
+        streamed = FindStreamedLoad(0);
+        streamed->requestId = requestId;
+        streamed->binary = IsBinaryDocumentPath(load->path);
+        if (!streamed->binary) {
+            InitMarkdownStream(&streamed->stream, length, parseThreadCount);
+        }
+    }
 
-    RenderCommand* commands;
-    DYNARRAY_INIT(commands, 16);
+    if (streamed->binary) {
+        // validated and fixed up in place once it's all there
+        if (streamed->rawLength + length > streamed->rawCapacity) {
+            streamed->rawCapacity = (streamed->rawLength + length) * 2;
+            streamed->raw = (char*) realloc(streamed->raw, streamed->rawCapacity);
+        }
+        memcpy(streamed->raw + streamed->rawLength, bytes, length);
+        streamed->rawLength += length;
+        return;
+    }
 
-    StyleFrame* styleStack;
-    STACK_INIT(styleStack, 8);
+    if (FeedMarkdownStream(&streamed->stream, bytes, length) > 0 && IsPendingDocument(load->path)) {
+        // the blocks that are complete go on screen right away, the rest follow as they arrive
+        currentDocument = &streamed->stream.document;
+        needsParse = 0;
+        MarkFrameDirty(FRAME_DIRTY_DOCUMENT);
+        if (!streamed->shown) {
+            streamed->shown = TRUE;
+            printf("First content of %s after %.2f ms\n", load->path, (GetTime() - pendingDocumentRequestTime) * 1000.0);
+        }
+    }
+}
 
-    int* orderedListCounterStack;
-    STACK_INIT(orderedListCounterStack, 4);
+EMSCRIPTEN_KEEPALIVE
+void OnFileStreamEnd(int requestId, Bool ok) {
+    StreamedLoad* streamed = FindStreamedLoad(requestId);
+    if (!ok) {
+        if (streamed) ReleaseStreamedLoad(streamed);
+        OnFileLoaded(requestId, NULL, 0);
+        return;
+    }
+    if (!streamed || streamed->binary) {
+        // nothing arrived for an empty file
+        char* content = streamed && streamed->raw ? streamed->raw : (char*) calloc(1, 1);
+        size_t length = streamed ? streamed->rawLength : 0;
+        if (streamed) {
+            streamed->raw = NULL;
+            ReleaseStreamedLoad(streamed);
+        }
+        OnFileLoaded(requestId, content, length);
+        return;
+    }
 
-    Clay_TextElementConfig currentConfig = {
-            .fontId = ZHCN_FONT_NORMAL,
-            .fontSize = fontSizes.body,
-            .textColor = {0, 0, 0, 255},
-            .letterSpacing = 1.0f,
-    };
-    TextState currentState = {
-            .bold = FALSE,
-            .italic = FALSE,
-            .underline = FALSE,
-            .strikethrough = FALSE,
-            .monospace = FALSE,
-    };
+    DocumentLoad load;
+    if (!FinishDocumentLoad(&documentLoader, requestId, &load)) {
+        ReleaseStreamedLoad(streamed);
+        return;
+    }
+    printf("File loaded: %s%s\n", load.path, IsPendingDocument(load.path) ? "" : " (prefetch)");
 
-    cmark_iter* iter = cmark_iter_new(root);
-    cmark_event_type ev;
+    // the stream hands its document over, which moves it into the cache
+    if (currentDocument == &streamed->stream.document) {
+        currentDocument = NULL;
+    }
+    MarkdownDocument document = FinishMarkdownStream(&streamed->stream);
+    memset(streamed, 0, sizeof(*streamed));
+    AcceptLoadedDocument(&load, document);
+}
 
-    while ((ev = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
-        cmark_node* node = cmark_iter_get_node(iter);
-        cmark_node_type type = cmark_node_get_type(node);
+void RunSearchQuery();
 
-        if (ev == CMARK_EVENT_ENTER) {
-            if (IsBlockPopStyleStackRequired(type)) {
-                STACK_PUSH(styleStack, ((StyleFrame){currentConfig, currentState}));
-            }
+void OnArchiveListChanged() {
+    // entries the search index doesn't know about are listed too, so the filtered rows have to be redone
+    RunSearchQuery();
+    MarkFrameDirty(FRAME_DIRTY_ARCHIVES);
+}
 
-            if (type == CMARK_NODE_HEADING) {
-                int level = cmark_node_get_heading_level(node);
-                currentConfig.fontId = ZHCN_FONT_BIG;
-                currentConfig.fontSize = (level == 1)
-                                                 ? fontSizes.h1
-                                         : (level == 2)
-                                                 ? fontSizes.h2
-                                                 : fontSizes.h3;
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_HEADING}));
-            } else if (type == CMARK_NODE_BLOCK_QUOTE) {
-                currentConfig.textColor = (Clay_Color){120, 120, 120, 255};
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_QUOTE}));
-            } else if (type == CMARK_NODE_PARAGRAPH) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_PARAGRAPH}));
-            } else if (type == CMARK_NODE_CODE_BLOCK) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_CODE}));
-                RenderCommand codeTxt = {
-                        .type = CMD_TEXT,
-                        .content = AllocateStringInArena(cmark_node_get_literal(node)),
-                        .textConfig = currentConfig,
-                        .textState = currentState,
-                };
-                codeTxt.textState.monospace = TRUE;
-                codeTxt.textConfig.textColor = (Clay_Color){200, 100, 50, 255};
-
-                DYNARRAY_PUSHBACK(commands, codeTxt);
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_CODE}));
-            } else if (type == CMARK_NODE_STRONG) {
-                currentState.bold = true;
-            } else if (type == CMARK_NODE_EMPH) {
-                currentState.italic = true;
-            } else if (type == CMARK_NODE_TEXT) {
-                RenderCommand tCmd = {
-                        .type = CMD_TEXT,
-                        .content = AllocateStringInArena(cmark_node_get_literal(node)),
-                        .textConfig = currentConfig,
-                        .textState = currentState,
-                };
-                DYNARRAY_PUSHBACK(commands, tCmd);
-            } else if (type == CMARK_NODE_CODE) {
-                RenderCommand inlineCode = {
-                        .type = CMD_TEXT,
-                        .content = AllocateStringInArena(cmark_node_get_literal(node)),
-                        .textConfig = currentConfig,
-                        .textState = currentState,
-                };
-                inlineCode.textState.monospace = TRUE;
-                inlineCode.textConfig.textColor = (Clay_Color){50, 50, 50, 255};
-
-                DYNARRAY_PUSHBACK(commands, inlineCode);
-            } else if (type == CMARK_NODE_SOFTBREAK) {
-                RenderCommand spaceCmd = {
-                        .type = CMD_TEXT,
-                        .content = AllocateStringInArena(" "),
-                        .textConfig = currentConfig,
-                        .textState = currentState,
-                };
-                DYNARRAY_PUSHBACK(commands, spaceCmd);
-            } else if (type == CMARK_NODE_LIST) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_LIST_CONTAINER}));
-                if (cmark_node_get_list_type(node) == CMARK_ORDERED_LIST) {
-                    STACK_PUSH(orderedListCounterStack, 1);
-                }
-            } else if (type == CMARK_NODE_ITEM) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_LIST_ITEM}));
-
-                cmark_node* listNode = cmark_node_parent(node);
-                char prefix[16];
-                if (cmark_node_get_list_type(listNode) == CMARK_BULLET_LIST) {
-                    strcpy(prefix, " -  ");
-                } else {
-                    int* idx = STACK_TOP(orderedListCounterStack);
-                    if (idx) {
-                        snprintf(prefix, sizeof(prefix), " %d. ", *idx);
-                        *idx += 1;
-                    } else {
-                        printf("Error: ordered list item without counter stack!\n");
-                    }
-                }
+EMSCRIPTEN_KEEPALIVE
+// Takes ownership of blob, a malloc'd copy of archives.bin
+void OnArchiveManifestLoaded(char* blob, size_t length) {
+    if (!LoadArchiveManifest(&archiveList, blob, length)) {
+        free(blob);
+        return;
+    }
+    printf("Loaded %d archive entries\n", archiveList.count);
+    OnArchiveListChanged();
+}
 
-                RenderCommand bulletCmd = {
-                        .type = CMD_TEXT,
-                        .content = AllocateStringInArena(prefix),
-                        .textConfig = currentConfig,
-                        .textState = currentState,
-                };
-                bulletCmd.textConfig.textColor = (Clay_Color){50, 50, 50, 255};
-                DYNARRAY_PUSHBACK(commands, bulletCmd);
-            } else if (type == CMARK_NODE_THEMATIC_BREAK) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_HR}));
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_HR}));
-            }
-            // todo: handle more node types
-        } else if (ev == CMARK_EVENT_EXIT) {
-            if (type == CMARK_NODE_HEADING) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_HEADING}));
-            } else if (type == CMARK_NODE_BLOCK_QUOTE) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_QUOTE}));
-            } else if (type == CMARK_NODE_PARAGRAPH) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_PARAGRAPH}));
-            } else if (type == CMARK_NODE_LIST) {
-                if (cmark_node_get_list_type(node) == CMARK_ORDERED_LIST) {
-                    int popped;
-                    STACK_POP(orderedListCounterStack, &popped);
-                }
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_LIST_CONTAINER}));
-            } else if (type == CMARK_NODE_ITEM) {
-                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_LIST_ITEM}));
-            }
+void AddArchiveEntry(const char* name, const char* path) {
+    AddArchive(&archiveList, name, path);
+    OnArchiveListChanged();
+}
 
-            if (IsBlockPopStyleStackRequired(type)) {
-                StyleFrame popped;
-                STACK_POP(styleStack, &popped);
-                currentConfig = popped.config;
-                currentState = popped.state;
-            }
+#ifndef EMSCRIPTEN
+void RequestArchiveLoadFile() {
+    int size = 0;
+    unsigned char* data = FileExists(MARKDOWN_BASE_PATH "archives.bin") ? LoadFileData(MARKDOWN_BASE_PATH "archives.bin", &size) : NULL;
+    if (data) {
+        char* blob = (char*) malloc(size);
+        memcpy(blob, data, size);
+        UnloadFileData(data);
+        OnArchiveManifestLoaded(blob, (size_t) size);
+        return;
+    }
+
+    // no manifest (yet): a hand-written "name, path" per line list will do, '#' starts a comment
+    char* text = LoadFileText(MARKDOWN_BASE_PATH "archives.txt");
+    if (!text) {
+        printf("Burogu Index Load Error: no %sarchives.txt\n", MARKDOWN_BASE_PATH);
+        return;
+    }
+
+    for (char* line = strtok(text, "\n"); line; line = strtok(NULL, "\n")) {
+        char name[256];
+        char path[256];
+        if (line[0] == '#' || sscanf(line, " %255[^,], %255[^\r\n]", name, path) != 2) continue;
+
+        // trailing blanks of the name, sscanf already skipped the leading ones
+        for (size_t n = strlen(name); n > 0 && (name[n - 1] == ' ' || name[n - 1] == '\t'); n--) {
+            name[n - 1] = '\0';
         }
+        AddArchiveEntry(name, path);
     }
+    UnloadFileText(text);
+}
+#endif
 
-    STACK_FREE(styleStack);
-    cmark_iter_free(iter);
-    cmark_node_free(root);
-    *outCommandCount = DYNARRAY_SIZE(commands);
-    return commands;
+void RequestArchiveLoad() {
+#ifdef EMSCRIPTEN
+    RequestArchiveLoadJS();
+#else
+    RequestArchiveLoadFile();
+#endif
 }
 
-int RemapFontId(int normalFontId, Bool bold, Bool italic, Bool mono) {
-    if (mono) {
-        // override all
-        return CODE_FONT_MONOSPACE;
+#define SEARCH_QUERY_CAPACITY 128
+
+SearchIndex searchIndex;
+Bool searchIndexLoaded = FALSE;
+char searchQuery[SEARCH_QUERY_CAPACITY];
+int searchQueryLength = 0;
+Bool searchFocused = FALSE;
+// per search index document, only looked at while searchMatchCount >= 0
+uint8_t* searchMatches = NULL;
+int searchMatchCount = -1;
+// archive entries listed while filtering, rebuilt with every query rather than every frame
+int* searchRows = NULL;
+int searchRowCount = 0;
+int searchRowCapacity = 0;
+
+void RunSearchQuery() {
+    searchQuery[searchQueryLength] = '\0';
+    searchMatchCount = searchIndexLoaded ? QuerySearchIndex(&searchIndex, searchQuery, searchMatches) : -1;
+    if (searchMatchCount < 0) {
+        return;
     }
 
-    if (normalFontId == ZHCN_FONT_NORMAL) {
-        if (bold && italic) {
-            return ZHCN_FONT_NORMAL_BOLD_ITALIC;
-        } else if (bold) {
-            return ZHCN_FONT_NORMAL_BOLD;
-        } else if (italic) {
-            return ZHCN_FONT_NORMAL_ITALIC;
-        } else {
-            return ZHCN_FONT_NORMAL;
-        }
-    } else if (normalFontId == ZHCN_FONT_BIG) {
-        if (bold && italic) {
-            return ZHCN_FONT_BIG_BOLD_ITALIC;
-        } else if (bold) {
-            return ZHCN_FONT_BIG_BOLD;
-        } else if (italic) {
-            return ZHCN_FONT_BIG_ITALIC;
-        } else {
-            return ZHCN_FONT_BIG;
+    if (searchRowCapacity < archiveList.count) {
+        searchRowCapacity = archiveList.count;
+        searchRows = (int*) realloc(searchRows, searchRowCapacity * sizeof(int));
+    }
+    searchRowCount = 0;
+    for (int i = 0; i < archiveList.count; i++) {
+        // entries past the index (added after it was built) stay visible
+        if (i >= searchIndex.documentCount || searchMatches[i]) {
+            searchRows[searchRowCount++] = i;
         }
     }
+}
 
-    return normalFontId;
+EMSCRIPTEN_KEEPALIVE
+// Takes ownership of blob, a malloc'd copy of search.index
+void OnSearchIndexLoaded(unsigned char* blob, size_t length) {
+    if (searchIndexLoaded) {
+        FreeSearchIndex(&searchIndex);
+        searchIndexLoaded = FALSE;
+    }
+    if (!LoadSearchIndex(blob, length, &searchIndex)) {
+        free(blob);
+        return;
+    }
+
+    searchIndexLoaded = TRUE;
+    free(searchMatches);
+    searchMatches = (uint8_t*) malloc(searchIndex.documentCount ? searchIndex.documentCount : 1);
+    printf("Search index loaded: %d posts, %d terms\n", searchIndex.documentCount, searchIndex.termCount);
+
+    // whatever was typed before the index arrived
+    RunSearchQuery();
+    MarkFrameDirty(FRAME_DIRTY_SEARCH);
 }
 
-void MarkdownRenderer(RenderCommand* commands, int commandCount) {
-    CLAY({
-            .id = CLAY_ID("MainContent"),
-            .layout = {
-                    .layoutDirection = CLAY_TOP_TO_BOTTOM,
-                    .sizing = {
-                            CLAY_SIZING_GROW(),
-                            CLAY_SIZING_FIT(),
-                    },
-                    .padding = CLAY_PADDING_ALL(32),
-                    .childGap = 8,
-            },
-            .clip = {
-                    .vertical = TRUE,
-                    .childOffset = Clay_GetScrollOffset(),
-            },
-    }) {
-        for (int i = 0; i < commandCount; i++) {
-            RenderCommand* cmd = &commands[i];
-
-            if (cmd->type == CMD_BLOCK_OPEN) {
-                Clay_ElementDeclaration decl = {
-                        .id = CLAY_IDI("Block", i),
-                        .layout = {
-                                .sizing = {
-                                        CLAY_SIZING_GROW(),
-                                        CLAY_SIZING_FIT(),
-                                },
-                        },
-                };
-
-                if (cmd->blockType == BT_QUOTE) {
-                    decl.layout.layoutDirection = CLAY_TOP_TO_BOTTOM;
-                    decl.layout.padding = (Clay_Padding){32, 10, 10, 10};
-                    decl.backgroundColor = (Clay_Color){240, 240, 240, 100};
-                    decl.border = (Clay_BorderElementConfig){
-                            .width = {
-                                    .left = 4,
-                            },
-                            .color = (Clay_Color){200, 200, 200, 255},
-                    };
-                } else if (cmd->blockType == BT_CODE) {
-                    decl.layout.padding = CLAY_PADDING_ALL(16);
-                    decl.backgroundColor = (Clay_Color){30, 32, 35, 255};
-                    decl.cornerRadius = CLAY_CORNER_RADIUS(8);
-                    decl.border = (Clay_BorderElementConfig){.width = CLAY_BORDER_ALL(1), .color = {60, 60, 60, 255}};
-                } else if (cmd->blockType == BT_PARAGRAPH) {
-                    decl.layout.sizing.width = CLAY_SIZING_GROW();
-                    // todo: fixme: word wrap not working properly, especially when multiple styles in one paragraph
-                    decl.layout.layoutDirection = CLAY_TOP_TO_BOTTOM;
-                    decl.layout.childGap = 0;
-                } else if (cmd->blockType == BT_LIST_CONTAINER) {
-                    decl.layout.padding = (Clay_Padding){24, 0, 0, 0};
-                    decl.layout.layoutDirection = CLAY_TOP_TO_BOTTOM;
-                    decl.layout.childGap = 4;
-                } else if (cmd->blockType == BT_LIST_ITEM) {
-                    decl.layout.layoutDirection = CLAY_LEFT_TO_RIGHT;
-                    decl.layout.sizing.width = CLAY_SIZING_GROW();
-                } else if (cmd->blockType == BT_HR) {
-                    Clay_ElementDeclaration decl = {
-                            .id = CLAY_IDI("HR", i),
-                            .layout = {
-                                    .sizing = {CLAY_SIZING_GROW(), CLAY_SIZING_FIXED(2)},
-                                    .padding = {0, 0, 16, 16},
-                            },
-                            .backgroundColor = {100, 100, 100, 100}};
-                    Clay__OpenElement();
-                    Clay__ConfigureOpenElement(decl);
-                    Clay__CloseElement();
-                }
+void RequestSearchIndexLoad() {
+#ifdef EMSCRIPTEN
+    RequestSearchIndexLoadJS();
+#else
+    int size = 0;
+    unsigned char* data = FileExists(MARKDOWN_BASE_PATH "search.index") ? LoadFileData(MARKDOWN_BASE_PATH "search.index", &size) : NULL;
+    if (!data) {
+        printf("No search index, the archive search is disabled\n");
+        return;
+    }
+    unsigned char* blob = (unsigned char*) malloc(size);
+    memcpy(blob, data, size);
+    UnloadFileData(data);
+    OnSearchIndexLoaded(blob, (size_t) size);
+#endif
+}
 
-                Clay__OpenElement();
-                Clay__ConfigureOpenElement(decl);
-            } else if (cmd->type == CMD_TEXT) {
-                CLAY_TEXT(cmd->content,
-                          CLAY_TEXT_CONFIG({
-                                  .fontId = RemapFontId(
-                                          cmd->textConfig.fontId,
-                                          cmd->textState.bold,
-                                          cmd->textState.italic,
-                                          cmd->textState.monospace),
-                                  .fontSize = cmd->textConfig.fontSize,
-                                  .textColor = cmd->textConfig.textColor,
-                                  .lineHeight = cmd->textConfig.fontSize * 1.5f,
-                                  .wrapMode = CLAY_TEXT_WRAP_WORDS,
-                          }));
-            } else if (cmd->type == CMD_BLOCK_CLOSE) {
-                Clay__CloseElement();
-            }
+int GetSidebarRowCount() {
+    return searchMatchCount >= 0 ? searchRowCount : archiveList.count;
+}
+
+int GetSidebarRowEntry(int row) {
+    return searchMatchCount >= 0 ? searchRows[row] : row;
+}
+
+// Typing goes to the search box while it has focus; the query runs as it changes
+unsigned int UpdateSearchInput() {
+    if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON) && !Clay_PointerOver(CLAY_ID("SearchBox"))) {
+        if (searchFocused) {
+            searchFocused = FALSE;
+            return FRAME_DIRTY_SEARCH;
         }
+        return FRAME_DIRTY_NONE;
+    }
+    if (!searchFocused) {
+        return FRAME_DIRTY_NONE;
+    }
+
+    Bool changed = FALSE;
+    for (int codepoint = GetCharPressed(); codepoint > 0; codepoint = GetCharPressed()) {
+        int size = 0;
+        const char* utf8 = CodepointToUTF8(codepoint, &size);
+        if (searchQueryLength + size >= SEARCH_QUERY_CAPACITY) break;
+        memcpy(searchQuery + searchQueryLength, utf8, size);
+        searchQueryLength += size;
+        changed = TRUE;
+    }
+
+    if ((IsKeyPressed(KEY_BACKSPACE) || IsKeyPressedRepeat(KEY_BACKSPACE)) && searchQueryLength > 0) {
+        // a whole codepoint at a time
+        do {
+            searchQueryLength--;
+        } while (searchQueryLength > 0 && (searchQuery[searchQueryLength] & 0xC0) == 0x80);
+        changed = TRUE;
+    }
+    if (IsKeyPressed(KEY_ESCAPE)) {
+        searchQueryLength = 0;
+        searchFocused = FALSE;
+        changed = TRUE;
+    }
+
+    if (!changed) {
+        return FRAME_DIRTY_NONE;
+    }
+    RunSearchQuery();
+    return FRAME_DIRTY_SEARCH;
+}
+
+void HandleSearchBoxClick(Clay_ElementId elementId, Clay_PointerData pointerInfo, intptr_t userData) {
+    if (pointerInfo.state == CLAY_POINTER_DATA_PRESSED_THIS_FRAME) {
+        searchFocused = TRUE;
     }
 }
 
 void RequireMarkdownReparse(const char* fileName) {
+    char markdownPath[512];
+    if (liveReloadActive && IsBinaryDocumentPath(fileName)) {
+        // compiled copies lag behind the markdown being edited
+        GetMarkdownSourcePath(fileName, markdownPath, sizeof(markdownPath));
+        fileName = markdownPath;
+    }
+
+    MarkFrameDirty(FRAME_DIRTY_DOCUMENT);
+    prefetchIdleIssued = FALSE;
+
+    free(pendingDocumentPath);
+    pendingDocumentPath = NULL;
+
+    MarkdownDocument* cached = FindCachedDocument(&documentCache, fileName);
+    if (cached) {
+        // visited or prefetched before: swap it in right away, no fetch and no parse
+        currentDocument = cached;
+        PinCachedDocument(&documentCache, currentDocument);
+        needsParse = 0;
+        return;
+    }
+
     needsParse = 1;
-    RequestMarkdownLoadJS(fileName);
+    pendingDocumentPath = strdup(fileName);
+    pendingDocumentRequestTime = GetTime();
+    // joins a prefetch of the same file if one is already in flight
+    RequestDocumentLoad(&documentLoader, fileName, LOAD_PURPOSE_DISPLAY);
 }
 
-void ReparseIfRequested() {
-    if (!needsParse) {
+#ifdef BUROGU_LIVE_RELOAD
+// Reparses the post on screen when it's saved; unchanged blocks are moved over from the old version with their text
+// and layout, so the reload is quick and the scroll position holds
+void ReloadDocument(const char* path) {
+    int fileSize = 0;
+    char fullPath[512];
+    snprintf(fullPath, sizeof(fullPath), "%s%s", MARKDOWN_BASE_PATH, path);
+    unsigned char* content = LoadFileData(fullPath, &fileSize);
+    if (!content) {
+        printf("Failed to reload %s\n", fullPath);
         return;
     }
 
-    ResetTextArena();
+    double start = GetTime();
+    size_t sourceLength = 0;
+    char* source = PreprocessMarkdown((const char*) content, (size_t) fileSize, &sourceLength);
+    UnloadFileData(content);
+
+    int reused = 0;
+    MarkdownDocument document = ParseMarkdownBlocks(source, sourceLength, currentDocument, &reused);
+    free(source);
+
+    // replaces (and frees) what's left of the old version
+    PinCachedDocument(&documentCache, NULL);
+    currentDocument = CacheDocument(&documentCache, path, document);
+    PinCachedDocument(&documentCache, currentDocument);
+    MarkFrameDirty(FRAME_DIRTY_DOCUMENT);
 
-    if (needsParseFileContent == NULL) {
+    printf("Reloaded %s in %.2f ms, %d/%d blocks reused\n", path, (GetTime() - start) * 1000.0, reused,
+           document.blockCount);
+}
+
+void PollLiveReloadChanges() {
+    int changes = PollLiveReload(&liveReload);
+    const char* currentPath = currentDocument ? GetCachedDocumentPath(&documentCache, currentDocument) : NULL;
+
+    for (int i = 0; i < changes; i++) {
+        const char* path = liveReload.changes[i];
+        if (currentPath && strcmp(path, currentPath) == 0) {
+            ReloadDocument(path);
+            currentPath = GetCachedDocumentPath(&documentCache, currentDocument);
+        } else {
+            // posts visited before are parsed again when they're opened next
+            DropCachedDocument(&documentCache, path);
+        }
+    }
+}
+#endif
+
+void PrefetchDocument(const char* fileName) {
+    if (IsDocumentCached(&documentCache, fileName) || IsDocumentLoadPending(&documentLoader, fileName)) {
         return;
     }
+    RequestDocumentLoad(&documentLoader, fileName, LOAD_PURPOSE_PREFETCH);
+}
 
-    if (globalRenderCommandCache) {
-        free(globalRenderCommandCache);
+// Runs every main loop iteration, busy or idle; hoveredArchiveIndex is from the last layout
+void UpdatePrefetch(Bool idle) {
+    if (hoveredArchiveIndex != prefetchHoverIndex) {
+        if (prefetchHoverIndex >= 0 && prefetchHoverIndex < archiveList.count) {
+            // the pointer left before the click, the fetch isn't wanted anymore
+            CancelDocumentPrefetch(&documentLoader, GetArchivePath(&archiveList, prefetchHoverIndex));
+        }
+        prefetchHoverIndex = hoveredArchiveIndex;
+        prefetchHoverStart = GetTime();
+        prefetchHoverIssued = FALSE;
     }
 
-    globalRenderCommandCache = ParseMarkdownToCommands(needsParseFileContent, &needsParse);
-    globalRenderCommandCount = needsParse;
+    if (!prefetchHoverIssued && prefetchHoverIndex >= 0 && prefetchHoverIndex < archiveList.count &&
+        GetTime() - prefetchHoverStart >= PREFETCH_HOVER_DELAY) {
+        PrefetchDocument(GetArchivePath(&archiveList, prefetchHoverIndex));
+        prefetchHoverIssued = TRUE;
+    }
 
-    needsParse = 0;
-    free(needsParseFileContent);
-    needsParseFileContent = NULL;
+    if (idle && !prefetchIdleIssued && GetTime() - lastActiveTime >= PREFETCH_IDLE_DELAY) {
+        // the neighbours of the open post are the likeliest next clicks
+        int active = archiveList.activeIndex;
+        if (active >= 0) {
+            prefetchIdleIssued = TRUE;
+            if (active + 1 < archiveList.count) PrefetchDocument(GetArchivePath(&archiveList, active + 1));
+            if (active > 0) PrefetchDocument(GetArchivePath(&archiveList, active - 1));
+        }
+    }
 
-    printf("Markdown reparsed\n");
+    PollDocumentLoader(&documentLoader);
+    DropCancelledStreams();
 }
 
 void HandleArchiveListItemClick(Clay_ElementId elementId, Clay_PointerData pointerInfo, intptr_t userData) {
+    int index = (int) userData;
+    hoveredArchiveIndex = index;
+
     if (pointerInfo.state != CLAY_POINTER_DATA_PRESSED_THIS_FRAME) {
         return;
     }
 
-    ArchiveEntry* entry = (ArchiveEntry*) userData;
-    for (int i = 0; i < archiveCount; i++) {
-        archives[i].active = FALSE;
+    archiveList.activeIndex = index;
+    RequireMarkdownReparse(GetArchivePath(&archiveList, index));
+}
+
+void SearchBox() {
+    // the caret doesn't blink, that would keep the main loop from ever idling
+    static char display[SEARCH_QUERY_CAPACITY + 4];
+    Bool placeholder = searchQueryLength == 0 && !searchFocused;
+    int length = placeholder ? snprintf(display, sizeof(display), "Search...")
+                             : snprintf(display, sizeof(display), "%.*s%s", searchQueryLength, searchQuery,
+                                        searchFocused ? "|" : "");
+
+    CLAY({
+            .id = CLAY_ID("SearchBox"),
+            .layout = {.padding = {12, 12, 8, 8}, .sizing = {CLAY_SIZING_GROW(), CLAY_SIZING_FIT()}},
+            .backgroundColor = {255, 255, 255, 255},
+            .cornerRadius = CLAY_CORNER_RADIUS(6),
+            .border = {
+                    .color = searchFocused ? (Clay_Color){3, 102, 214, 255} : (Clay_Color){209, 213, 218, 255},
+                    .width = CLAY_BORDER_ALL(1),
+            },
+    }) {
+        Clay_OnHover(HandleSearchBoxClick, 0);
+        CLAY_TEXT(((Clay_String){.length = length, .chars = display}),
+                  CLAY_TEXT_CONFIG({
+                          .fontId = ZHCN_FONT_NORMAL,
+                          .fontSize = 18,
+                          .textColor = placeholder ? (Clay_Color){106, 115, 125, 255} : (Clay_Color){36, 41, 46, 255},
+                  }));
+    }
+}
+
+void ArchiveRowSpacer(Clay_ElementId id, int rows) {
+    if (rows <= 0) return;
+
+    // stands in for the rows in between and all but one of their gaps, the list's childGap adds the last
+    CLAY({
+            .id = id,
+            .layout = {.sizing = {CLAY_SIZING_GROW(), CLAY_SIZING_FIXED(rows * ARCHIVE_ROW_STRIDE - ARCHIVE_ROW_GAP)}},
+    }) {}
+}
+
+void ArchiveRows() {
+    // scroll offset and height of the list from the previous frame
+    Clay_ScrollContainerData scrollData = Clay_GetScrollContainerData(CLAY_ID("ArchiveList"));
+    float scrollY = 0.0f;
+    float viewportHeight = (float) GetScreenHeight();
+    if (scrollData.found && scrollData.scrollPosition) {
+        scrollY = -scrollData.scrollPosition->y;
+        viewportHeight = scrollData.scrollContainerDimensions.height;
     }
 
-    entry->active = TRUE;
-    RequireMarkdownReparse(entry->path.chars);
+    int rowCount = GetSidebarRowCount();
+    int firstRow = (int) (scrollY / ARCHIVE_ROW_STRIDE) - ARCHIVE_ROW_OVERSCAN;
+    int endRow = (int) ((scrollY + viewportHeight) / ARCHIVE_ROW_STRIDE) + 1 + ARCHIVE_ROW_OVERSCAN;
+    firstRow = firstRow < 0 ? 0 : firstRow;
+    endRow = endRow > rowCount ? rowCount : endRow;
+    firstRow = firstRow > endRow ? endRow : firstRow;
+
+    CLAY({
+            .id = CLAY_ID("ArchiveList"),
+            .layout = {
+                    .sizing = {CLAY_SIZING_GROW(), CLAY_SIZING_GROW()},
+                    .layoutDirection = CLAY_TOP_TO_BOTTOM,
+                    .childGap = ARCHIVE_ROW_GAP,
+            },
+            .clip = {
+                    .vertical = TRUE,
+                    .childOffset = Clay_GetScrollOffset(),
+            },
+    }) {
+        ArchiveRowSpacer(CLAY_ID("ArchiveSpacerTop"), firstRow);
+
+        for (int row = firstRow; row < endRow; row++) {
+            int i = GetSidebarRowEntry(row);
+            CLAY({
+                    .id = CLAY_IDI("SidebarItem", i),
+                    .layout = {
+                            .padding = {12, 12, 0, 0},
+                            .sizing = {CLAY_SIZING_GROW(), CLAY_SIZING_FIXED(ARCHIVE_ROW_HEIGHT)},
+                            .childAlignment = {.y = CLAY_ALIGN_Y_CENTER},
+                    },
+                    .backgroundColor = i == archiveList.activeIndex
+                                               ? (Clay_Color){220, 234, 255, 255}
+                                               : (Clay_Hovered()
+                                                          ? (Clay_Color){240, 240, 240, 255}
+                                                          : (Clay_Color){0, 0, 0, 0}),
+                    .cornerRadius = CLAY_CORNER_RADIUS(6),
+                    .clip = {.horizontal = TRUE},
+            }) {
+                Clay_OnHover(HandleArchiveListItemClick, (intptr_t) i);
+                CLAY_TEXT(GetArchiveName(&archiveList, i),
+                          CLAY_TEXT_CONFIG({
+                                  .fontId = ZHCN_FONT_NORMAL,
+                                  .fontSize = 18,
+                                  .textColor = {36, 41, 46, 255},
+                                  // one line per row, so every row keeps the fixed height
+                                  .wrapMode = CLAY_TEXT_WRAP_NONE,
+                          }));
+            }
+        }
+
+        ArchiveRowSpacer(CLAY_ID("ArchiveSpacerBottom"), rowCount - endRow);
+    }
 }
 
 void SideBar() {
@@ -621,27 +922,11 @@ void SideBar() {
                           .textColor = {36, 41, 46, 255},
                   }));
 
-        for (int i = 0; i < archiveCount; i++) {
-            ArchiveEntry* entry = &archives[i];
-            CLAY({
-                    .id = CLAY_IDI("SidebarItem", i),
-                    .layout = {.padding = {12, 12, 8, 12}, .sizing = {CLAY_SIZING_GROW(), CLAY_SIZING_FIT()}},
-                    .backgroundColor = archives[i].active
-                                               ? (Clay_Color){220, 234, 255, 255}
-                                               : (Clay_Hovered()
-                                                          ? (Clay_Color){240, 240, 240, 255}
-                                                          : (Clay_Color){0, 0, 0, 0}),
-                    .cornerRadius = CLAY_CORNER_RADIUS(6),
-            }) {
-                Clay_OnHover(HandleArchiveListItemClick, (intptr_t) entry);
-                CLAY_TEXT(entry->name,
-                          CLAY_TEXT_CONFIG({
-                                  .fontId = ZHCN_FONT_NORMAL,
-                                  .fontSize = 18,
-                                  .textColor = {36, 41, 46, 255},
-                          }));
-            }
+        if (searchIndexLoaded) {
+            SearchBox();
         }
+
+        ArchiveRows();
     }
 }
 
@@ -659,7 +944,7 @@ void MainContainer() {
     }) {
         SideBar();
 
-        if (needsParse && !needsParseFileContent) {
+        if (needsParse) {
             CLAY({
                     .id = CLAY_ID("LoadingContainer"),
                     .layout = {
@@ -680,19 +965,167 @@ void MainContainer() {
                                   .textColor = {36, 41, 46, 255},
                           }));
             }
-        } else {
-            MarkdownRenderer(globalRenderCommandCache, globalRenderCommandCount);
+        } else if (currentDocument) {
+            MarkdownRenderer(currentDocument);
         }
     }
 }
 
+/* ---------- frame profiler ---------- */
+
+#define PROFILER_OVERLAY_FONT_SIZE 10
+#define PROFILER_OVERLAY_LINE_HEIGHT 14
+#define PROFILER_OVERLAY_WIDTH 330
+#define PROFILER_TRACE_FILE "burogu-trace.json"
+
+FrameProfiler frameProfiler;
+Bool profilerOverlayVisible = FALSE;
+uint64_t profiledMeasureMisses = 0; // measure cache misses when the frame began
+
+#ifdef EMSCRIPTEN
+/* clang-format off */
+void DownloadTraceJS(const char* json, size_t length) {
+    EM_ASM({
+        const link = document.createElement('a');
+        link.href = URL.createObjectURL(new Blob([UTF8ToString($0, $1)], { type: 'application/json' }));
+        link.download = UTF8ToString($2);
+        link.click();
+        URL.revokeObjectURL(link.href);
+    }, json, length, PROFILER_TRACE_FILE);
+}
+/* clang-format on */
+#endif
+
+void ExportFrameProfile() {
+    size_t length = 0;
+    char* json = ExportFrameProfileTrace(&frameProfiler, &length);
+#ifdef EMSCRIPTEN
+    DownloadTraceJS(json, length);
+#else
+    if (SaveFileData(PROFILER_TRACE_FILE, json, (int) length)) {
+        printf("Frame trace of %d frames written to %s\n", frameProfiler.count, PROFILER_TRACE_FILE);
+    }
+#endif
+    free(json);
+}
+
+// F3 shows the overlay, F4 saves the frames kept as a trace
+unsigned int UpdateFrameProfilerKeys() {
+    if (IsKeyPressed(KEY_F3)) {
+        profilerOverlayVisible = !profilerOverlayVisible;
+        return FRAME_DIRTY_PROFILER;
+    }
+    if (IsKeyPressed(KEY_F4)) {
+        ExportFrameProfile();
+    }
+    return FRAME_DIRTY_NONE;
+}
+
+void RecordFrameCounters() {
+    Raylib_FrameCounters counters = Raylib_GetFrameCounters();
+    uint64_t misses = Raylib_GetMeasureCacheStats().misses;
+
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_MEASURE_TEXT, counters.measureTextCalls);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_MEASURE_MISSES, (uint32_t) (misses - profiledMeasureMisses));
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_GLYPH_LOOKUPS, counters.glyphLookups);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_RECTANGLES, counters.commandsByType[CLAY_RENDER_COMMAND_TYPE_RECTANGLE]);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_BORDERS, counters.commandsByType[CLAY_RENDER_COMMAND_TYPE_BORDER]);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_TEXTS, counters.commandsByType[CLAY_RENDER_COMMAND_TYPE_TEXT]);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_IMAGES, counters.commandsByType[CLAY_RENDER_COMMAND_TYPE_IMAGE]);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_SCISSORS, counters.commandsByType[CLAY_RENDER_COMMAND_TYPE_SCISSOR_START]);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_CUSTOM, counters.commandsByType[CLAY_RENDER_COMMAND_TYPE_CUSTOM]);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_CULLED, counters.culledCommands);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_TEXTURE_SWITCHES, counters.textureSwitches);
+    SetProfiledCounter(&frameProfiler, PROFILE_COUNTER_BATCH_FLUSHES, counters.batchFlushes);
+}
+
+// Drawn over the frame after it has been timed, in raylib's default font so it doesn't touch the glyph atlas
+void DrawFrameProfilerOverlay() {
+    const FrameSample* last = GetLastProfiledFrame(&frameProfiler);
+    if (!last) return;
+
+    int lines = 2 + PROFILE_PHASE_COUNT + 1 + (PROFILE_COUNTER_COUNT + 1) / 2;
+    int x = GetScreenWidth() - PROFILER_OVERLAY_WIDTH - 8;
+    int y = 8;
+    DrawRectangle(x, y, PROFILER_OVERLAY_WIDTH, lines * PROFILER_OVERLAY_LINE_HEIGHT + 8, (Color){0, 0, 0, 200});
+    x += 6;
+    y += 4;
+
+    char text[64];
+    const int columns[4] = {110, 165, 220, 275};
+    const char* headings[4] = {"p50", "p95", "p99", "max"};
+    snprintf(text, sizeof(text), "ms, %d frames", frameProfiler.count);
+    DrawText(text, x, y, PROFILER_OVERLAY_FONT_SIZE, LIGHTGRAY);
+    for (int c = 0; c < 4; c++) {
+        DrawText(headings[c], x + columns[c], y, PROFILER_OVERLAY_FONT_SIZE, LIGHTGRAY);
+    }
+    y += PROFILER_OVERLAY_LINE_HEIGHT;
+
+    for (int phase = 0; phase <= PROFILE_PHASE_COUNT; phase++) {
+        ProfilePercentiles percentiles = GetProfiledPhasePercentiles(&frameProfiler, phase);
+        const float values[4] = {percentiles.p50, percentiles.p95, percentiles.p99, percentiles.max};
+        Color color = phase == PROFILE_PHASE_COUNT ? YELLOW : RAYWHITE;
+        DrawText(phase == PROFILE_PHASE_COUNT ? "frame" : profilePhaseNames[phase], x, y, PROFILER_OVERLAY_FONT_SIZE, color);
+        for (int c = 0; c < 4; c++) {
+            snprintf(text, sizeof(text), "%.2f", values[c]);
+            DrawText(text, x + columns[c], y, PROFILER_OVERLAY_FONT_SIZE, color);
+        }
+        y += PROFILER_OVERLAY_LINE_HEIGHT;
+    }
+
+    // counters of the last frame, two to a line
+    y += PROFILER_OVERLAY_LINE_HEIGHT;
+    for (int counter = 0; counter < PROFILE_COUNTER_COUNT; counter++) {
+        int column = (counter % 2) * (PROFILER_OVERLAY_WIDTH / 2);
+        snprintf(text, sizeof(text), "%s %u", profileCounterNames[counter], last->counters[counter]);
+        DrawText(text, x + column, y, PROFILER_OVERLAY_FONT_SIZE, RAYWHITE);
+        if (counter % 2 == 1) y += PROFILER_OVERLAY_LINE_HEIGHT;
+    }
+}
+
 void MainLoop() {
+    // dropped again if nothing changed and the frame isn't drawn
+    BeginProfiledFrame(&frameProfiler);
+    BeginProfiledPhase(&frameProfiler, PROFILE_PHASE_INPUT);
+    Raylib_ResetFrameCounters();
+    profiledMeasureMisses = Raylib_GetMeasureCacheStats().misses;
+
+    frameDirtyFlags |= CollectInputDirtyFlags();
+    frameDirtyFlags |= UpdateSearchInput();
+    frameDirtyFlags |= UpdateFrameProfilerKeys();
+
+    if (frameDirtyFlags == FRAME_DIRTY_NONE && settleFramesLeft == 0) {
+        // nothing changed: keep raylib's input state fresh (EndDrawing would have) and skip layout and drawing
+        PollInputEvents();
+        UpdatePrefetch(TRUE);
+        if (!mainLoopThrottled && GetTime() - lastActiveTime > IDLE_THROTTLE_DELAY) {
+            SetMainLoopThrottled(TRUE);
+        }
+        return;
+    }
+
+    if (frameDirtyFlags != FRAME_DIRTY_NONE) {
+        // a changed layout under a static pointer can change what is hovered, so draw one more frame afterwards
+        settleFramesLeft = IDLE_SETTLE_FRAMES;
+        lastActiveTime = GetTime();
+        SetMainLoopThrottled(FALSE);
+    } else {
+        settleFramesLeft--;
+    }
+    frameDirtyFlags = FRAME_DIRTY_NONE;
+
     Clay_SetLayoutDimensions((Clay_Dimensions){GetScreenWidth(), GetScreenHeight()});
 
     double ratio = GetDevicePixelRatio();
 
     Vector2 mousePos = GetMousePosition();
     Vector2 wheelMove = GetMouseWheelMoveV();
+    // before layout, so documents that arrive here aren't swapped out between layout and drawing
+    BeginProfiledPhase(&frameProfiler, PROFILE_PHASE_DOCUMENT);
+    UpdatePrefetch(FALSE);
+    BeginProfiledPhase(&frameProfiler, PROFILE_PHASE_INPUT);
+    // set again by the hover callback if the pointer is still over an archive entry
+    hoveredArchiveIndex = -1;
     Clay_SetPointerState((Clay_Vector2){mousePos.x, mousePos.y}, IsMouseButtonDown(MOUSE_LEFT_BUTTON));
     Clay_UpdateScrollContainers(
             FALSE,
@@ -702,66 +1135,138 @@ void MainLoop() {
             },
             GetFrameTime());
 
+    BeginProfiledPhase(&frameProfiler, PROFILE_PHASE_LAYOUT);
     Clay_BeginLayout();
 
-    ReparseIfRequested();
-
     MainContainer();
 
+    BeginProfiledPhase(&frameProfiler, PROFILE_PHASE_END_LAYOUT);
     Clay_RenderCommandArray renderCommands = Clay_EndLayout();
 
+    BeginProfiledPhase(&frameProfiler, PROFILE_PHASE_RENDER);
     BeginDrawing();
     ClearBackground(WHITE);
     Clay_Raylib_Render(renderCommands, embeddedFonts);
+    // what EndDrawing would flush first, so it's timed without the wait for the swap
+    Raylib_DrawRenderBatchActive();
+    RecordFrameCounters();
+    EndProfiledFrame(&frameProfiler);
+
+    if (profilerOverlayVisible) {
+        DrawFrameProfilerOverlay();
+    }
     EndDrawing();
+    frameDrawn = TRUE;
 }
 
+#ifndef EMSCRIPTEN
+// The browser paces the web build; natively the loop sleeps whenever MainLoop skipped drawing. Frames are paced here
+// rather than by raylib blocking for input (event waiting stays off), so file changes get picked up while idle
+void RunNativeMainLoop() {
+    // Escape belongs to the search box
+    SetExitKey(KEY_NULL);
+
+    while (!WindowShouldClose()) {
+#ifdef BUROGU_LIVE_RELOAD
+        if (liveReloadActive) {
+            PollLiveReloadChanges();
+        }
+#endif
+        frameDrawn = FALSE;
+        MainLoop();
+        if (!frameDrawn) {
+            WaitTime(mainLoopThrottled ? IDLE_FRAME_INTERVAL_MS / 1000.0 : 1.0 / 60.0);
+        }
+    }
+
+#ifdef BUROGU_LIVE_RELOAD
+    StopLiveReload(&liveReload);
+#endif
+}
+#endif
+
 void HandleError(Clay_ErrorData errorData) {
     printf("Error: %s\n", errorData.errorText.chars);
 }
 
+// glyphs the baked bundle doesn't have are rasterized on a canvas the first time they're drawn
+static const CanvasFontSpec canvasFonts[16] = {
+        [ZHCN_FONT_NORMAL] = {FONT_NAME_NORMAL, 18, FONT_NORMAL_WEIGHT, FONT_STYLE_NORMAL},
+        [ZHCN_FONT_NORMAL_BOLD] = {FONT_NAME_NORMAL, 18, FONT_BOLD_WEIGHT, FONT_STYLE_NORMAL},
+        [ZHCN_FONT_NORMAL_ITALIC] = {FONT_NAME_NORMAL, 18, FONT_NORMAL_WEIGHT, FONT_STYLE_ITALIC},
+        [ZHCN_FONT_NORMAL_BOLD_ITALIC] = {FONT_NAME_NORMAL, 18, FONT_BOLD_WEIGHT, FONT_STYLE_ITALIC},
+
+        [ZHCN_FONT_BIG] = {FONT_NAME_NORMAL, 48, FONT_NORMAL_WEIGHT, FONT_STYLE_NORMAL},
+        [ZHCN_FONT_BIG_BOLD] = {FONT_NAME_NORMAL, 48, FONT_BOLD_WEIGHT, FONT_STYLE_NORMAL},
+        [ZHCN_FONT_BIG_ITALIC] = {FONT_NAME_NORMAL, 48, FONT_NORMAL_WEIGHT, FONT_STYLE_ITALIC},
+        [ZHCN_FONT_BIG_BOLD_ITALIC] = {FONT_NAME_NORMAL, 48, FONT_BOLD_WEIGHT, FONT_STYLE_ITALIC},
+
+        [CODE_FONT_MONOSPACE] = {FONT_NAME_MONOSPACE, 18, FONT_NORMAL_WEIGHT, FONT_STYLE_NORMAL},
+};
+
+#define FONT_BUNDLE_FILE MARKDOWN_BASE_PATH "fonts.bundle"
+
+// Canvas faces are rasterized once as distance fields at SDF_TEXT_BASE_SIZE and every slot with the same family,
+// weight and style draws from them; set to 0 for per-size coverage glyphs at the device pixel ratio
+#define SDF_TEXT 1
+#define SDF_TEXT_BASE_SIZE 40
+
+// baked faces copy their glyphs out of this as they're drawn
+unsigned char* fontBundle = NULL;
+
+#if SDF_TEXT
+// Slot already holding a distance field face for this family, weight and style, baked ones included
+int FindDistanceFieldFace(CanvasFontSpec spec) {
+    for (int i = 0; i < 16; i++) {
+        const FontAtlas* atlas = &embeddedFonts[i];
+        if (!atlas->distanceField || atlas->sharedFace || !canvasFonts[i].name) continue;
+
+        if (strcmp(canvasFonts[i].name, spec.name) == 0 && strcmp(canvasFonts[i].weight, spec.weight) == 0 &&
+            strcmp(canvasFonts[i].style, spec.style) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+#endif
+
+// Nothing is rasterized here, fonts only pick up glyphs as text is measured and drawn
 void LoadEmbeddedResources() {
-    char* glyphRange = ReadGlyphRange();
-
-    embeddedFonts[ZHCN_FONT_NORMAL] = LoadFontAtlasFromJS(
-            FONT_NAME_NORMAL, 18,
-            glyphRange, FONT_NORMAL_WEIGHT, FONT_STYLE_NORMAL);
-    embeddedFonts[ZHCN_FONT_NORMAL_BOLD] = LoadFontAtlasFromJS(
-            FONT_NAME_NORMAL, 18,
-            glyphRange, FONT_BOLD_WEIGHT, FONT_STYLE_NORMAL);
-    embeddedFonts[ZHCN_FONT_NORMAL_ITALIC] = LoadFontAtlasFromJS(
-            FONT_NAME_NORMAL, 18,
-            glyphRange, FONT_NORMAL_WEIGHT, FONT_STYLE_ITALIC);
-    embeddedFonts[ZHCN_FONT_NORMAL_BOLD_ITALIC] = LoadFontAtlasFromJS(
-            FONT_NAME_NORMAL, 18,
-            glyphRange, FONT_BOLD_WEIGHT, FONT_STYLE_ITALIC);
-
-    embeddedFonts[ZHCN_FONT_BIG] = LoadFontAtlasFromJS(
-            FONT_NAME_NORMAL, 48,
-            glyphRange, FONT_NORMAL_WEIGHT, FONT_STYLE_NORMAL);
-    embeddedFonts[ZHCN_FONT_BIG_BOLD] = LoadFontAtlasFromJS(
-            FONT_NAME_NORMAL, 48,
-            glyphRange, FONT_BOLD_WEIGHT, FONT_STYLE_NORMAL);
-    embeddedFonts[ZHCN_FONT_BIG_ITALIC] = LoadFontAtlasFromJS(
-            FONT_NAME_NORMAL, 48,
-            glyphRange, FONT_NORMAL_WEIGHT, FONT_STYLE_ITALIC);
-    embeddedFonts[ZHCN_FONT_BIG_BOLD_ITALIC] = LoadFontAtlasFromJS(
-            FONT_NAME_NORMAL, 48,
-            glyphRange, FONT_BOLD_WEIGHT, FONT_STYLE_ITALIC);
-
-    embeddedFonts[CODE_FONT_MONOSPACE] = LoadFontAtlasFromJS(
-            FONT_NAME_MONOSPACE, 18,
-            glyphRange, FONT_NORMAL_WEIGHT, FONT_STYLE_NORMAL);
-
-    free(glyphRange);
+    int bundleSize = 0;
+    fontBundle = FileExists(FONT_BUNDLE_FILE) ? LoadFileData(FONT_BUNDLE_FILE, &bundleSize) : NULL;
+    if (fontBundle) {
+        int loaded = LoadFontBundle(fontBundle, (size_t) bundleSize, &glyphAtlas, embeddedFonts, 16, canvasFonts);
+        printf("Loaded %d fonts from %s\n", loaded, FONT_BUNDLE_FILE);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        if (!canvasFonts[i].name || embeddedFonts[i].font.glyphs) continue;
+
+#if SDF_TEXT
+        int face = FindDistanceFieldFace(canvasFonts[i]);
+        if (face >= 0) {
+            embeddedFonts[i] = ShareFontAtlasFace(&embeddedFonts[face]);
+            continue;
+        }
+
+        CanvasFontSpec spec = canvasFonts[i];
+        spec.fontSize = SDF_TEXT_BASE_SIZE;
+        embeddedFonts[i] = CreateDistanceFieldFontAtlas(&glyphAtlas, spec);
+#else
+        embeddedFonts[i] = CreateCanvasFontAtlas(&glyphAtlas, canvasFonts[i]);
+#endif
+    }
 }
 
 void UnloadEmbeddedResources() {
     for (int i = 0; i < 16; i++) {
-        if (embeddedFonts[i].texture.id != 0) {
-            UnloadFont(embeddedFonts[i]);
+        if (embeddedFonts[i].font.glyphs || embeddedFonts[i].glyphAtlas) {
+            UnloadFontAtlas(&embeddedFonts[i]);
         }
     }
+    FreeGlyphAtlas(&glyphAtlas);
+    UnloadFileData(fontBundle);
+    fontBundle = NULL;
 }
 
 int main() {
@@ -772,15 +1277,37 @@ int main() {
     Clay_Initialize(arena, (Clay_Dimensions){800, 600}, (Clay_ErrorHandler){HandleError});
     Clay_Raylib_Initialize(800, 600, "Burogu", 0);
 
+    InitGlyphAtlas(&glyphAtlas, GLYPH_ATLAS_PAGE_SIZE, GLYPH_ATLAS_DEFAULT_PAGE_BUDGET);
     LoadEmbeddedResources();
 
     Clay_SetMeasureTextFunction(Raylib_MeasureText, embeddedFonts);
 
-    RequestArchiveLoadJS();
-    RequireMarkdownReparse("_main.md");
+    InitDocumentCache(&documentCache, DOCUMENT_CACHE_DEFAULT_BUDGET);
+    InitFrameProfiler(&frameProfiler);
+#ifdef EMSCRIPTEN
+    InitDocumentLoader(&documentLoader,
+                       (DocumentLoaderBackend){.start = StartFetchJS, .cancel = CancelFetchJS},
+                       OnFileLoaded);
+#else
+    InitDocumentLoader(&documentLoader, GetFileLoaderBackend(), OnFileLoaded);
+    documentLoader.fileRoot = MARKDOWN_BASE_PATH;
+#endif
+    documentLoader.onChunk = OnFileChunk;
+    documentLoader.onStreamEnd = OnFileStreamEnd;
+#ifdef BUROGU_LIVE_RELOAD
+    // before the first post is requested, so it's read as markdown too
+    liveReloadActive = StartLiveReload(&liveReload, MARKDOWN_BASE_PATH);
+#endif
+    parseThreadCount = GetDefaultParseThreadCount();
+    InitArchiveList(&archiveList);
+    RequestArchiveLoad();
+    RequestSearchIndexLoad();
+    RequireMarkdownReparse("_main" BINARY_DOCUMENT_EXTENSION);
 
 #ifdef EMSCRIPTEN
     emscripten_set_main_loop(MainLoop, 0, 1);
+#else
+    RunNativeMainLoop();
 #endif
 
     UnloadEmbeddedResources();
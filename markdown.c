@@ -0,0 +1,1295 @@
+#include "markdown.h"
+
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cmark.h>
+
+#ifdef BUROGU_PARALLEL_PARSE
+#include <pthread.h>
+#ifdef EMSCRIPTEN
+#include <emscripten/threading.h>
+#else
+#include <unistd.h>
+#endif
+#endif
+
+const FontSizes fontSizes = {
+        .h1 = 48.0f,
+        .h2 = 36.0f,
+        .h3 = 28.0f,
+        .body = 18.0f,
+        .small = 14.0f,
+};
+
+#define MARKDOWN_CONTENT_PADDING 32
+#define MARKDOWN_BLOCK_GAP 8
+
+// Blocks within this many viewport heights above and below the visible area are still laid out
+#define MARKDOWN_VIRTUALIZATION_MARGIN 1.0f
+// Used before clay has reported the real size of the content area
+#define MARKDOWN_FALLBACK_VIEWPORT_WIDTH 800.0f
+#define MARKDOWN_FALLBACK_VIEWPORT_HEIGHT 1080.0f
+
+// Strings that don't appear verbatim in the source are copied into a list of chunks that grows on demand
+#define TEXT_ARENA_CHUNK_SIZE (16 * 1024)
+// How far past a node's source position a literal is looked for before falling back to a copy
+#define SOURCE_SLICE_SEARCH_WINDOW 256
+
+// Sources shorter than this aren't worth starting threads for
+#define MARKDOWN_PARALLEL_MIN_BYTES (256 * 1024)
+// Work units per thread, so a unit that happens to parse slowly doesn't hold the others up
+#define MARKDOWN_PARALLEL_UNITS_PER_THREAD 4
+#define MARKDOWN_PARALLEL_MAX_THREADS 16
+
+struct TextArenaChunk {
+    struct TextArenaChunk* next;
+    size_t used;
+    size_t capacity;
+    char data[];
+};
+
+// interned once, shared by every soft break and bullet item
+static const Clay_String softBreakString = {.isStaticallyAllocated = true, .length = 1, .chars = " "};
+static const Clay_String bulletPrefixString = {.isStaticallyAllocated = true, .length = 4, .chars = " -  "};
+
+static Clay_String AllocateSliceInArena(TextArena* arena, const char* str, size_t length) {
+    TextArenaChunk* chunk = arena->head;
+    if (!chunk || chunk->used + length + 1 > chunk->capacity) {
+        size_t capacity = length + 1 > TEXT_ARENA_CHUNK_SIZE ? length + 1 : TEXT_ARENA_CHUNK_SIZE;
+        chunk = (TextArenaChunk*) malloc(sizeof(TextArenaChunk) + capacity);
+        if (!chunk) {
+            printf("Text arena out of memory!\n");
+            return (Clay_String){0};
+        }
+        chunk->used = 0;
+        chunk->capacity = capacity;
+        arena->bytes += sizeof(TextArenaChunk) + capacity;
+
+        // an oversized string gets its own chunk behind the current one so the free space there stays usable
+        if (arena->head && capacity > TEXT_ARENA_CHUNK_SIZE) {
+            chunk->next = arena->head->next;
+            arena->head->next = chunk;
+        } else {
+            chunk->next = arena->head;
+            arena->head = chunk;
+        }
+    }
+
+    char* dest = &chunk->data[chunk->used];
+    memcpy(dest, str, length);
+    dest[length] = '\0';
+    chunk->used += length + 1;
+
+    return (Clay_String){.chars = dest, .length = (int) length};
+}
+
+Clay_String AllocateStringInArena(TextArena* arena, const char* str) {
+    if (!str) {
+        return (Clay_String){0};
+    }
+    return AllocateSliceInArena(arena, str, strlen(str));
+}
+
+void FreeTextArena(TextArena* arena) {
+    while (arena->head) {
+        TextArenaChunk* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    arena->bytes = 0;
+}
+
+/* ---------- zero-copy slices into the source ---------- */
+
+typedef struct {
+    const char* text;
+    size_t length;
+    int* lineStarts;
+    int lineCount;
+} SourceIndex;
+
+static SourceIndex BuildSourceIndex(const char* markdown, size_t length) {
+    SourceIndex index = {.text = markdown, .length = length};
+
+    int* lineStarts;
+    DYNARRAY_INIT(lineStarts, 64);
+    DYNARRAY_PUSHBACK(lineStarts, 0);
+    for (size_t i = 0; i < length; i++) {
+        // same line endings as cmark: \n, \r\n and a lone \r
+        if (markdown[i] == '\r' && i + 1 < length && markdown[i + 1] == '\n') {
+            i++;
+        }
+        if (markdown[i] == '\n' || markdown[i] == '\r') {
+            DYNARRAY_PUSHBACK(lineStarts, (int) (i + 1));
+        }
+    }
+
+    index.lineStarts = lineStarts;
+    index.lineCount = DYNARRAY_SIZE(lineStarts);
+    return index;
+}
+
+static void FreeSourceIndex(SourceIndex* index) {
+    free(index->lineStarts);
+    index->lineStarts = NULL;
+    index->lineCount = 0;
+}
+
+// Points the string at the source bytes when the literal is found there verbatim, otherwise copies it.
+// Escapes, entities and container prefixes inside code blocks make the literal differ from the source.
+static Clay_String SliceOrCopyLiteral(const SourceIndex* index, TextArena* arena, cmark_node* node, size_t* cursor) {
+    const char* literal = cmark_node_get_literal(node);
+    if (!literal) {
+        return (Clay_String){0};
+    }
+
+    size_t length = strlen(literal);
+    if (length == 0) {
+        return (Clay_String){0};
+    }
+
+    size_t from = *cursor;
+    int line = cmark_node_get_start_line(node);
+    int column = cmark_node_get_start_column(node);
+    if (line > 0 && line <= index->lineCount && column > 0) {
+        from = (size_t) index->lineStarts[line - 1] + (size_t) (column - 1);
+    }
+
+    if (from < index->length && length <= index->length) {
+        size_t last = index->length - length;
+        size_t windowEnd = from + SOURCE_SLICE_SEARCH_WINDOW < last ? from + SOURCE_SLICE_SEARCH_WINDOW : last;
+        for (size_t at = from; at <= windowEnd; at++) {
+            const char* hit = (const char*) memchr(index->text + at, literal[0], windowEnd - at + 1);
+            if (!hit) break;
+            at = (size_t) (hit - index->text);
+            if (memcmp(hit, literal, length) == 0) {
+                *cursor = at + length;
+                return (Clay_String){.chars = hit, .length = (int) length};
+            }
+        }
+    }
+
+    return AllocateSliceInArena(arena, literal, length);
+}
+
+Bool IsBlockPopStyleStackRequired(cmark_node_type type) {
+    return type == CMARK_NODE_HEADING || type == CMARK_NODE_BLOCK_QUOTE ||
+           type == CMARK_NODE_STRONG || type == CMARK_NODE_EMPH ||
+           type == CMARK_NODE_LIST;
+}
+
+
+/* ---------- style table ---------- */
+
+typedef struct {
+    Clay_TextElementConfig* styles;
+    int count;
+    int capacity;
+    int lastId; // consecutive text runs nearly always share a style
+} StyleTable;
+
+static Bool IsSameTextStyle(const Clay_TextElementConfig* a, const Clay_TextElementConfig* b) {
+    return a->fontId == b->fontId && a->fontSize == b->fontSize &&
+           a->textColor.r == b->textColor.r && a->textColor.g == b->textColor.g &&
+           a->textColor.b == b->textColor.b && a->textColor.a == b->textColor.a &&
+           a->letterSpacing == b->letterSpacing && a->lineHeight == b->lineHeight &&
+           a->wrapMode == b->wrapMode && a->textAlignment == b->textAlignment;
+}
+
+static uint16_t InternResolvedStyle(StyleTable* table, Clay_TextElementConfig resolved) {
+    if (table->count > 0 && IsSameTextStyle(&table->styles[table->lastId], &resolved)) {
+        return (uint16_t) table->lastId;
+    }
+    for (int i = 0; i < table->count; i++) {
+        if (IsSameTextStyle(&table->styles[i], &resolved)) {
+            table->lastId = i;
+            return (uint16_t) i;
+        }
+    }
+
+    if (table->count >= MARKDOWN_MAX_STYLES) {
+        printf("Style table full, reusing the last style!\n");
+        return (uint16_t) (table->count - 1);
+    }
+
+    if (table->count >= table->capacity) {
+        table->capacity = table->capacity == 0 ? 16 : table->capacity * 2;
+        table->styles = (Clay_TextElementConfig*) realloc(table->styles, table->capacity * sizeof(Clay_TextElementConfig));
+    }
+    table->styles[table->count] = resolved;
+    table->lastId = table->count;
+    return (uint16_t) table->count++;
+}
+
+static uint16_t InternStyle(StyleTable* table, Clay_TextElementConfig config, TextState state) {
+    // resolve everything the renderer needs once here, rather than per text element per frame
+    Clay_TextElementConfig resolved = {
+            .fontId = RemapFontId(config.fontId, state.bold, state.italic, state.monospace),
+            .fontSize = config.fontSize,
+            .textColor = config.textColor,
+            .lineHeight = config.fontSize * 1.5f,
+            .wrapMode = CLAY_TEXT_WRAP_WORDS,
+    };
+    return InternResolvedStyle(table, resolved);
+}
+
+static RenderCommand TextCommand(StyleTable* table, Clay_String content, Clay_TextElementConfig config, TextState state) {
+    return (RenderCommand){
+            .type = CMD_TEXT,
+            .styleId = InternStyle(table, config, state),
+            .length = content.length,
+            .chars = content.chars,
+    };
+}
+
+static atomic_uint documentGeneration;
+
+uint32_t NextMarkdownDocumentGeneration() {
+    // parallel parses create documents from several threads; 0 is left for documents not built yet
+    return atomic_fetch_add(&documentGeneration, 1) + 1;
+}
+
+MarkdownDocument ParseMarkdownDocument(const char* markdown, size_t markdownLength) {
+    MarkdownDocument document = {.generation = NextMarkdownDocumentGeneration()};
+
+    cmark_node* root = cmark_parse_document(markdown, markdownLength, CMARK_OPT_DEFAULT);
+    if (!root) return document;
+
+    StyleTable styleTable = {0};
+
+    document.sourceLength = markdownLength;
+    SourceIndex source = BuildSourceIndex(markdown, markdownLength);
+    size_t sourceCursor = 0;
+
+    RenderCommand* commands;
+    DYNARRAY_INIT(commands, 16);
+
+    StyleFrame* styleStack;
+    STACK_INIT(styleStack, 8);
+
+    int* orderedListCounterStack;
+    STACK_INIT(orderedListCounterStack, 4);
+
+    Clay_TextElementConfig currentConfig = {
+            .fontId = ZHCN_FONT_NORMAL,
+            .fontSize = fontSizes.body,
+            .textColor = {0, 0, 0, 255},
+            .letterSpacing = 1.0f,
+    };
+    TextState currentState = {
+            .bold = FALSE,
+            .italic = FALSE,
+            .underline = FALSE,
+            .strikethrough = FALSE,
+            .monospace = FALSE,
+    };
+
+    cmark_iter* iter = cmark_iter_new(root);
+    cmark_event_type ev;
+
+    while ((ev = cmark_iter_next(iter)) != CMARK_EVENT_DONE) {
+        cmark_node* node = cmark_iter_get_node(iter);
+        cmark_node_type type = cmark_node_get_type(node);
+
+        if (ev == CMARK_EVENT_ENTER) {
+            if (IsBlockPopStyleStackRequired(type)) {
+                STACK_PUSH(styleStack, ((StyleFrame){currentConfig, currentState}));
+            }
+
+            if (type == CMARK_NODE_HEADING) {
+                int level = cmark_node_get_heading_level(node);
+                currentConfig.fontId = ZHCN_FONT_BIG;
+                currentConfig.fontSize = (level == 1)
+                                                 ? fontSizes.h1
+                                         : (level == 2)
+                                                 ? fontSizes.h2
+                                                 : fontSizes.h3;
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_HEADING}));
+            } else if (type == CMARK_NODE_BLOCK_QUOTE) {
+                currentConfig.textColor = (Clay_Color){120, 120, 120, 255};
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_QUOTE}));
+            } else if (type == CMARK_NODE_PARAGRAPH) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_PARAGRAPH}));
+            } else if (type == CMARK_NODE_CODE_BLOCK) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_CODE}));
+                Clay_TextElementConfig codeConfig = currentConfig;
+                codeConfig.textColor = (Clay_Color){200, 100, 50, 255};
+                TextState codeState = currentState;
+                codeState.monospace = TRUE;
+
+                Clay_String code = SliceOrCopyLiteral(&source, &document.text, node, &sourceCursor);
+                DYNARRAY_PUSHBACK(commands, TextCommand(&styleTable, code, codeConfig, codeState));
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_CODE}));
+            } else if (type == CMARK_NODE_STRONG) {
+                currentState.bold = true;
+            } else if (type == CMARK_NODE_EMPH) {
+                currentState.italic = true;
+            } else if (type == CMARK_NODE_TEXT) {
+                Clay_String text = SliceOrCopyLiteral(&source, &document.text, node, &sourceCursor);
+                DYNARRAY_PUSHBACK(commands, TextCommand(&styleTable, text, currentConfig, currentState));
+            } else if (type == CMARK_NODE_CODE) {
+                Clay_TextElementConfig codeConfig = currentConfig;
+                codeConfig.textColor = (Clay_Color){50, 50, 50, 255};
+                TextState codeState = currentState;
+                codeState.monospace = TRUE;
+
+                Clay_String code = SliceOrCopyLiteral(&source, &document.text, node, &sourceCursor);
+                DYNARRAY_PUSHBACK(commands, TextCommand(&styleTable, code, codeConfig, codeState));
+            } else if (type == CMARK_NODE_SOFTBREAK) {
+                DYNARRAY_PUSHBACK(commands, TextCommand(&styleTable, softBreakString, currentConfig, currentState));
+            } else if (type == CMARK_NODE_LIST) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_LIST_CONTAINER}));
+                if (cmark_node_get_list_type(node) == CMARK_ORDERED_LIST) {
+                    STACK_PUSH(orderedListCounterStack, 1);
+                }
+            } else if (type == CMARK_NODE_ITEM) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_LIST_ITEM}));
+
+                cmark_node* listNode = cmark_node_parent(node);
+                Clay_String prefix = bulletPrefixString;
+                if (cmark_node_get_list_type(listNode) != CMARK_BULLET_LIST) {
+                    int* idx = STACK_TOP(orderedListCounterStack);
+                    if (idx) {
+                        char number[16];
+                        snprintf(number, sizeof(number), " %d. ", *idx);
+                        prefix = AllocateStringInArena(&document.text, number);
+                        *idx += 1;
+                    } else {
+                        printf("Error: ordered list item without counter stack!\n");
+                    }
+                }
+
+                Clay_TextElementConfig bulletConfig = currentConfig;
+                bulletConfig.textColor = (Clay_Color){50, 50, 50, 255};
+                DYNARRAY_PUSHBACK(commands, TextCommand(&styleTable, prefix, bulletConfig, currentState));
+            } else if (type == CMARK_NODE_THEMATIC_BREAK) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_OPEN, .blockType = BT_HR}));
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_HR}));
+            }
+            // todo: handle more node types
+        } else if (ev == CMARK_EVENT_EXIT) {
+            if (type == CMARK_NODE_HEADING) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_HEADING}));
+            } else if (type == CMARK_NODE_BLOCK_QUOTE) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_QUOTE}));
+            } else if (type == CMARK_NODE_PARAGRAPH) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_PARAGRAPH}));
+            } else if (type == CMARK_NODE_LIST) {
+                if (cmark_node_get_list_type(node) == CMARK_ORDERED_LIST) {
+                    int popped;
+                    STACK_POP(orderedListCounterStack, &popped);
+                }
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_LIST_CONTAINER}));
+            } else if (type == CMARK_NODE_ITEM) {
+                DYNARRAY_PUSHBACK(commands, ((RenderCommand){.type = CMD_BLOCK_CLOSE, .blockType = BT_LIST_ITEM}));
+            }
+
+            if (IsBlockPopStyleStackRequired(type)) {
+                StyleFrame popped;
+                STACK_POP(styleStack, &popped);
+                currentConfig = popped.config;
+                currentState = popped.state;
+            }
+        }
+    }
+
+    STACK_FREE(styleStack);
+    STACK_FREE(orderedListCounterStack);
+    FreeSourceIndex(&source);
+    cmark_iter_free(iter);
+    cmark_node_free(root);
+
+    document.commands = commands;
+    document.commandCount = DYNARRAY_SIZE(commands);
+    document.styles = styleTable.styles;
+    document.styleCount = styleTable.count;
+    return document;
+}
+
+MarkdownDocument AdoptMarkdownDocument(char* source, size_t length) {
+    MarkdownDocument document = ParseMarkdownDocument(source, length);
+    document.ownedSource = source;
+    document.sourceLength = length;
+    return document;
+}
+
+/* ---------- block by block parsing ---------- */
+
+static size_t SkipIndent(const char* line, size_t length) {
+    size_t i = 0;
+    while (i < length && i < 3 && line[i] == ' ') i++;
+    return i;
+}
+
+static Bool IsBlankLine(const char* line, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (line[i] != ' ' && line[i] != '\t') return FALSE;
+    }
+    return TRUE;
+}
+
+// Length of the ``` or ~~~ run opening the line, 0 if it isn't a fence; outRunEnd is where the run stops
+static int FenceLength(const char* line, size_t length, char* outFenceChar, size_t* outRunEnd) {
+    size_t i = SkipIndent(line, length);
+    if (i >= length || (line[i] != '`' && line[i] != '~')) return 0;
+
+    char fenceChar = line[i];
+    int run = 0;
+    while (i < length && line[i] == fenceChar) {
+        i++;
+        run++;
+    }
+    *outFenceChar = fenceChar;
+    *outRunEnd = i;
+    return run >= 3 ? run : 0;
+}
+
+// Lines that could still belong to the block before a blank line: indented continuations, list items and quotes
+static Bool MayContinueContainer(const char* line, size_t length) {
+    char first = line[0];
+    if (first == ' ' || first == '\t' || first == '>') return TRUE;
+    if ((first == '-' || first == '*' || first == '+') && (length == 1 || line[1] == ' ' || line[1] == '\t')) return TRUE;
+
+    size_t i = 0;
+    while (i < length && i < 9 && line[i] >= '0' && line[i] <= '9') i++;
+    return i > 0 && i < length && (line[i] == '.' || line[i] == ')');
+}
+
+// cmark applies link reference definitions to the whole document, also ones inside quotes and list items and ones
+// whose label spans lines, so any line with a "]:" in it counts; a false positive only costs the split
+static Bool MayDefineLinkReference(const char* line, size_t length) {
+    for (const char* close = (const char*) memchr(line, ']', length); close;
+         close = (const char*) memchr(close + 1, ']', line + length - close - 1)) {
+        if (close + 1 < line + length && close[1] == ':') return TRUE;
+    }
+    return FALSE;
+}
+
+void InitTopLevelScanner(TopLevelScanner* scanner) {
+    memset(scanner, 0, sizeof(*scanner));
+    scanner->splittable = TRUE;
+}
+
+// A chunk only ends at a blank line followed by a line that can't continue what came before, outside fenced code.
+// Link reference definitions and HTML blocks reach across blank lines, so a source using them stays one chunk.
+Bool ScanTopLevelLine(TopLevelScanner* scanner, const char* markdown, size_t length) {
+    size_t lineStart = scanner->lineStart;
+    size_t lineEnd = lineStart;
+    while (lineEnd < length && markdown[lineEnd] != '\n' && markdown[lineEnd] != '\r') lineEnd++;
+    const char* line = markdown + lineStart;
+    size_t lineLength = lineEnd - lineStart;
+
+    Bool chunkStart = FALSE;
+    Bool blank = IsBlankLine(line, lineLength);
+    if (scanner->fenceLength == 0 && !blank) {
+        size_t indent = SkipIndent(line, lineLength);
+        if (line[indent] == '<' || MayDefineLinkReference(line, lineLength)) {
+            scanner->splittable = FALSE;
+        } else if (scanner->previousBlank && !MayContinueContainer(line, lineLength) && lineStart > 0) {
+            chunkStart = TRUE;
+        }
+    }
+
+    char lineFenceChar = 0;
+    size_t fenceRunEnd = 0;
+    int lineFence = blank ? 0 : FenceLength(line, lineLength, &lineFenceChar, &fenceRunEnd);
+    if (scanner->fenceLength == 0 && lineFence > 0) {
+        scanner->fenceChar = lineFenceChar;
+        scanner->fenceLength = lineFence;
+    } else if (scanner->fenceLength > 0 && lineFence >= scanner->fenceLength && lineFenceChar == scanner->fenceChar &&
+               IsBlankLine(line + fenceRunEnd, lineLength - fenceRunEnd)) {
+        // a closing fence takes no info string, "```python" inside the block is code
+        scanner->fenceLength = 0;
+    }
+    scanner->previousBlank = blank && scanner->fenceLength == 0;
+
+    // same line endings as cmark: \n, \r\n and a lone \r
+    lineStart = lineEnd;
+    if (lineStart < length && markdown[lineStart] == '\r') {
+        lineStart++;
+        if (lineStart < length && markdown[lineStart] == '\n') lineStart++;
+    } else if (lineStart < length) {
+        lineStart++;
+    }
+    scanner->lineStart = lineStart;
+    return chunkStart;
+}
+
+// Starts of the top-level chunks plus the end of the source
+static int SplitTopLevelBlocks(const char* markdown, size_t length, size_t** outStarts) {
+    size_t* starts;
+    DYNARRAY_INIT(starts, 16);
+    DYNARRAY_PUSHBACK(starts, 0);
+
+    TopLevelScanner scanner;
+    InitTopLevelScanner(&scanner);
+    while (scanner.lineStart < length && scanner.splittable) {
+        size_t lineStart = scanner.lineStart;
+        if (ScanTopLevelLine(&scanner, markdown, length)) {
+            DYNARRAY_PUSHBACK(starts, lineStart);
+        }
+    }
+
+    if (!scanner.splittable) {
+        // forget the chunks found before the line that ruled splitting out
+        starts_count = 1;
+    }
+    DYNARRAY_PUSHBACK(starts, length);
+
+    *outStarts = starts;
+    return DYNARRAY_SIZE(starts) - 1;
+}
+
+static MarkdownBlock* FindReusableBlock(MarkdownDocument* previous, uint64_t hash, size_t length, int* searchFrom) {
+    // blocks mostly stay in order, so look after the last match first
+    for (int n = 0; n < previous->blockCount; n++) {
+        int b = (*searchFrom + n) % previous->blockCount;
+        MarkdownBlock* block = &previous->blocks[b];
+        if (block->document.ownedSource && block->hash == hash && block->document.sourceLength == length) {
+            *searchFrom = b + 1;
+            return block;
+        }
+    }
+    return NULL;
+}
+
+static MarkdownBlock ParseBlockCopy(const char* chunk, size_t length, uint64_t hash) {
+    char* copy = (char*) malloc(length + 1);
+    memcpy(copy, chunk, length);
+    copy[length] = '\0';
+    return (MarkdownBlock){.hash = hash, .document = AdoptMarkdownDocument(copy, length)};
+}
+
+// Concatenates the blocks' commands, moving every style into one table
+static void MergeMarkdownBlocks(MarkdownDocument* document) {
+    int commandCount = 0;
+    for (int b = 0; b < document->blockCount; b++) {
+        commandCount += document->blocks[b].document.commandCount;
+    }
+
+    StyleTable styleTable = {0};
+    RenderCommand* commands = (RenderCommand*) malloc((commandCount ? commandCount : 1) * sizeof(RenderCommand));
+    uint16_t* styleMap = NULL;
+    int cursor = 0;
+
+    for (int b = 0; b < document->blockCount; b++) {
+        const MarkdownDocument* block = &document->blocks[b].document;
+        styleMap = (uint16_t*) realloc(styleMap, (block->styleCount ? block->styleCount : 1) * sizeof(uint16_t));
+        for (int i = 0; i < block->styleCount; i++) {
+            styleMap[i] = InternResolvedStyle(&styleTable, block->styles[i]);
+        }
+
+        for (int i = 0; i < block->commandCount; i++) {
+            RenderCommand cmd = block->commands[i];
+            if (cmd.type == CMD_TEXT) {
+                cmd.styleId = styleMap[cmd.styleId];
+            }
+            commands[cursor++] = cmd;
+        }
+    }
+    free(styleMap);
+
+    document->commands = commands;
+    document->commandCount = commandCount;
+    document->styles = styleTable.styles;
+    document->styleCount = styleTable.count;
+}
+
+MarkdownDocument ParseMarkdownBlocks(const char* markdown, size_t length, MarkdownDocument* previous, int* outReused) {
+    MarkdownDocument document = {.generation = NextMarkdownDocumentGeneration()};
+    document.sourceLength = length;
+
+    size_t* starts = NULL;
+    int blockCount = SplitTopLevelBlocks(markdown, length, &starts);
+    MarkdownBlock* blocks = (MarkdownBlock*) calloc(blockCount ? blockCount : 1, sizeof(MarkdownBlock));
+
+    int reused = 0;
+    int searchFrom = 0;
+    for (int b = 0; b < blockCount; b++) {
+        const char* chunk = markdown + starts[b];
+        size_t chunkLength = starts[b + 1] - starts[b];
+        uint64_t hash = HashBytes(chunk, chunkLength);
+
+        MarkdownBlock* match = (previous && previous->blocks) ? FindReusableBlock(previous, hash, chunkLength, &searchFrom) : NULL;
+        if (match) {
+            // the commands point into the block's own copy, so they move along with it
+            blocks[b] = *match;
+            memset(match, 0, sizeof(*match));
+            reused++;
+            continue;
+        }
+
+        blocks[b] = ParseBlockCopy(chunk, chunkLength, hash);
+    }
+    free(starts);
+
+    document.blocks = blocks;
+    document.blockCount = blockCount;
+    MergeMarkdownBlocks(&document);
+
+    if (outReused) *outReused = reused;
+    return document;
+}
+
+/* ---------- parallel parsing ---------- */
+
+typedef struct {
+    const char* markdown;
+    const size_t* unitStarts;
+    MarkdownBlock* units;
+    int unitCount;
+    Bool copyText; // units become blocks parsed from their own copy of the text, as ParseMarkdownBlocks makes them
+    atomic_int next;
+} ParallelParseJob;
+
+static void* ParseUnits(void* arg) {
+    ParallelParseJob* job = (ParallelParseJob*) arg;
+    for (int u = atomic_fetch_add(&job->next, 1); u < job->unitCount; u = atomic_fetch_add(&job->next, 1)) {
+        const char* unit = job->markdown + job->unitStarts[u];
+        size_t length = job->unitStarts[u + 1] - job->unitStarts[u];
+        if (job->copyText) {
+            job->units[u] = ParseBlockCopy(unit, length, HashBytes(unit, length));
+        } else {
+            // slices point straight into the shared source, which the merged document owns
+            job->units[u].document = ParseMarkdownDocument(unit, length);
+        }
+    }
+    return NULL;
+}
+
+static void RunParallelParse(ParallelParseJob* job, int threadCount) {
+    atomic_init(&job->next, 0);
+#ifdef BUROGU_PARALLEL_PARSE
+    // the calling thread takes units too
+    pthread_t threads[MARKDOWN_PARALLEL_MAX_THREADS];
+    int started = 0;
+    for (int t = 1; t < threadCount && t < job->unitCount && t < MARKDOWN_PARALLEL_MAX_THREADS; t++) {
+        if (pthread_create(&threads[started], NULL, ParseUnits, job) == 0) {
+            started++;
+        }
+    }
+    ParseUnits(job);
+    for (int t = 0; t < started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+#else
+    ParseUnits(job);
+#endif
+}
+
+// Groups consecutive chunks into at most wantedUnits runs of about the same size; returns the unit count
+static int GroupChunks(const size_t* chunkStarts, int chunkCount, size_t length, int wantedUnits, size_t* outUnitStarts) {
+    int units = 0;
+    outUnitStarts[units++] = 0;
+    for (int c = 1; c < chunkCount && units < wantedUnits; c++) {
+        if (chunkStarts[c] >= length / wantedUnits * units) {
+            outUnitStarts[units++] = chunkStarts[c];
+        }
+    }
+    outUnitStarts[units] = length;
+    return units;
+}
+
+int GetDefaultParseThreadCount() {
+    int cores = 1;
+#ifdef BUROGU_PARALLEL_PARSE
+#ifdef EMSCRIPTEN
+    cores = emscripten_num_logical_cores();
+#else
+    cores = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+#endif
+    if (cores < 1) return 1;
+    return cores < MARKDOWN_PARALLEL_MAX_THREADS ? cores : MARKDOWN_PARALLEL_MAX_THREADS;
+}
+
+MarkdownDocument AdoptMarkdownDocumentParallel(char* source, size_t length, int threadCount) {
+    if (threadCount > MARKDOWN_PARALLEL_MAX_THREADS) threadCount = MARKDOWN_PARALLEL_MAX_THREADS;
+
+    size_t* chunkStarts = NULL;
+    int chunkCount = length >= MARKDOWN_PARALLEL_MIN_BYTES && threadCount > 1
+                             ? SplitTopLevelBlocks(source, length, &chunkStarts)
+                             : 1;
+    if (chunkCount <= 1) {
+        free(chunkStarts);
+        return AdoptMarkdownDocument(source, length);
+    }
+
+    int wantedUnits = threadCount * MARKDOWN_PARALLEL_UNITS_PER_THREAD;
+    size_t* unitStarts = (size_t*) malloc((wantedUnits + 1) * sizeof(size_t));
+    int unitCount = GroupChunks(chunkStarts, chunkCount, length, wantedUnits, unitStarts);
+    free(chunkStarts);
+
+    ParallelParseJob job = {
+            .markdown = source,
+            .unitStarts = unitStarts,
+            .units = (MarkdownBlock*) calloc(unitCount, sizeof(MarkdownBlock)),
+            .unitCount = unitCount,
+    };
+    RunParallelParse(&job, threadCount);
+    free(unitStarts);
+
+    MarkdownDocument document = {.generation = NextMarkdownDocumentGeneration()};
+    document.blocks = job.units;
+    document.blockCount = unitCount;
+    MergeMarkdownBlocks(&document);
+
+    // units aren't reused like ParseMarkdownBlocks' blocks, only the text they copied has to stay
+    for (int u = 0; u < unitCount; u++) {
+        MarkdownDocument* unit = &document.blocks[u].document;
+        free(unit->commands);
+        free(unit->styles);
+        unit->commands = NULL;
+        unit->styles = NULL;
+        unit->commandCount = 0;
+        unit->styleCount = 0;
+    }
+
+    document.ownedSource = source;
+    document.sourceLength = length;
+    return document;
+}
+
+void AppendMarkdownBlocks(MarkdownDocument* document, const char* markdown, const size_t* starts, int count, int threadCount) {
+    if (count <= 0) return;
+    if (document->generation == 0) {
+        // the first blocks of a document that's built as its text arrives
+        document->generation = NextMarkdownDocumentGeneration();
+    }
+
+    int first = document->blockCount;
+    document->blocks = (MarkdownBlock*) realloc(document->blocks, (first + count) * sizeof(MarkdownBlock));
+
+    // a batch as large as a source worth parsing in parallel is spread over the threads chunk by chunk
+    ParallelParseJob job = {
+            .markdown = markdown,
+            .unitStarts = starts,
+            .units = document->blocks + first,
+            .unitCount = count,
+            .copyText = TRUE,
+    };
+    RunParallelParse(&job, starts[count] - starts[0] >= MARKDOWN_PARALLEL_MIN_BYTES ? threadCount : 1);
+
+    int newCommands = 0;
+    for (int b = first; b < first + count; b++) {
+        newCommands += document->blocks[b].document.commandCount;
+    }
+    document->blockCount += count;
+    document->sourceLength += starts[count] - starts[0];
+
+    // same as MergeMarkdownBlocks, only for the new blocks: styles seen before keep their ids
+    StyleTable styleTable = {
+            .styles = document->styles,
+            .count = document->styleCount,
+            .capacity = document->styleCount,
+    };
+    int commandCapacity = document->commandCount + newCommands;
+    document->commands = (RenderCommand*) realloc(document->commands, (commandCapacity ? commandCapacity : 1) * sizeof(RenderCommand));
+    uint16_t* styleMap = NULL;
+    for (int b = first; b < document->blockCount; b++) {
+        const MarkdownDocument* block = &document->blocks[b].document;
+        styleMap = (uint16_t*) realloc(styleMap, (block->styleCount ? block->styleCount : 1) * sizeof(uint16_t));
+        for (int i = 0; i < block->styleCount; i++) {
+            styleMap[i] = InternResolvedStyle(&styleTable, block->styles[i]);
+        }
+
+        for (int i = 0; i < block->commandCount; i++) {
+            RenderCommand cmd = block->commands[i];
+            if (cmd.type == CMD_TEXT) {
+                cmd.styleId = styleMap[cmd.styleId];
+            }
+            document->commands[document->commandCount++] = cmd;
+        }
+    }
+    free(styleMap);
+    document->styles = styleTable.styles;
+    document->styleCount = styleTable.count;
+}
+
+void FreeMarkdownDocument(MarkdownDocument* document) {
+    for (int b = 0; b < document->blockCount; b++) {
+        FreeMarkdownDocument(&document->blocks[b].document);
+    }
+    free(document->blocks);
+
+    if (!document->commandsInSource) {
+        free(document->commands);
+    }
+    free(document->styles);
+    FreeTextArena(&document->text);
+    free(document->ownedSource);
+    memset(document, 0, sizeof(*document));
+}
+
+size_t GetMarkdownDocumentBytes(const MarkdownDocument* document) {
+    size_t blockBytes = document->blockCount * sizeof(MarkdownBlock);
+    for (int b = 0; b < document->blockCount; b++) {
+        blockBytes += GetMarkdownDocumentBytes(&document->blocks[b].document);
+    }
+
+    return blockBytes + (document->commandsInSource ? 0 : document->commandCount * sizeof(RenderCommand)) +
+           document->styleCount * sizeof(Clay_TextElementConfig) +
+           document->text.bytes +
+           (document->ownedSource ? document->sourceLength + 1 : 0);
+}
+
+int RemapFontId(int normalFontId, Bool bold, Bool italic, Bool mono) {
+    if (mono) {
+        // override all
+        return CODE_FONT_MONOSPACE;
+    }
+
+    if (normalFontId == ZHCN_FONT_NORMAL) {
+        if (bold && italic) {
+            return ZHCN_FONT_NORMAL_BOLD_ITALIC;
+        } else if (bold) {
+            return ZHCN_FONT_NORMAL_BOLD;
+        } else if (italic) {
+            return ZHCN_FONT_NORMAL_ITALIC;
+        } else {
+            return ZHCN_FONT_NORMAL;
+        }
+    } else if (normalFontId == ZHCN_FONT_BIG) {
+        if (bold && italic) {
+            return ZHCN_FONT_BIG_BOLD_ITALIC;
+        } else if (bold) {
+            return ZHCN_FONT_BIG_BOLD;
+        } else if (italic) {
+            return ZHCN_FONT_BIG_ITALIC;
+        } else {
+            return ZHCN_FONT_BIG;
+        }
+    }
+
+    return normalFontId;
+}
+
+static void RenderCommandRange(const MarkdownDocument* document, int begin, int end) {
+    for (int i = begin; i < end; i++) {
+        const RenderCommand* cmd = &document->commands[i];
+
+        if (cmd->type == CMD_BLOCK_OPEN) {
+            Clay_ElementDeclaration decl = {
+                    .id = CLAY_IDI("Block", i),
+                    .layout = {
+                            .sizing = {
+                                    CLAY_SIZING_GROW(),
+                                    CLAY_SIZING_FIT(),
+                            },
+                    },
+            };
+
+            if (cmd->blockType == BT_QUOTE) {
+                decl.layout.layoutDirection = CLAY_TOP_TO_BOTTOM;
+                decl.layout.padding = (Clay_Padding){32, 10, 10, 10};
+                decl.backgroundColor = (Clay_Color){240, 240, 240, 100};
+                decl.border = (Clay_BorderElementConfig){
+                        .width = {
+                                .left = 4,
+                        },
+                        .color = (Clay_Color){200, 200, 200, 255},
+                };
+            } else if (cmd->blockType == BT_CODE) {
+                decl.layout.padding = CLAY_PADDING_ALL(16);
+                decl.backgroundColor = (Clay_Color){30, 32, 35, 255};
+                decl.cornerRadius = CLAY_CORNER_RADIUS(8);
+                decl.border = (Clay_BorderElementConfig){.width = CLAY_BORDER_ALL(1), .color = {60, 60, 60, 255}};
+            } else if (cmd->blockType == BT_PARAGRAPH) {
+                decl.layout.sizing.width = CLAY_SIZING_GROW();
+                // todo: fixme: word wrap not working properly, especially when multiple styles in one paragraph
+                decl.layout.layoutDirection = CLAY_TOP_TO_BOTTOM;
+                decl.layout.childGap = 0;
+            } else if (cmd->blockType == BT_LIST_CONTAINER) {
+                decl.layout.padding = (Clay_Padding){24, 0, 0, 0};
+                decl.layout.layoutDirection = CLAY_TOP_TO_BOTTOM;
+                decl.layout.childGap = 4;
+            } else if (cmd->blockType == BT_LIST_ITEM) {
+                decl.layout.layoutDirection = CLAY_LEFT_TO_RIGHT;
+                decl.layout.sizing.width = CLAY_SIZING_GROW();
+            } else if (cmd->blockType == BT_HR) {
+                Clay_ElementDeclaration decl = {
+                        .id = CLAY_IDI("HR", i),
+                        .layout = {
+                                .sizing = {CLAY_SIZING_GROW(), CLAY_SIZING_FIXED(2)},
+                                .padding = {0, 0, 16, 16},
+                        },
+                        .backgroundColor = {100, 100, 100, 100}};
+                Clay__OpenElement();
+                Clay__ConfigureOpenElement(decl);
+                Clay__CloseElement();
+            }
+
+            Clay__OpenElement();
+            Clay__ConfigureOpenElement(decl);
+        } else if (cmd->type == CMD_TEXT) {
+            // the style table outlives the frame, so clay can keep pointing into it
+            CLAY_TEXT(((Clay_String){.length = cmd->length, .chars = cmd->chars}), &document->styles[cmd->styleId]);
+        } else if (cmd->type == CMD_BLOCK_CLOSE) {
+            Clay__CloseElement();
+        }
+    }
+}
+
+/* ---------- viewport virtualization ---------- */
+
+// One top-level block and the commands it spans, with its laid out height at the cached width
+typedef struct {
+    int firstCommand;
+    int endCommand;
+    uint64_t hash; // of the block's commands, to carry the height over when the document is reparsed
+    float height;
+    Bool measured;
+} TopLevelBlock;
+
+typedef struct {
+    const RenderCommand* commands;
+    int commandCount;
+    const Clay_TextElementConfig* styles;
+
+    TopLevelBlock* blocks;
+    float* blockOffsets; // top of each block relative to the content start, blockCount + 1 entries
+    int blockCount;
+    Bool offsetsDirty;
+
+    float measuredWidth;
+    int firstEmitted; // blocks emitted last frame, read back on the next one
+    int endEmitted;
+
+    // the document this was built for, to tell blocks appended while it streams in from a different document
+    uint32_t generation;
+    int sourceBlockCount;
+    uint64_t sourceBlocksHash;
+} BlockLayoutCache;
+
+static BlockLayoutCache blockLayoutCache;
+
+static float EstimateBlockHeight(const BlockLayoutCache* cache, const TopLevelBlock* block, float contentWidth) {
+    // rough guess used until the block has been laid out once: half an em per byte, wrapped at the content width
+    float height = 0.0f;
+    float runWidth = 0.0f;
+    float lineHeight = 0.0f;
+
+    for (int i = block->firstCommand; i < block->endCommand; i++) {
+        const RenderCommand* cmd = &cache->commands[i];
+        if (cmd->type == CMD_TEXT) {
+            const Clay_TextElementConfig* style = &cache->styles[cmd->styleId];
+            float fontSize = style->fontSize;
+            lineHeight = fmaxf(lineHeight, style->lineHeight);
+            for (int c = 0; c < cmd->length; c++) {
+                if (cmd->chars[c] == '\n') {
+                    height += ceilf(runWidth / contentWidth) * lineHeight;
+                    runWidth = 0.0f;
+                    height += lineHeight;
+                } else {
+                    runWidth += fontSize * 0.5f;
+                }
+            }
+        } else if (cmd->type == CMD_BLOCK_CLOSE) {
+            if (runWidth > 0.0f) {
+                height += fmaxf(1.0f, ceilf(runWidth / contentWidth)) * lineHeight;
+                runWidth = 0.0f;
+            }
+            if (cmd->blockType == BT_QUOTE) height += 20.0f;
+            if (cmd->blockType == BT_CODE) height += 32.0f;
+            if (cmd->blockType == BT_HR) height += 2.0f;
+        }
+    }
+
+    return height;
+}
+
+static uint64_t HashTopLevelBlock(const MarkdownDocument* document, const TopLevelBlock* block) {
+    uint64_t hash = 1469598103934665603ull;
+    for (int i = block->firstCommand; i < block->endCommand; i++) {
+        const RenderCommand* cmd = &document->commands[i];
+        uint64_t parts[4] = {cmd->type, cmd->blockType, 0, 0};
+        if (cmd->type == CMD_TEXT) {
+            const Clay_TextElementConfig* style = &document->styles[cmd->styleId];
+            parts[2] = HashBytes(cmd->chars, cmd->length);
+            parts[3] = ((uint64_t) style->fontId << 32) | ((uint64_t) style->fontSize << 16) | style->lineHeight;
+        }
+        hash = (hash ^ HashBytes(parts, sizeof(parts))) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Blocks at the start and the end of the document that didn't change since the last version keep their heights,
+// so an edit only re-measures what it touched and the scroll position stays put
+static void CarryOverBlockHeights(BlockLayoutCache* cache, const TopLevelBlock* previous, int previousCount) {
+    int prefix = 0;
+    while (prefix < cache->blockCount && prefix < previousCount && cache->blocks[prefix].hash == previous[prefix].hash) {
+        cache->blocks[prefix].height = previous[prefix].height;
+        cache->blocks[prefix].measured = previous[prefix].measured;
+        prefix++;
+    }
+
+    int suffix = 0;
+    while (suffix < cache->blockCount - prefix && suffix < previousCount - prefix &&
+           cache->blocks[cache->blockCount - 1 - suffix].hash == previous[previousCount - 1 - suffix].hash) {
+        cache->blocks[cache->blockCount - 1 - suffix].height = previous[previousCount - 1 - suffix].height;
+        cache->blocks[cache->blockCount - 1 - suffix].measured = previous[previousCount - 1 - suffix].measured;
+        suffix++;
+    }
+}
+
+// Top-level blocks among commands [first, end), which has to start at the top level; returns how many (malloc'd)
+static int FindTopLevelBlocks(const MarkdownDocument* document, int first, int end, TopLevelBlock** outBlocks) {
+    const RenderCommand* commands = document->commands;
+    TopLevelBlock* blocks;
+    DYNARRAY_INIT(blocks, 64);
+
+    int depth = 0;
+    int blockStart = first;
+    for (int i = first; i < end; i++) {
+        if (commands[i].type == CMD_BLOCK_OPEN) {
+            if (depth == 0) blockStart = i;
+            depth++;
+        } else if (commands[i].type == CMD_BLOCK_CLOSE) {
+            depth--;
+        } else if (depth == 0) {
+            blockStart = i;
+        }
+
+        if (depth == 0) {
+            DYNARRAY_PUSHBACK(blocks, ((TopLevelBlock){.firstCommand = blockStart, .endCommand = i + 1}));
+        }
+    }
+
+    for (int b = 0; b < DYNARRAY_SIZE(blocks); b++) {
+        blocks[b].hash = HashTopLevelBlock(document, &blocks[b]);
+    }
+    *outBlocks = blocks;
+    return DYNARRAY_SIZE(blocks);
+}
+
+static uint64_t HashSourceBlocks(const MarkdownDocument* document, int count) {
+    uint64_t hash = 1469598103934665603ull;
+    for (int b = 0; b < count; b++) {
+        hash = (hash ^ document->blocks[b].hash) * 1099511628211ull;
+    }
+    return hash;
+}
+
+static void RememberCachedDocument(const MarkdownDocument* document) {
+    BlockLayoutCache* cache = &blockLayoutCache;
+    cache->generation = document->generation;
+    cache->sourceBlockCount = document->blockCount;
+    cache->sourceBlocksHash = HashSourceBlocks(document, document->blockCount);
+}
+
+static void RebuildBlockLayoutCache(const MarkdownDocument* document) {
+    BlockLayoutCache* cache = &blockLayoutCache;
+    TopLevelBlock* previous = cache->blocks;
+    int previousCount = cache->blockCount;
+    float measuredWidth = cache->measuredWidth;
+    free(cache->blockOffsets);
+    memset(cache, 0, sizeof(*cache));
+
+    cache->commands = document->commands;
+    cache->commandCount = document->commandCount;
+    cache->styles = document->styles;
+    cache->blockCount = FindTopLevelBlocks(document, 0, document->commandCount, &cache->blocks);
+    cache->blockOffsets = (float*) malloc((cache->blockCount + 1) * sizeof(float));
+    cache->offsetsDirty = TRUE;
+    RememberCachedDocument(document);
+
+    if (previous) {
+        // the heights carried over were measured at this width, keep it so they aren't all thrown away
+        CarryOverBlockHeights(cache, previous, previousCount);
+        cache->measuredWidth = measuredWidth;
+        free(previous);
+    }
+}
+
+// A document streaming in only gets blocks appended; it still starts with the blocks the cache was built from
+static Bool IsCachedDocumentExtended(const MarkdownDocument* document) {
+    const BlockLayoutCache* cache = &blockLayoutCache;
+    int seen = cache->sourceBlockCount;
+    return cache->generation == document->generation && seen > 0 && document->blockCount > seen &&
+           document->commandCount > cache->commandCount &&
+           HashSourceBlocks(document, seen) == cache->sourceBlocksHash;
+}
+
+static void ExtendBlockLayoutCache(const MarkdownDocument* document) {
+    // only the new commands are scanned and hashed, the blocks already there keep their heights and offsets
+    BlockLayoutCache* cache = &blockLayoutCache;
+    TopLevelBlock* added = NULL;
+    int addedCount = FindTopLevelBlocks(document, cache->commandCount, document->commandCount, &added);
+
+    cache->blocks = (TopLevelBlock*) realloc(cache->blocks, (cache->blockCount + addedCount) * sizeof(TopLevelBlock));
+    memcpy(cache->blocks + cache->blockCount, added, addedCount * sizeof(TopLevelBlock));
+    free(added);
+    cache->blockCount += addedCount;
+    cache->blockOffsets = (float*) realloc(cache->blockOffsets, (cache->blockCount + 1) * sizeof(float));
+    cache->offsetsDirty = TRUE;
+
+    cache->commands = document->commands;
+    cache->commandCount = document->commandCount;
+    cache->styles = document->styles;
+    RememberCachedDocument(document);
+}
+
+static Clay_BoundingBox GetBlockBounds(const RenderCommand* commands, const TopLevelBlock* block, Bool* outFound) {
+    Clay_ElementData data = Clay_GetElementData(CLAY_IDI("Block", block->firstCommand));
+    *outFound = data.found;
+    if (data.found && commands[block->firstCommand].blockType == BT_HR) {
+        // thematic breaks emit the visible rule as a sibling right before their (empty) block element
+        Clay_ElementData rule = Clay_GetElementData(CLAY_IDI("HR", block->firstCommand));
+        if (rule.found) {
+            data.boundingBox.height += data.boundingBox.y - rule.boundingBox.y;
+            data.boundingBox.y = rule.boundingBox.y;
+        }
+    }
+    return data.boundingBox;
+}
+
+// Returns how much the blocks above anchorY grew, so the caller can keep the visible content in place
+static float ReadBackBlockHeights(float contentWidth, float anchorY) {
+    BlockLayoutCache* cache = &blockLayoutCache;
+    float growthAboveAnchor = 0.0f;
+
+    if (contentWidth > 0.0f && contentWidth != cache->measuredWidth) {
+        // heights at the old width stay in as estimates, but every block gets measured again when it shows up
+        for (int b = 0; b < cache->blockCount; b++) {
+            cache->blocks[b].measured = FALSE;
+        }
+        cache->measuredWidth = contentWidth;
+    }
+
+    for (int b = cache->firstEmitted; b < cache->endEmitted; b++) {
+        TopLevelBlock* block = &cache->blocks[b];
+        Bool found = FALSE;
+        Clay_BoundingBox bounds = GetBlockBounds(cache->commands, block, &found);
+        if (!found) continue;
+
+        if (!block->measured || block->height != bounds.height) {
+            if (!cache->offsetsDirty && cache->blockOffsets[b] + block->height <= anchorY) {
+                growthAboveAnchor += bounds.height - block->height;
+            }
+            block->height = bounds.height;
+            cache->offsetsDirty = TRUE;
+        }
+        block->measured = TRUE;
+    }
+
+    return growthAboveAnchor;
+}
+
+static void UpdateBlockOffsets(float contentWidth) {
+    BlockLayoutCache* cache = &blockLayoutCache;
+    if (!cache->offsetsDirty) return;
+
+    float offset = 0.0f;
+    for (int b = 0; b < cache->blockCount; b++) {
+        TopLevelBlock* block = &cache->blocks[b];
+        if (!block->measured && block->height == 0.0f) {
+            block->height = EstimateBlockHeight(cache, block, contentWidth);
+        }
+        cache->blockOffsets[b] = offset;
+        offset += block->height + MARKDOWN_BLOCK_GAP;
+    }
+    cache->blockOffsets[cache->blockCount] = offset;
+    cache->offsetsDirty = FALSE;
+}
+
+static int FindFirstBlockEndingAfter(float y) {
+    // blocks are sorted by offset, so binary search for the first one whose bottom edge is below y
+    BlockLayoutCache* cache = &blockLayoutCache;
+    int lo = 0;
+    int hi = cache->blockCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cache->blockOffsets[mid] + cache->blocks[mid].height < y) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static void BlockSpacer(int firstBlock, int endBlock) {
+    BlockLayoutCache* cache = &blockLayoutCache;
+    if (firstBlock >= endBlock) return;
+
+    // one fixed-height element stands in for the skipped blocks and the gaps between them
+    float height = cache->blockOffsets[endBlock] - cache->blockOffsets[firstBlock] - MARKDOWN_BLOCK_GAP;
+    CLAY({
+            .id = CLAY_IDI("BlockSpacer", firstBlock),
+            .layout = {
+                    .sizing = {
+                            CLAY_SIZING_GROW(),
+                            CLAY_SIZING_FIXED(height),
+                    },
+            },
+    }) {}
+}
+
+void MarkdownRenderer(const MarkdownDocument* document) {
+    BlockLayoutCache* cache = &blockLayoutCache;
+    if (cache->commandCount != document->commandCount && IsCachedDocumentExtended(document)) {
+        ExtendBlockLayoutCache(document);
+    } else if (cache->generation != document->generation || cache->commands != document->commands ||
+               cache->commandCount != document->commandCount) {
+        RebuildBlockLayoutCache(document);
+    }
+
+    // everything below reads clay's results from the previous frame
+    Clay_ScrollContainerData scrollData = Clay_GetScrollContainerData(CLAY_ID("MainContent"));
+    Clay_ElementData contentData = Clay_GetElementData(CLAY_ID("MainContent"));
+
+    float viewportHeight = MARKDOWN_FALLBACK_VIEWPORT_HEIGHT;
+    float scrollY = 0.0f;
+    if (scrollData.found && scrollData.scrollPosition) {
+        viewportHeight = scrollData.scrollContainerDimensions.height;
+        scrollY = -scrollData.scrollPosition->y;
+    }
+
+    float contentWidth = contentData.found ? contentData.boundingBox.width - 2 * MARKDOWN_CONTENT_PADDING : 0.0f;
+    float growthAboveViewport = ReadBackBlockHeights(contentWidth, scrollY - MARKDOWN_CONTENT_PADDING);
+    UpdateBlockOffsets(contentWidth > 0.0f ? contentWidth : MARKDOWN_FALLBACK_VIEWPORT_WIDTH);
+
+    if (growthAboveViewport != 0.0f && scrollY > 0.0f) {
+        // estimates above the viewport were replaced by real heights: scroll along so the visible text doesn't jump
+        scrollY = fmaxf(0.0f, scrollY + growthAboveViewport);
+        scrollData.scrollPosition->y = -scrollY;
+    }
+
+    float visibleTop = scrollY - MARKDOWN_CONTENT_PADDING - viewportHeight * MARKDOWN_VIRTUALIZATION_MARGIN;
+    float visibleBottom = scrollY - MARKDOWN_CONTENT_PADDING + viewportHeight * (1.0f + MARKDOWN_VIRTUALIZATION_MARGIN);
+
+    int firstVisible = FindFirstBlockEndingAfter(visibleTop);
+    int endVisible = firstVisible;
+    while (endVisible < cache->blockCount && cache->blockOffsets[endVisible] <= visibleBottom) {
+        endVisible++;
+    }
+    cache->firstEmitted = firstVisible;
+    cache->endEmitted = endVisible;
+
+    CLAY({
+            .id = CLAY_ID("MainContent"),
+            .layout = {
+                    .layoutDirection = CLAY_TOP_TO_BOTTOM,
+                    .sizing = {
+                            CLAY_SIZING_GROW(),
+                            CLAY_SIZING_FIT(),
+                    },
+                    .padding = CLAY_PADDING_ALL(MARKDOWN_CONTENT_PADDING),
+                    .childGap = MARKDOWN_BLOCK_GAP,
+            },
+            .clip = {
+                    .vertical = TRUE,
+                    .childOffset = Clay_GetScrollOffset(),
+            },
+    }) {
+        BlockSpacer(0, firstVisible);
+        for (int b = firstVisible; b < endVisible; b++) {
+            RenderCommandRange(document, cache->blocks[b].firstCommand, cache->blocks[b].endCommand);
+        }
+        BlockSpacer(endVisible, cache->blockCount);
+    }
+}
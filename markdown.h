@@ -0,0 +1,159 @@
+#pragma once
+
+#include <clay.h>
+
+#include <stdint.h>
+
+#include "util.h"
+
+typedef struct {
+    int h1;
+    int h2;
+    int h3;
+    int body;
+    int small;
+} FontSizes;
+
+extern const FontSizes fontSizes;
+
+#define ZHCN_FONT_NORMAL 0
+#define ZHCN_FONT_BIG 1
+
+#define ZHCN_FONT_NORMAL_BOLD 2
+#define ZHCN_FONT_NORMAL_ITALIC 3
+#define ZHCN_FONT_NORMAL_BOLD_ITALIC 4
+
+#define ZHCN_FONT_BIG_BOLD 5
+#define ZHCN_FONT_BIG_ITALIC 6
+#define ZHCN_FONT_BIG_BOLD_ITALIC 7
+
+#define CODE_FONT_MONOSPACE 8
+
+typedef struct {
+    Bool bold;
+    Bool italic;
+    Bool underline;
+    Bool strikethrough;
+
+    Bool monospace;
+} TextState;
+
+typedef enum {
+    CMD_BLOCK_OPEN,
+    CMD_TEXT,
+    CMD_BLOCK_CLOSE,
+} CommandType;
+
+typedef enum {
+    BT_NONE,
+    BT_HEADING,
+    BT_QUOTE,
+    BT_CODE,
+    BT_PARAGRAPH,
+
+    BT_LIST_CONTAINER,
+    BT_LIST_ITEM,
+
+    BT_HR,
+} BlockType;
+
+typedef struct TextArenaChunk TextArenaChunk;
+
+// Growable storage for strings that have to be copied, freed all at once
+typedef struct {
+    TextArenaChunk* head;
+    size_t bytes;
+} TextArena;
+
+// Text commands point at a style in the document's style table instead of carrying their own config
+typedef struct {
+    uint8_t type;      // CommandType
+    uint8_t blockType; // BlockType
+    uint16_t styleId;
+    int32_t length;
+    const char* chars;
+} RenderCommand;
+
+// Style ids are 16 bit; anything past this shares the last slot
+#define MARKDOWN_MAX_STYLES 65536
+
+typedef struct MarkdownBlock MarkdownBlock;
+
+typedef struct {
+    RenderCommand* commands;
+    int commandCount;
+
+    // fully resolved text configs (font variant, line height, wrap mode), referenced by RenderCommand.styleId
+    Clay_TextElementConfig* styles;
+    int styleCount;
+
+    // literals that don't appear verbatim in the source
+    TextArena text;
+    // set when the document was adopted from its source buffer, freed along with it
+    char* ownedSource;
+    size_t sourceLength;
+    // commands live inside ownedSource (binary documents loaded in place) rather than in their own allocation
+    Bool commandsInSource;
+
+    // documents parsed block by block own their blocks; commands and styles above are the blocks' merged together
+    MarkdownBlock* blocks;
+    int blockCount;
+
+    // unique per parsed or loaded document (kept when blocks are appended), so layout caches can tell a new document
+    // from an old one even when it reuses the old one's freed buffers
+    uint32_t generation;
+} MarkdownDocument;
+
+// A top-level chunk of the source (blocks between blank lines), parsed on its own from a copy of its text
+struct MarkdownBlock {
+    uint64_t hash; // of the chunk's text
+    MarkdownDocument document;
+};
+
+typedef struct {
+    Clay_TextElementConfig config;
+    TextState state;
+} StyleFrame;
+
+Clay_String AllocateStringInArena(TextArena* arena, const char* str);
+void FreeTextArena(TextArena* arena);
+
+// Text commands may point straight into markdown, so it has to outlive the document.
+// On failure the returned document has no commands.
+MarkdownDocument ParseMarkdownDocument(const char* markdown, size_t length);
+// Same, but the document takes ownership of a malloc'd source and frees it with itself
+MarkdownDocument AdoptMarkdownDocument(char* source, size_t length);
+// Splits the source into top-level blocks and parses each on its own, copying its text, so the source can be freed.
+// Blocks with the same text as one of previous' (may be NULL) are moved over rather than parsed again, which leaves
+// previous to be freed afterwards; outReused (may be NULL) says how many were.
+MarkdownDocument ParseMarkdownBlocks(const char* markdown, size_t length, MarkdownDocument* previous, int* outReused);
+// Same document as AdoptMarkdownDocument, but the source is cut into top-level chunks that are parsed on up to
+// threadCount threads (one without BUROGU_PARALLEL_PARSE) and merged. Small sources are parsed in one go.
+MarkdownDocument AdoptMarkdownDocumentParallel(char* source, size_t length, int threadCount);
+// Logical cores, capped; 1 without BUROGU_PARALLEL_PARSE
+int GetDefaultParseThreadCount();
+// Finds the top-level chunks ParseMarkdownBlocks parses on their own, a line at a time, so text that is still
+// arriving can be split as it comes in
+typedef struct {
+    size_t lineStart; // next line to look at
+    Bool previousBlank;
+    char fenceChar;
+    int fenceLength; // open fence, 0 outside code
+    Bool splittable; // cleared by link reference definitions and HTML blocks, the source is one chunk then
+} TopLevelScanner;
+
+void InitTopLevelScanner(TopLevelScanner* scanner);
+// Moves past the line at scanner->lineStart, which has to end with its line break inside length unless length is the
+// end of the source; TRUE if a new chunk starts on it
+Bool ScanTopLevelLine(TopLevelScanner* scanner, const char* markdown, size_t length);
+// Parses count more chunks (starts[0] .. starts[count] in markdown) as blocks of a document built block by block,
+// appending their commands; styles already in the document keep their ids. Large batches are parsed on up to
+// threadCount threads.
+void AppendMarkdownBlocks(MarkdownDocument* document, const char* markdown, const size_t* starts, int count, int threadCount);
+void FreeMarkdownDocument(MarkdownDocument* document);
+// For documents built outside the parser (binary documents)
+uint32_t NextMarkdownDocumentGeneration();
+// Heap memory held by the document, for cache budgets
+size_t GetMarkdownDocumentBytes(const MarkdownDocument* document);
+int RemapFontId(int normalFontId, Bool bold, Bool italic, Bool mono);
+void MarkdownRenderer(const MarkdownDocument* document);
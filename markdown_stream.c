@@ -0,0 +1,92 @@
+#include "markdown_stream.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void InitMarkdownStream(MarkdownStream* stream, size_t expectedLength, int threadCount) {
+    memset(stream, 0, sizeof(*stream));
+    stream->threadCount = threadCount;
+    InitPreprocessor(&stream->preprocessor, expectedLength);
+    InitTopLevelScanner(&stream->scanner);
+}
+
+// Scans the lines up to end and parses the chunks that are known to be complete; returns how many
+static int ScanAndAppend(MarkdownStream* stream, size_t end, Bool final) {
+    const char* text = stream->preprocessor.output;
+    size_t* starts;
+    DYNARRAY_INIT(starts, 16);
+    DYNARRAY_PUSHBACK(starts, stream->parsedLength);
+
+    while (stream->scanner.lineStart < end && stream->scanner.splittable) {
+        size_t lineStart = stream->scanner.lineStart;
+        if (ScanTopLevelLine(&stream->scanner, text, end)) {
+            // a new chunk starting proves the one before it can't grow any more
+            DYNARRAY_PUSHBACK(starts, lineStart);
+        }
+    }
+    if (final) {
+        DYNARRAY_PUSHBACK(starts, end);
+    }
+
+    // relative to the text handed over
+    int count = DYNARRAY_SIZE(starts) - 1;
+    for (int i = DYNARRAY_SIZE(starts) - 1; i >= 0; i--) {
+        starts[i] -= stream->parsedLength;
+    }
+    if (count > 0) {
+        AppendMarkdownBlocks(&stream->document, text + stream->parsedLength, starts, count, stream->threadCount);
+        stream->parsedLength += starts[count];
+    }
+    free(starts);
+    return count;
+}
+
+int FeedMarkdownStream(MarkdownStream* stream, const char* bytes, size_t length) {
+    FeedPreprocessor(&stream->preprocessor, bytes, length);
+    if (!stream->scanner.splittable) {
+        // one chunk, parsed once it's all there
+        return 0;
+    }
+
+    // only whole lines are looked at: "1" could still turn into "1." and continue a list, and a \r at the very end
+    // could be the first half of \r\n
+    const char* text = stream->preprocessor.output;
+    size_t available = stream->preprocessor.length;
+    size_t from = stream->searchedLength > stream->scanner.lineStart ? stream->searchedLength : stream->scanner.lineStart;
+    size_t end = available;
+    while (end > from && !(text[end - 1] == '\n' || (text[end - 1] == '\r' && end < available))) end--;
+    stream->searchedLength = available > 0 && text[available - 1] == '\r' ? available - 1 : available;
+
+    return end > from ? ScanAndAppend(stream, end, FALSE) : 0;
+}
+
+MarkdownDocument FinishMarkdownStream(MarkdownStream* stream) {
+    size_t length = 0;
+    char* text = FinishPreprocessor(&stream->preprocessor, &length);
+    stream->preprocessor.output = text;
+
+    if (stream->scanner.splittable) {
+        ScanAndAppend(stream, length, TRUE);
+    }
+
+    MarkdownDocument document;
+    if (!stream->scanner.splittable) {
+        // a link reference definition or HTML block further down can reach back into blocks already parsed; the
+        // whole text is parsed again the way a load that isn't streamed would be, and the document adopts it
+        FreeMarkdownDocument(&stream->document);
+        document = AdoptMarkdownDocumentParallel(text, length, stream->threadCount);
+    } else {
+        document = stream->document;
+        free(text);
+    }
+
+    memset(stream, 0, sizeof(*stream));
+    return document;
+}
+
+void AbortMarkdownStream(MarkdownStream* stream) {
+    size_t length = 0;
+    free(FinishPreprocessor(&stream->preprocessor, &length));
+    FreeMarkdownDocument(&stream->document);
+    memset(stream, 0, sizeof(*stream));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "markdown.h"
+#include "preprocess.h"
+#include "util.h"
+
+// Parses a post while it downloads: raw bytes go through the preprocessor, and every top-level chunk is parsed and
+// appended to the document as soon as the text after it shows it can't grow any more. The result is the same
+// document ParseMarkdownBlocks builds from the whole text, or, for a source that can't be split, the one
+// AdoptMarkdownDocumentParallel does.
+typedef struct {
+    Preprocessor preprocessor;
+    TopLevelScanner scanner; // over the preprocessed text, kept between feeds so each line is looked at once
+    size_t searchedLength;   // preprocessed bytes already searched for the last line break
+    size_t parsedLength;     // preprocessed bytes already turned into blocks, always at a chunk boundary
+    int threadCount;         // for large batches of chunks and the final parse
+    MarkdownDocument document;
+} MarkdownStream;
+
+void InitMarkdownStream(MarkdownStream* stream, size_t expectedLength, int threadCount);
+// Returns how many blocks were appended to stream->document; its commands may have moved either way
+int FeedMarkdownStream(MarkdownStream* stream, const char* bytes, size_t length);
+// Parses what is left and hands the finished document over, leaving the stream empty
+MarkdownDocument FinishMarkdownStream(MarkdownStream* stream);
+void AbortMarkdownStream(MarkdownStream* stream);
@@ -0,0 +1,140 @@
+#include "measure_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MEASURE_CACHE_NONE (-1)
+
+static int32_t* FindBucket(MeasureCache* cache, uint64_t hash) {
+    return &cache->buckets[(hash ^ (hash >> 17)) & (uint64_t) cache->bucketMask];
+}
+
+static Bool KeysEqual(const MeasureCacheKey* a, const MeasureCacheKey* b) {
+    return a->hash == b->hash && a->length == b->length && a->fontId == b->fontId &&
+           a->fontSize == b->fontSize && a->letterSpacing == b->letterSpacing;
+}
+
+static void UnlinkLru(MeasureCache* cache, int32_t index) {
+    MeasureCacheEntry* entry = &cache->entries[index];
+    if (entry->lruPrev != MEASURE_CACHE_NONE) {
+        cache->entries[entry->lruPrev].lruNext = entry->lruNext;
+    } else {
+        cache->lruHead = entry->lruNext;
+    }
+    if (entry->lruNext != MEASURE_CACHE_NONE) {
+        cache->entries[entry->lruNext].lruPrev = entry->lruPrev;
+    } else {
+        cache->lruTail = entry->lruPrev;
+    }
+}
+
+static void PushLruFront(MeasureCache* cache, int32_t index) {
+    MeasureCacheEntry* entry = &cache->entries[index];
+    entry->lruPrev = MEASURE_CACHE_NONE;
+    entry->lruNext = cache->lruHead;
+    if (cache->lruHead != MEASURE_CACHE_NONE) {
+        cache->entries[cache->lruHead].lruPrev = index;
+    }
+    cache->lruHead = index;
+    if (cache->lruTail == MEASURE_CACHE_NONE) {
+        cache->lruTail = index;
+    }
+}
+
+static void UnlinkBucket(MeasureCache* cache, int32_t index) {
+    int32_t* link = FindBucket(cache, cache->entries[index].key.hash);
+    while (*link != MEASURE_CACHE_NONE) {
+        if (*link == index) {
+            *link = cache->entries[index].nextInBucket;
+            return;
+        }
+        link = &cache->entries[*link].nextInBucket;
+    }
+}
+
+void InitMeasureCache(MeasureCache* cache, int capacity) {
+    memset(cache, 0, sizeof(*cache));
+    if (capacity < 16) capacity = 16;
+
+    int bucketCount = 16;
+    while (bucketCount < capacity * 2) bucketCount <<= 1;
+
+    cache->entries = (MeasureCacheEntry*) malloc(capacity * sizeof(MeasureCacheEntry));
+    cache->buckets = (int32_t*) malloc(bucketCount * sizeof(int32_t));
+    cache->capacity = capacity;
+    cache->bucketMask = bucketCount - 1;
+
+    ClearMeasureCache(cache);
+}
+
+void FreeMeasureCache(MeasureCache* cache) {
+    free(cache->entries);
+    free(cache->buckets);
+    memset(cache, 0, sizeof(*cache));
+}
+
+void ClearMeasureCache(MeasureCache* cache) {
+    for (int i = 0; i <= cache->bucketMask; i++) {
+        cache->buckets[i] = MEASURE_CACHE_NONE;
+    }
+    cache->count = 0;
+    cache->lruHead = MEASURE_CACHE_NONE;
+    cache->lruTail = MEASURE_CACHE_NONE;
+}
+
+Bool FindCachedTextWidth(MeasureCache* cache, const MeasureCacheKey* key, float* outWidth) {
+    int32_t index = *FindBucket(cache, key->hash);
+    while (index != MEASURE_CACHE_NONE) {
+        MeasureCacheEntry* entry = &cache->entries[index];
+        if (KeysEqual(&entry->key, key)) {
+            if (cache->lruHead != index) {
+                UnlinkLru(cache, index);
+                PushLruFront(cache, index);
+            }
+            *outWidth = entry->width;
+            cache->hits++;
+            return TRUE;
+        }
+        index = entry->nextInBucket;
+    }
+
+    cache->misses++;
+    return FALSE;
+}
+
+void CacheTextWidth(MeasureCache* cache, const MeasureCacheKey* key, float width) {
+    int32_t index;
+    if (cache->count < cache->capacity) {
+        index = cache->count++;
+    } else {
+        index = cache->lruTail;
+        UnlinkLru(cache, index);
+        UnlinkBucket(cache, index);
+        cache->evictions++;
+    }
+
+    MeasureCacheEntry* entry = &cache->entries[index];
+    int32_t* bucket = FindBucket(cache, key->hash);
+    entry->key = *key;
+    entry->width = width;
+    entry->nextInBucket = *bucket;
+    *bucket = index;
+
+    PushLruFront(cache, index);
+}
+
+MeasureCacheStats GetMeasureCacheStats(const MeasureCache* cache) {
+    return (MeasureCacheStats){
+            .hits = cache->hits,
+            .misses = cache->misses,
+            .evictions = cache->evictions,
+            .entryCount = cache->count,
+            .capacity = cache->capacity,
+    };
+}
+
+void ResetMeasureCacheStats(MeasureCache* cache) {
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+}
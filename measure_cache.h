@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "util.h"
+
+// Default number of measured strings kept across frames and documents (~40 bytes each)
+#define MEASURE_CACHE_DEFAULT_CAPACITY 16384
+
+typedef struct {
+    uint64_t hash;
+    int32_t length;
+    uint16_t fontId;
+    uint16_t fontSize;
+    uint16_t letterSpacing;
+} MeasureCacheKey;
+
+typedef struct {
+    MeasureCacheKey key;
+    float width;
+    int32_t nextInBucket;
+    int32_t lruPrev;
+    int32_t lruNext;
+} MeasureCacheEntry;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    int entryCount;
+    int capacity;
+} MeasureCacheStats;
+
+typedef struct {
+    MeasureCacheEntry* entries;
+    int32_t* buckets;
+    int capacity;
+    int bucketMask;
+    int count;
+    int32_t lruHead; // most recently used
+    int32_t lruTail; // next to be evicted
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+} MeasureCache;
+
+void InitMeasureCache(MeasureCache* cache, int capacity);
+void FreeMeasureCache(MeasureCache* cache);
+// Drops every entry but keeps the counters, e.g. after the fonts were reloaded
+void ClearMeasureCache(MeasureCache* cache);
+
+Bool FindCachedTextWidth(MeasureCache* cache, const MeasureCacheKey* key, float* outWidth);
+void CacheTextWidth(MeasureCache* cache, const MeasureCacheKey* key, float width);
+
+MeasureCacheStats GetMeasureCacheStats(const MeasureCache* cache);
+void ResetMeasureCacheStats(MeasureCache* cache);
@@ -1,33 +1,3 @@
-Module['Burogu_Preprocess'] = function(text, threshold = 10) {
-    if (!text) return "";
-
-    text = text.replace(/([，。！？；：」』）》])(?![ \u200B])/g, "$1 ");
-    text = text.replace(/([\u4e00-\u9fa5])([a-zA-Z0-9])/g, "$1 $2");
-    text = text.replace(/([a-zA-Z0-9])([\u4e00-\u9fa5])/g, "$1 $2");
-
-    const words = text.split(' ');
-    const processedWords = words.map(word => {
-        if (word.length <= threshold) return word;
-
-        let result = "";
-        let currentChunkLength = 0;
-
-        for (const char of word) {
-            result += char;
-            const isFullWidth = char.charCodeAt(0) > 255;
-            currentChunkLength += isFullWidth ? 1 : 0.5;
-
-            if (currentChunkLength >= threshold) {
-                result += " ";
-                currentChunkLength = 0;
-            }
-        }
-        return result;
-    });
-
-    return processedWords.join(' ');
-};
-
 Module['Burogu_SafeAllocateUTF8'] = function(str) {
     if (!str) return 0;
 
@@ -47,29 +17,75 @@ Module['Burogu_SafeAllocateUTF8'] = function(str) {
     return ptr;
 };
 
-// mount the glyph range file to the virtual FS before the main module runs
-Module['Burogu_PreloadGlyphRange'] = function() {
-    return fetch('markdown/glyph_range.txt')
-            .then(res => res.arrayBuffer())
+// 2d context for glyph work, one canvas per size, cleared and set up for the given font at the given pixel scale
+Module['Burogu_GlyphContext'] = function(size, name, fontSize, weight, style, scale) {
+    Module.Burogu_glyphCanvases = Module.Burogu_glyphCanvases || {};
+    let ctx = Module.Burogu_glyphCanvases[size];
+    if (!ctx) {
+        const canvas = document.createElement('canvas');
+        canvas.width = size;
+        canvas.height = size;
+        ctx = canvas.getContext('2d', {willReadFrequently: true});
+        Module.Burogu_glyphCanvases[size] = ctx;
+    }
+
+    ctx.setTransform(1, 0, 0, 1, 0, 0);
+    ctx.clearRect(0, 0, size, size);
+    ctx.setTransform(scale, 0, 0, scale, 0, 0);
+
+    // assigning ctx.font reparses it, skip that when nothing changed
+    const font = `${style} ${weight} ${fontSize}px ${name}`;
+    if (ctx.Burogu_font !== font) {
+        ctx.font = font;
+        ctx.Burogu_font = font;
+    }
+    ctx.textBaseline = "alphabetic";
+    ctx.fillStyle = "white";
+    return ctx;
+};
+
+// ink box of one glyph in logical pixels, with a pixel of slack on each side
+Module['Burogu_MeasureGlyph'] = function(ctx, text, fontSize) {
+    const metrics = ctx.measureText(text);
+
+    const ascent = Math.ceil(metrics.actualBoundingBoxAscent) || fontSize;
+    const descent = Math.ceil(metrics.actualBoundingBoxDescent) || 0;
+    const bleedLeft = Math.ceil(Math.abs(metrics.actualBoundingBoxLeft)) || 0;
+
+    return {
+        ascent: ascent,
+        bleedLeft: bleedLeft,
+        width: Math.ceil(metrics.width + bleedLeft + (metrics.actualBoundingBoxRight - metrics.width)) + 2,
+        height: ascent + descent + 2,
+        advance: metrics.width,
+    };
+};
+
+// baked font atlases are optional, without them every glyph is rasterized on a canvas as it's first drawn
+Module['Burogu_PreloadFontBundle'] = function() {
+    return fetch('markdown/fonts.bundle')
+            .then(res => res.ok ? res.arrayBuffer() : null)
             .then(buffer => {
+                if (!buffer) {
+                    console.log("No font bundle, glyphs will come from the canvas");
+                    return;
+                }
                 try {
                     FS.mkdir('/markdown');
                 } catch (e) {}
-                FS.writeFile('/markdown/glyph_range.txt', new Uint8Array(buffer));
-                console.log("Glyph range preloaded to FS");
+                FS.writeFile('/markdown/fonts.bundle', new Uint8Array(buffer));
+                console.log("Font bundle preloaded to FS");
+            })
+            .catch(err => {
+                console.warn("Failed to preload font bundle:", err);
             });
 };
 
 Module['onRuntimeInitialized'] = function() {
     console.log("Wasm runtime ready, starting preloads...");
 
-    Module.Burogu_PreloadGlyphRange()
-            .then(
-                    () => {
-                        console.log("Glyph range preloaded.");
-                        callMain();
-                    })
-            .catch(err => {
-                console.error("Failed to preload glyph range:", err);
+    Module.Burogu_PreloadFontBundle()
+            .then(() => {
+                callMain();
             });
 };
\ No newline at end of file
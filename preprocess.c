@@ -0,0 +1,288 @@
+#include "preprocess.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define PREPROCESS_BLOCK_SIZE 16
+#define PREPROCESS_REPLACEMENT 0xFFFD
+
+static void Reserve(Preprocessor* pre, size_t extra) {
+    if (pre->length + extra + 1 <= pre->capacity) {
+        return;
+    }
+    size_t capacity = pre->capacity ? pre->capacity : 64;
+    while (pre->length + extra + 1 > capacity) {
+        capacity *= 2;
+    }
+    pre->output = (char*) realloc(pre->output, capacity);
+    pre->capacity = capacity;
+}
+
+static void EmitByte(Preprocessor* pre, char byte) {
+    Reserve(pre, 1);
+    pre->output[pre->length++] = byte;
+}
+
+static void EmitCodepoint(Preprocessor* pre, uint32_t c) {
+    Reserve(pre, 4);
+    char* out = &pre->output[pre->length];
+    if (c < 0x80) {
+        out[0] = (char) c;
+        pre->length += 1;
+    } else if (c < 0x800) {
+        out[0] = (char) (0xC0 | (c >> 6));
+        out[1] = (char) (0x80 | (c & 0x3F));
+        pre->length += 2;
+    } else if (c < 0x10000) {
+        out[0] = (char) (0xE0 | (c >> 12));
+        out[1] = (char) (0x80 | ((c >> 6) & 0x3F));
+        out[2] = (char) (0x80 | (c & 0x3F));
+        pre->length += 3;
+    } else {
+        out[0] = (char) (0xF0 | (c >> 18));
+        out[1] = (char) (0x80 | ((c >> 12) & 0x3F));
+        out[2] = (char) (0x80 | ((c >> 6) & 0x3F));
+        out[3] = (char) (0x80 | (c & 0x3F));
+        pre->length += 4;
+    }
+}
+
+static Bool IsSpacedPunctuation(int32_t c) {
+    // ，。！？；：」』）》
+    return c == 0xFF0C || c == 0x3002 || c == 0xFF01 || c == 0xFF1F || c == 0xFF1B ||
+           c == 0xFF1A || c == 0x300D || c == 0x300F || c == 0xFF09 || c == 0x300B;
+}
+
+static Bool IsIdeograph(int32_t c) {
+    return c >= 0x4E00 && c <= 0x9FA5;
+}
+
+static Bool IsAsciiAlnum(int32_t c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+}
+
+// Second stage: split on ' ' and break up long words
+static void ChunkCodepoint(Preprocessor* pre, uint32_t c) {
+    if (c == ' ') {
+        // a break right at the end of a word that turned out to be exactly threshold long never happened
+        pre->pendingBreak = FALSE;
+        pre->wordUnits = 0;
+        pre->chunkHalves = 0;
+        EmitByte(pre, ' ');
+        return;
+    }
+
+    if (pre->pendingBreak) {
+        pre->pendingBreak = FALSE;
+        EmitByte(pre, ' ');
+    }
+
+    EmitCodepoint(pre, c);
+    pre->wordUnits += c > 0xFFFF ? 2 : 1;
+    pre->chunkHalves += c > 0xFF ? 2 : 1;
+
+    if (pre->chunkHalves >= PREPROCESS_WORD_THRESHOLD * 2) {
+        pre->chunkHalves = 0;
+        if (pre->wordUnits > PREPROCESS_WORD_THRESHOLD) {
+            EmitByte(pre, ' ');
+        } else {
+            // only a long word gets broken, and this one might still end here
+            pre->pendingBreak = TRUE;
+        }
+    }
+}
+
+// First stage: spacing around punctuation and between CJK and latin
+static void SpaceCodepoint(Preprocessor* pre, uint32_t c) {
+    int32_t previous = pre->previous;
+    pre->previous = (int32_t) c;
+
+    if (!pre->started) {
+        pre->started = TRUE;
+        if (c == 0xFEFF) {
+            // the BOM isn't part of the text, TextDecoder drops it too
+            pre->previous = -1;
+            return;
+        }
+    }
+
+    if ((IsSpacedPunctuation(previous) && c != ' ' && c != 0x200B) ||
+        (IsIdeograph(previous) && IsAsciiAlnum((int32_t) c)) ||
+        (IsAsciiAlnum(previous) && IsIdeograph((int32_t) c))) {
+        ChunkCodepoint(pre, ' ');
+    }
+    ChunkCodepoint(pre, c);
+}
+
+// WHATWG utf-8 decode step, so malformed input turns into the same replacement characters as in the browser
+static void DecodeByte(Preprocessor* pre, uint8_t byte) {
+    if (pre->bytesNeeded == 0) {
+        if (byte < 0x80) {
+            SpaceCodepoint(pre, byte);
+        } else if (byte >= 0xC2 && byte <= 0xDF) {
+            pre->bytesNeeded = 1;
+            pre->codepoint = byte & 0x1F;
+        } else if (byte >= 0xE0 && byte <= 0xEF) {
+            if (byte == 0xE0) pre->lowerBoundary = 0xA0;
+            if (byte == 0xED) pre->upperBoundary = 0x9F;
+            pre->bytesNeeded = 2;
+            pre->codepoint = byte & 0xF;
+        } else if (byte >= 0xF0 && byte <= 0xF4) {
+            if (byte == 0xF0) pre->lowerBoundary = 0x90;
+            if (byte == 0xF4) pre->upperBoundary = 0x8F;
+            pre->bytesNeeded = 3;
+            pre->codepoint = byte & 0x7;
+        } else {
+            SpaceCodepoint(pre, PREPROCESS_REPLACEMENT);
+        }
+        return;
+    }
+
+    if (byte < pre->lowerBoundary || byte > pre->upperBoundary) {
+        // the broken sequence becomes one replacement character and this byte starts over
+        pre->codepoint = 0;
+        pre->bytesNeeded = 0;
+        pre->bytesSeen = 0;
+        pre->lowerBoundary = 0x80;
+        pre->upperBoundary = 0xBF;
+        SpaceCodepoint(pre, PREPROCESS_REPLACEMENT);
+        DecodeByte(pre, byte);
+        return;
+    }
+
+    pre->lowerBoundary = 0x80;
+    pre->upperBoundary = 0xBF;
+    pre->codepoint = (pre->codepoint << 6) | (byte & 0x3F);
+    if (++pre->bytesSeen == pre->bytesNeeded) {
+        uint32_t c = pre->codepoint;
+        pre->codepoint = 0;
+        pre->bytesNeeded = 0;
+        pre->bytesSeen = 0;
+        SpaceCodepoint(pre, c);
+    }
+}
+
+// Bit i set for every byte that is >= 0x80, and for every space, in a 16 byte block
+static void ScanBlock(const uint8_t* block, unsigned int* outHighMask, unsigned int* outSpaceMask) {
+#if defined(__wasm_simd128__)
+    v128_t bytes = wasm_v128_load(block);
+    *outHighMask = wasm_i8x16_bitmask(bytes);
+    *outSpaceMask = wasm_i8x16_bitmask(wasm_i8x16_eq(bytes, wasm_i8x16_splat(' ')));
+#elif defined(__SSE2__)
+    __m128i bytes = _mm_loadu_si128((const __m128i*) block);
+    *outHighMask = (unsigned int) _mm_movemask_epi8(bytes);
+    *outSpaceMask = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')));
+#else
+    unsigned int highMask = 0;
+    unsigned int spaceMask = 0;
+    for (int i = 0; i < PREPROCESS_BLOCK_SIZE; i++) {
+        highMask |= (unsigned int) (block[i] >> 7) << i;
+        spaceMask |= (unsigned int) (block[i] == ' ') << i;
+    }
+    *outHighMask = highMask;
+    *outSpaceMask = spaceMask;
+#endif
+}
+
+// Copies a run of plain ASCII blocks through untouched. ASCII never needs spacing on its own, so all that can
+// stop a block is the character before it (punctuation or CJK), a word break coming due, or non-ASCII bytes.
+static size_t CopyAsciiBlocks(Preprocessor* pre, const uint8_t* bytes, size_t length) {
+    size_t offset = 0;
+    while (offset + PREPROCESS_BLOCK_SIZE <= length) {
+        if (pre->bytesNeeded != 0 || pre->pendingBreak || pre->previous < 0 || pre->previous >= 0x80) {
+            break;
+        }
+
+        unsigned int highMask;
+        unsigned int spaceMask;
+        ScanBlock(bytes + offset, &highMask, &spaceMask);
+        if (highMask != 0) {
+            break;
+        }
+
+        // the run up to the first space continues the current word; later runs are shorter than a block
+        int firstSpace = spaceMask ? __builtin_ctz(spaceMask) : PREPROCESS_BLOCK_SIZE;
+        if (pre->chunkHalves + firstSpace >= PREPROCESS_WORD_THRESHOLD * 2) {
+            break;
+        }
+
+        Reserve(pre, PREPROCESS_BLOCK_SIZE);
+        memcpy(pre->output + pre->length, bytes + offset, PREPROCESS_BLOCK_SIZE);
+        pre->length += PREPROCESS_BLOCK_SIZE;
+
+        if (spaceMask) {
+            int tail = PREPROCESS_BLOCK_SIZE - 1 - (31 - __builtin_clz(spaceMask));
+            pre->wordUnits = tail;
+            pre->chunkHalves = tail;
+        } else {
+            pre->wordUnits += PREPROCESS_BLOCK_SIZE;
+            pre->chunkHalves += PREPROCESS_BLOCK_SIZE;
+        }
+        pre->previous = bytes[offset + PREPROCESS_BLOCK_SIZE - 1];
+        offset += PREPROCESS_BLOCK_SIZE;
+    }
+    return offset;
+}
+
+void InitPreprocessor(Preprocessor* preprocessor, size_t expectedLength) {
+    memset(preprocessor, 0, sizeof(*preprocessor));
+    preprocessor->previous = -1;
+    preprocessor->lowerBoundary = 0x80;
+    preprocessor->upperBoundary = 0xBF;
+
+    // spacing adds a little, start with some headroom
+    Reserve(preprocessor, expectedLength + expectedLength / 16);
+}
+
+void FeedPreprocessor(Preprocessor* preprocessor, const char* bytes, size_t length) {
+    const uint8_t* data = (const uint8_t*) bytes;
+    size_t offset = 0;
+    while (offset < length) {
+        offset += CopyAsciiBlocks(preprocessor, data + offset, length - offset);
+        if (offset < length) {
+            // one byte the slow way, then try the fast path again
+            DecodeByte(preprocessor, data[offset++]);
+        }
+    }
+}
+
+char* FinishPreprocessor(Preprocessor* preprocessor, size_t* outLength) {
+    if (preprocessor->bytesNeeded != 0) {
+        // truncated sequence at the very end
+        preprocessor->bytesNeeded = 0;
+        SpaceCodepoint(preprocessor, PREPROCESS_REPLACEMENT);
+    }
+    if (IsSpacedPunctuation(preprocessor->previous)) {
+        // the lookahead for punctuation also matches at the end of the text
+        ChunkCodepoint(preprocessor, ' ');
+    }
+
+    Reserve(preprocessor, 0);
+    preprocessor->output[preprocessor->length] = '\0';
+    if (preprocessor->capacity > preprocessor->length + preprocessor->length / 8 + 64) {
+        // the result usually lives on as a document's source, don't keep the doubling slack around
+        preprocessor->output = (char*) realloc(preprocessor->output, preprocessor->length + 1);
+    }
+
+    char* output = preprocessor->output;
+    if (outLength) {
+        *outLength = preprocessor->length;
+    }
+    preprocessor->output = NULL;
+    preprocessor->length = 0;
+    preprocessor->capacity = 0;
+    return output;
+}
+
+char* PreprocessMarkdown(const char* bytes, size_t length, size_t* outLength) {
+    Preprocessor preprocessor;
+    InitPreprocessor(&preprocessor, length);
+    FeedPreprocessor(&preprocessor, bytes, length);
+    return FinishPreprocessor(&preprocessor, outLength);
+}
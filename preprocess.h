@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+// Words longer than this (in UTF-16 units, like the JS it replaces) get broken up so clay can wrap them
+#define PREPROCESS_WORD_THRESHOLD 10
+
+// Streaming version of what used to be Burogu_Preprocess in preload.js, producing identical output:
+//  - a space after full-width punctuation unless a space or U+200B already follows
+//  - a space between CJK ideographs and ASCII letters or digits, both ways
+//  - long words split every PREPROCESS_WORD_THRESHOLD full-width (or twice as many half-width) characters
+// Input is raw UTF-8 straight from the network or disk; a leading BOM is dropped and invalid
+// sequences become U+FFFD, same as TextDecoder.
+typedef struct {
+    char* output;
+    size_t length;
+    size_t capacity;
+
+    // utf-8 decoder, carried across Feed calls
+    uint32_t codepoint;
+    int bytesNeeded;
+    int bytesSeen;
+    uint8_t lowerBoundary;
+    uint8_t upperBoundary;
+    Bool started;
+
+    int32_t previous; // last code point passed on, -1 before the first
+    int wordUnits;    // UTF-16 units in the current word
+    int chunkHalves;  // half-width steps since the last break inside the word
+    Bool pendingBreak;
+} Preprocessor;
+
+void InitPreprocessor(Preprocessor* preprocessor, size_t expectedLength);
+void FeedPreprocessor(Preprocessor* preprocessor, const char* bytes, size_t length);
+// Returns the NUL-terminated result, malloc'd and owned by the caller
+char* FinishPreprocessor(Preprocessor* preprocessor, size_t* outLength);
+
+char* PreprocessMarkdown(const char* bytes, size_t length, size_t* outLength);
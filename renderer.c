@@ -1,10 +1,17 @@
 #include "raylib.h"
 #include "raymath.h"
+#include "rlgl.h"
 #include "stdint.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
 
+#include "font_loader.h"
+#include "measure_cache.h"
+#include "util.h"
+
+// raylib's default spacing between lines of a multi-line DrawTextEx call
+#define RAYLIB_TEXT_LINE_SPACING 2
 
 #define CLAY_RECTANGLE_TO_RAYLIB_RECTANGLE(rectangle) \
     (Rectangle) { .x = rectangle.x, .y = rectangle.y, .width = rectangle.width, .height = rectangle.height }
@@ -78,17 +85,80 @@ Ray GetScreenToWorldPointWithZDistance(Vector2 position, Camera camera, int scre
     return ray;
 }
 
+// What the renderer did since the last reset, read by the frame profiler
+#define RAYLIB_RENDER_COMMAND_TYPES (CLAY_RENDER_COMMAND_TYPE_CUSTOM + 1)
 
-static inline Clay_Dimensions Raylib_MeasureText(Clay_StringSlice text, Clay_TextElementConfig* config, void* userData) {
+typedef struct {
+    uint32_t measureTextCalls;
+    uint32_t glyphLookups;
+    uint32_t commandsByType[RAYLIB_RENDER_COMMAND_TYPES]; // everything clay emitted, by Clay_RenderCommandType
+    uint32_t culledCommands;
+    uint32_t textureSwitches; // another draw inside rlgl's batch
+    uint32_t batchFlushes;    // the batch handed to the GPU: shader or scissor changes and full batches
+} Raylib_FrameCounters;
+
+static Raylib_FrameCounters Raylib_frameCounters;
+
+// The texture rlgl's current draw uses; rlgl starts another draw in the batch whenever it changes
+static unsigned int Raylib_batchTexture = 0;
+
+Raylib_FrameCounters Raylib_GetFrameCounters() {
+    return Raylib_frameCounters;
+}
+
+// Call with a fresh batch, i.e. once the last frame (overlays drawn with raylib's own calls included) was flushed
+void Raylib_ResetFrameCounters() {
+    memset(&Raylib_frameCounters, 0, sizeof(Raylib_frameCounters));
+    Raylib_batchTexture = rlGetTextureIdDefault();
+}
+
+// For draws that set the texture themselves, DrawTexturePro and friends
+static void Raylib_NoteTexture(unsigned int id) {
+    if (id != Raylib_batchTexture) {
+        Raylib_frameCounters.textureSwitches++;
+        Raylib_batchTexture = id;
+    }
+}
+
+static void Raylib_SetTexture(unsigned int id) {
+    Raylib_NoteTexture(id);
+    rlSetTexture(id);
+}
+
+// After rlgl hands the batch over, the next one starts out on the default texture
+static void Raylib_CountBatchFlush() {
+    Raylib_frameCounters.batchFlushes++;
+    Raylib_batchTexture = rlGetTextureIdDefault();
+}
+
+static void Raylib_CheckRenderBatchLimit(int vertexCount) {
+    if (rlCheckRenderBatchLimit(vertexCount)) {
+        Raylib_CountBatchFlush();
+    }
+}
+
+// Hands what's batched so far to the GPU, counted like every other flush
+void Raylib_DrawRenderBatchActive() {
+    rlDrawRenderBatchActive();
+    Raylib_CountBatchFlush();
+}
+
+static inline Clay_Dimensions Raylib_MeasureTextUncached(Clay_StringSlice text, Clay_TextElementConfig* config, void* userData) {
     Clay_Dimensions textSize = {0};
 
-    Font* fonts = (Font*) userData;
-    Font fontToUse = fonts[config->fontId];
-    if (!fontToUse.glyphs) {
-        fontToUse = GetFontDefault();
+    FontAtlas* fonts = (FontAtlas*) userData;
+    FontAtlas* atlas = ResolveFontAtlasFace(&fonts[config->fontId]);
+    // a pointer, resolving new glyphs may grow the arrays under it
+    const Font* font = &atlas->font;
+    Font defaultFont;
+    Bool useLookup = TRUE;
+    if (!font->glyphs && !atlas->glyphAtlas) {
+        defaultFont = GetFontDefault();
+        font = &defaultFont;
+        useLookup = FALSE;
     }
 
-    float scaleFactor = (float) config->fontSize / (float) fontToUse.baseSize;
+    float scaleFactor = (float) config->fontSize / (float) font->baseSize;
     float maxTextWidth = 0.0f;
     float currentLineWidth = 0.0f;
 
@@ -101,12 +171,16 @@ static inline Clay_Dimensions Raylib_MeasureText(Clay_StringSlice text, Clay_Tex
             maxTextWidth = fmaxf(maxTextWidth, currentLineWidth);
             currentLineWidth = 0;
         } else {
-            int glyphIndex = GetGlyphIndex(fontToUse, codepoint);
-
-            if (fontToUse.glyphs[glyphIndex].advanceX != 0) {
-                currentLineWidth += fontToUse.glyphs[glyphIndex].advanceX * scaleFactor;
+            int glyphIndex = useLookup ? ResolveFontAtlasGlyph(atlas, codepoint) : GetGlyphIndex(*font, codepoint);
+            Raylib_frameCounters.glyphLookups++;
+
+            if (glyphIndex < 0) {
+                // nothing to draw it with, takes no space
+            } else if (font->glyphs[glyphIndex].advanceX != 0 || atlas->glyphAtlas) {
+                // glyphs without a rec until first drawn measure by advance only, so widths don't change once they're rasterized
+                currentLineWidth += font->glyphs[glyphIndex].advanceX * scaleFactor;
             } else {
-                currentLineWidth += (fontToUse.recs[glyphIndex].width + fontToUse.glyphs[glyphIndex].offsetX) * scaleFactor;
+                currentLineWidth += (font->recs[glyphIndex].width + font->glyphs[glyphIndex].offsetX) * scaleFactor;
             }
 
             if (i + codepointByteLength < text.length) {
@@ -125,48 +199,603 @@ static inline Clay_Dimensions Raylib_MeasureText(Clay_StringSlice text, Clay_Tex
     return textSize;
 }
 
+// Word widths survive across frames and documents; only the width is cached, the height comes straight from the config
+static MeasureCache Raylib_measureCache;
+
+static inline Clay_Dimensions Raylib_MeasureText(Clay_StringSlice text, Clay_TextElementConfig* config, void* userData) {
+    Raylib_frameCounters.measureTextCalls++;
+    if (!Raylib_measureCache.entries) {
+        InitMeasureCache(&Raylib_measureCache, MEASURE_CACHE_DEFAULT_CAPACITY);
+    }
+
+    MeasureCacheKey key = {
+            .hash = HashBytes(text.chars, text.length),
+            .length = text.length,
+            .fontId = config->fontId,
+            .fontSize = config->fontSize,
+            .letterSpacing = config->letterSpacing,
+    };
+
+    Clay_Dimensions textSize = {
+            .height = (config->lineHeight > 0) ? config->lineHeight : config->fontSize,
+    };
+    if (FindCachedTextWidth(&Raylib_measureCache, &key, &textSize.width)) {
+        return textSize;
+    }
+
+    textSize = Raylib_MeasureTextUncached(text, config, userData);
+    CacheTextWidth(&Raylib_measureCache, &key, textSize.width);
+    return textSize;
+}
+
+MeasureCacheStats Raylib_GetMeasureCacheStats() {
+    return GetMeasureCacheStats(&Raylib_measureCache);
+}
+
+void Raylib_ResetMeasureCacheStats() {
+    ResetMeasureCacheStats(&Raylib_measureCache);
+}
+
+void Raylib_ClearMeasureCache() {
+    if (Raylib_measureCache.entries) {
+        ClearMeasureCache(&Raylib_measureCache);
+    }
+}
+
+// Same output as DrawTextEx, but takes a length-delimited slice and resolves glyphs through the atlas lookup
+// instead of raylib's linear GetGlyphIndex scan. Atlas fonts sample the shared glyph pages, so the caller has to have
+// the matching shader bound (Raylib_GetTextShader) and the glyphs rasterized (Raylib_PrepareGlyphs); glyphs that
+// aren't resident keep their advance but aren't drawn.
+void Raylib_DrawTextSlice(FontAtlas* atlas, const char* text, int length, Vector2 position, float fontSize, float spacing, Color tint) {
+    atlas = ResolveFontAtlasFace(atlas);
+    const Font* font = &atlas->font;
+    Font defaultFont;
+    Bool useLookup = TRUE;
+    float texelScale = atlas->texelScale;
+    if (!atlas->glyphAtlas) {
+        defaultFont = GetFontDefault();
+        font = &defaultFont;
+        useLookup = FALSE;
+        texelScale = 1.0f;
+    }
+
+    float scaleFactor = fontSize / (float) font->baseSize;
+    // recs and padding are in atlas texels, offsets and advances in font units
+    float recScale = scaleFactor / texelScale;
+    float padding = (float) font->glyphPadding;
+    float textOffsetX = 0.0f;
+    float textOffsetY = 0.0f;
+
+    int i = 0;
+    while (i < length) {
+        int codepointByteCount = 0;
+        int codepoint = GetCodepointNext(&text[i], &codepointByteCount);
+
+        if (codepoint == '\n') {
+            textOffsetY += fontSize + RAYLIB_TEXT_LINE_SPACING;
+            textOffsetX = 0.0f;
+            i += codepointByteCount;
+            continue;
+        }
+
+        int index = useLookup ? ResolveFontAtlasGlyph(atlas, codepoint) : GetGlyphIndex(*font, codepoint);
+        Raylib_frameCounters.glyphLookups++;
+        if (index < 0) {
+            i += codepointByteCount;
+            continue;
+        }
+
+        Bool drawable = codepoint != ' ' && codepoint != '\t';
+        Texture2D texture = font->texture;
+        if (drawable && useLookup) {
+            uint32_t slot = atlas->glyphSlots[index];
+            drawable = IsGlyphSlotResident(atlas->glyphAtlas, slot);
+            if (drawable) {
+                texture = atlas->glyphAtlas->pages[GetGlyphSlotPage(slot)].texture;
+            }
+        }
+
+        if (drawable) {
+            Rectangle srcRec = {
+                    font->recs[index].x - padding,
+                    font->recs[index].y - padding,
+                    font->recs[index].width + 2.0f * padding,
+                    font->recs[index].height + 2.0f * padding,
+            };
+            Rectangle dstRec = {
+                    position.x + textOffsetX + font->glyphs[index].offsetX * scaleFactor - padding * recScale,
+                    position.y + textOffsetY + font->glyphs[index].offsetY * scaleFactor - padding * recScale,
+                    srcRec.width * recScale,
+                    srcRec.height * recScale,
+            };
+            DrawTexturePro(texture, srcRec, dstRec, (Vector2){0, 0}, 0.0f, tint);
+            Raylib_NoteTexture(texture.id);
+        }
+
+        if (font->glyphs[index].advanceX != 0 || useLookup) {
+            textOffsetX += font->glyphs[index].advanceX * scaleFactor + spacing;
+        } else {
+            textOffsetX += font->recs[index].width * scaleFactor + spacing;
+        }
+
+        i += codepointByteCount;
+    }
+}
+
+// Per render command, FALSE when it lies entirely outside the window or the scissors around it
+static Bool* Raylib_commandVisible = NULL;
+static int Raylib_commandVisible_count = 0;
+static int Raylib_commandVisible_capacity = 0;
+
+#define RAYLIB_MAX_SCISSOR_DEPTH 16
+
+static Rectangle Raylib_IntersectRectangles(Rectangle a, Rectangle b) {
+    float x0 = fmaxf(a.x, b.x);
+    float y0 = fmaxf(a.y, b.y);
+    float x1 = fminf(a.x + a.width, b.x + b.width);
+    float y1 = fminf(a.y + a.height, b.y + b.height);
+    return (Rectangle){x0, y0, fmaxf(x1 - x0, 0.0f), fmaxf(y1 - y0, 0.0f)};
+}
+
+static Bool Raylib_RectanglesOverlap(Rectangle a, Rectangle b) {
+    return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height && b.y < a.y + a.height;
+}
+
+// Walks the scissor stack once so both the glyph pre-pass and the draw loop can skip what can't be seen
+void Raylib_CullRenderCommands(Clay_RenderCommandArray renderCommands) {
+    Rectangle clipStack[RAYLIB_MAX_SCISSOR_DEPTH + 1];
+    int depth = 0;
+    clipStack[0] = (Rectangle){0, 0, (float) GetScreenWidth(), (float) GetScreenHeight()};
+
+    Raylib_commandVisible_count = 0;
+    for (int j = 0; j < renderCommands.length; j++) {
+        Clay_RenderCommand* renderCommand = Clay_RenderCommandArray_Get(&renderCommands, j);
+        Rectangle bounds = CLAY_RECTANGLE_TO_RAYLIB_RECTANGLE(renderCommand->boundingBox);
+        Bool visible = TRUE;
+
+        switch (renderCommand->commandType) {
+            case CLAY_RENDER_COMMAND_TYPE_SCISSOR_START:
+                if (depth < RAYLIB_MAX_SCISSOR_DEPTH) {
+                    clipStack[depth + 1] = Raylib_IntersectRectangles(clipStack[depth], bounds);
+                }
+                depth++;
+                break;
+            case CLAY_RENDER_COMMAND_TYPE_SCISSOR_END:
+                if (depth > 0) depth--;
+                break;
+            case CLAY_RENDER_COMMAND_TYPE_CUSTOM:
+                break;
+            case CLAY_RENDER_COMMAND_TYPE_TEXT: {
+                // glyphs can overhang their line box, italics and descenders mostly
+                float margin = (float) renderCommand->renderData.text.fontSize;
+                bounds = (Rectangle){bounds.x - margin, bounds.y - margin, bounds.width + 2 * margin, bounds.height + 2 * margin};
+                visible = Raylib_RectanglesOverlap(bounds, clipStack[CLAY__MIN(depth, RAYLIB_MAX_SCISSOR_DEPTH)]);
+                break;
+            }
+            default:
+                visible = Raylib_RectanglesOverlap(bounds, clipStack[CLAY__MIN(depth, RAYLIB_MAX_SCISSOR_DEPTH)]);
+                break;
+        }
+        DYNARRAY_PUSHBACK(Raylib_commandVisible, visible);
+        if (renderCommand->commandType < RAYLIB_RENDER_COMMAND_TYPES) {
+            Raylib_frameCounters.commandsByType[renderCommand->commandType]++;
+        }
+        if (!visible) {
+            Raylib_frameCounters.culledCommands++;
+        }
+    }
+}
+
+// Font slots the glyph pre-pass looks at
+#define RAYLIB_MAX_FONTS 16
+// marks a glyph as already queued during the pre-pass; not a resident slot, the page byte is out of range
+#define RAYLIB_GLYPH_SLOT_QUEUED 0xFE000000u
+
+// (fontId << 24 | glyph index) of every glyph the current frame needs rasterized
+static int* Raylib_queuedGlyphs = NULL;
+static int Raylib_queuedGlyphs_count = 0;
+static int Raylib_queuedGlyphs_capacity = 0;
+
+// Glyph indices the pre-pass resolved for each render command, so drawing doesn't decode the text a second time
+#define RAYLIB_GLYPH_RUN_NEWLINE -2
+
+typedef struct {
+    int first; // into Raylib_runGlyphs
+    int count; // -1 for commands that aren't drawn from a glyph atlas
+} Raylib_GlyphRun;
+
+static Raylib_GlyphRun* Raylib_glyphRuns = NULL;
+static int Raylib_glyphRuns_count = 0;
+static int Raylib_glyphRuns_capacity = 0;
+
+static int* Raylib_runGlyphs = NULL;
+static int Raylib_runGlyphs_count = 0;
+static int Raylib_runGlyphs_capacity = 0;
+
+static int CompareInts(const void* a, const void* b) {
+    int x = *(const int*) a;
+    int y = *(const int*) b;
+    return (x > y) - (x < y);
+}
+
+// Makes every glyph the frame is about to draw resident before any quad is queued, so pages are only recycled between
+// frames and each font's misses reach the rasterizer as one batch. Also leaves a glyph run per render command behind.
+void Raylib_PrepareGlyphs(Clay_RenderCommandArray renderCommands, FontAtlas* fonts) {
+    GlyphAtlas* glyphAtlases[RAYLIB_MAX_FONTS];
+    int glyphAtlasCount = 0;
+    for (int f = 0; f < RAYLIB_MAX_FONTS; f++) {
+        GlyphAtlas* glyphAtlas = fonts[f].glyphAtlas;
+        if (!glyphAtlas) continue;
+
+        Bool seen = FALSE;
+        for (int k = 0; k < glyphAtlasCount; k++) {
+            seen |= glyphAtlases[k] == glyphAtlas;
+        }
+        if (!seen) {
+            glyphAtlases[glyphAtlasCount++] = glyphAtlas;
+            BeginGlyphAtlasFrame(glyphAtlas);
+        }
+    }
+
+    Raylib_queuedGlyphs_count = 0;
+    Raylib_glyphRuns_count = 0;
+    Raylib_runGlyphs_count = 0;
+    for (int j = 0; j < renderCommands.length; j++) {
+        Clay_RenderCommand* renderCommand = Clay_RenderCommandArray_Get(&renderCommands, j);
+        DYNARRAY_PUSHBACK(Raylib_glyphRuns, ((Raylib_GlyphRun){.first = Raylib_runGlyphs_count, .count = -1}));
+        if (renderCommand->commandType != CLAY_RENDER_COMMAND_TYPE_TEXT || !Raylib_commandVisible[j]) continue;
+
+        Clay_TextRenderData* textData = &renderCommand->renderData.text;
+        if (textData->fontId >= RAYLIB_MAX_FONTS) continue;
+        FontAtlas* atlas = ResolveFontAtlasFace(&fonts[textData->fontId]);
+        if (!atlas->glyphAtlas) continue;
+        int fontSlot = (int) (atlas - fonts);
+
+        const char* text = textData->stringContents.chars;
+        int i = 0;
+        while (i < textData->stringContents.length) {
+            int codepointByteCount = 0;
+            int codepoint = GetCodepointNext(&text[i], &codepointByteCount);
+            i += codepointByteCount;
+            if (codepoint == '\n') {
+                DYNARRAY_PUSHBACK(Raylib_runGlyphs, RAYLIB_GLYPH_RUN_NEWLINE);
+                continue;
+            }
+
+            int index = ResolveFontAtlasGlyph(atlas, codepoint);
+            Raylib_frameCounters.glyphLookups++;
+            if (index < 0) continue;
+            // whitespace only advances, it's never rasterized so it never turns resident
+            DYNARRAY_PUSHBACK(Raylib_runGlyphs, index);
+            if (codepoint == ' ' || codepoint == '\t') continue;
+
+            uint32_t slot = atlas->glyphSlots[index];
+            if (IsGlyphSlotResident(atlas->glyphAtlas, slot)) {
+                TouchGlyphSlot(atlas->glyphAtlas, slot);
+            } else if (slot != RAYLIB_GLYPH_SLOT_QUEUED) {
+                atlas->glyphSlots[index] = RAYLIB_GLYPH_SLOT_QUEUED;
+                DYNARRAY_PUSHBACK(Raylib_queuedGlyphs, (fontSlot << 24) | index);
+            }
+        }
+        Raylib_glyphRuns[j].count = Raylib_runGlyphs_count - Raylib_glyphRuns[j].first;
+    }
+
+    // one rasterizer call per font
+    qsort(Raylib_queuedGlyphs, Raylib_queuedGlyphs_count, sizeof(int), CompareInts);
+    int runStart = 0;
+    while (runStart < Raylib_queuedGlyphs_count) {
+        int fontId = Raylib_queuedGlyphs[runStart] >> 24;
+        int runEnd = runStart;
+        while (runEnd < Raylib_queuedGlyphs_count && (Raylib_queuedGlyphs[runEnd] >> 24) == fontId) {
+            Raylib_queuedGlyphs[runEnd] &= 0xFFFFFF;
+            runEnd++;
+        }
+
+        FontAtlas* atlas = &fonts[fontId];
+        RasterizeFontAtlasGlyphs(atlas, &Raylib_queuedGlyphs[runStart], runEnd - runStart);
+        for (int k = runStart; k < runEnd; k++) {
+            if (atlas->glyphSlots[Raylib_queuedGlyphs[k]] == RAYLIB_GLYPH_SLOT_QUEUED) {
+                atlas->glyphSlots[Raylib_queuedGlyphs[k]] = GLYPH_SLOT_NONE;
+            }
+        }
+        runStart = runEnd;
+    }
+
+    for (int k = 0; k < glyphAtlasCount; k++) {
+        UploadGlyphAtlas(glyphAtlases[k]);
+    }
+}
+
+// Shape tessellations reused across frames, keyed by size and radius; vertices are a triangle list around the origin
+#define RAYLIB_SHAPE_CACHE_SIZE 256
+#define RAYLIB_ROUNDED_SEGMENTS 8
+#define RAYLIB_RING_SEGMENTS 10
+
+typedef enum {
+    RAYLIB_SHAPE_NONE = 0,
+    RAYLIB_SHAPE_ROUNDED_RECTANGLE,
+    RAYLIB_SHAPE_RING,
+} Raylib_ShapeKind;
+
+typedef struct {
+    Raylib_ShapeKind kind;
+    float a, b, c; // rounded rectangle: width, height, radius; ring: inner radius, outer radius, start angle
+    Vector2* vertices;
+    int vertexCount;
+} Raylib_CachedShape;
+
+static Raylib_CachedShape Raylib_shapeCache[RAYLIB_SHAPE_CACHE_SIZE];
+static int Raylib_shapeCacheCount = 0;
+
+static void Raylib_ClearShapeCache() {
+    for (int i = 0; i < RAYLIB_SHAPE_CACHE_SIZE; i++) {
+        free(Raylib_shapeCache[i].vertices);
+    }
+    memset(Raylib_shapeCache, 0, sizeof(Raylib_shapeCache));
+    Raylib_shapeCacheCount = 0;
+}
+
+// Points along an arc around center, segments + 1 of them from startAngle to startAngle + 90 degrees
+static void Raylib_TessellateArc(Vector2* points, Vector2 center, float radius, float startAngle, int segments) {
+    for (int i = 0; i <= segments; i++) {
+        float angle = DEG2RAD * (startAngle + 90.0f * i / segments);
+        points[i] = (Vector2){center.x + cosf(angle) * radius, center.y + sinf(angle) * radius};
+    }
+}
+
+static void Raylib_BuildRoundedRectangle(Raylib_CachedShape* shape) {
+    float width = shape->a;
+    float height = shape->b;
+    float radius = shape->c;
+    const int arcPoints = RAYLIB_ROUNDED_SEGMENTS + 1;
+
+    // the outline clockwise from the top-left corner, fanned out from the center since the shape is convex
+    Vector2 outline[4 * (RAYLIB_ROUNDED_SEGMENTS + 1)];
+    Raylib_TessellateArc(&outline[0], (Vector2){radius, radius}, radius, 180.0f, RAYLIB_ROUNDED_SEGMENTS);
+    Raylib_TessellateArc(&outline[arcPoints], (Vector2){width - radius, radius}, radius, 270.0f, RAYLIB_ROUNDED_SEGMENTS);
+    Raylib_TessellateArc(&outline[2 * arcPoints], (Vector2){width - radius, height - radius}, radius, 0.0f, RAYLIB_ROUNDED_SEGMENTS);
+    Raylib_TessellateArc(&outline[3 * arcPoints], (Vector2){radius, height - radius}, radius, 90.0f, RAYLIB_ROUNDED_SEGMENTS);
+
+    int outlineCount = 4 * arcPoints;
+    Vector2 center = {width / 2, height / 2};
+    shape->vertexCount = 3 * outlineCount;
+    shape->vertices = (Vector2*) malloc(shape->vertexCount * sizeof(Vector2));
+    for (int i = 0; i < outlineCount; i++) {
+        shape->vertices[3 * i] = center;
+        shape->vertices[3 * i + 1] = outline[(i + 1) % outlineCount];
+        shape->vertices[3 * i + 2] = outline[i];
+    }
+}
+
+static void Raylib_BuildRing(Raylib_CachedShape* shape) {
+    Vector2 inner[RAYLIB_RING_SEGMENTS + 1];
+    Vector2 outer[RAYLIB_RING_SEGMENTS + 1];
+    Raylib_TessellateArc(inner, (Vector2){0, 0}, shape->a, shape->c, RAYLIB_RING_SEGMENTS);
+    Raylib_TessellateArc(outer, (Vector2){0, 0}, shape->b, shape->c, RAYLIB_RING_SEGMENTS);
+
+    shape->vertexCount = 6 * RAYLIB_RING_SEGMENTS;
+    shape->vertices = (Vector2*) malloc(shape->vertexCount * sizeof(Vector2));
+    // both halves of each segment wind the same way as raylib's DrawRing, or backface culling drops one of them
+    for (int i = 0; i < RAYLIB_RING_SEGMENTS; i++) {
+        Vector2* quad = &shape->vertices[6 * i];
+        quad[0] = inner[i];
+        quad[1] = outer[i + 1];
+        quad[2] = outer[i];
+        quad[3] = inner[i];
+        quad[4] = inner[i + 1];
+        quad[5] = outer[i + 1];
+    }
+}
+
+static const Raylib_CachedShape* Raylib_GetCachedShape(Raylib_ShapeKind kind, float a, float b, float c) {
+    // a full table is simply dropped, layouts only use a handful of distinct shapes
+    if (Raylib_shapeCacheCount >= RAYLIB_SHAPE_CACHE_SIZE * 3 / 4) {
+        Raylib_ClearShapeCache();
+    }
+
+    float key[3] = {a, b, c};
+    uint32_t slot = (uint32_t) HashBytes(key, sizeof(key)) * 31u + kind;
+    for (;; slot++) {
+        Raylib_CachedShape* shape = &Raylib_shapeCache[slot % RAYLIB_SHAPE_CACHE_SIZE];
+        if (shape->kind == kind && shape->a == a && shape->b == b && shape->c == c) {
+            return shape;
+        }
+        if (shape->kind == RAYLIB_SHAPE_NONE) {
+            *shape = (Raylib_CachedShape){.kind = kind, .a = a, .b = b, .c = c};
+            if (kind == RAYLIB_SHAPE_RING) {
+                Raylib_BuildRing(shape);
+            } else {
+                Raylib_BuildRoundedRectangle(shape);
+            }
+            Raylib_shapeCacheCount++;
+            return shape;
+        }
+    }
+}
+
+// Every shape goes out as triangles on raylib's default texture, so neighbouring rectangles, rounded rectangles and
+// rings all land in one draw instead of switching between quad and triangle draws
+static void Raylib_BeginShapeTriangles(Color color) {
+    Raylib_SetTexture(rlGetTextureIdDefault());
+    rlBegin(RL_TRIANGLES);
+    rlColor4ub(color.r, color.g, color.b, color.a);
+}
+
+static void Raylib_EndShapeTriangles() {
+    rlEnd();
+    rlSetTexture(0);
+}
+
+static void Raylib_DrawCachedShape(const Raylib_CachedShape* shape, Vector2 origin, Color color) {
+    Raylib_BeginShapeTriangles(color);
+    for (int i = 0; i < shape->vertexCount; i += 3) {
+        Raylib_CheckRenderBatchLimit(3);
+        for (int k = 0; k < 3; k++) {
+            rlTexCoord2f(0.0f, 0.0f);
+            rlVertex2f(origin.x + shape->vertices[i + k].x, origin.y + shape->vertices[i + k].y);
+        }
+    }
+    Raylib_EndShapeTriangles();
+}
+
+static void Raylib_DrawRectangleBatched(float x, float y, float width, float height, Color color) {
+    if (width <= 0 || height <= 0) return;
+
+    Raylib_BeginShapeTriangles(color);
+    Raylib_CheckRenderBatchLimit(6);
+    const Vector2 corners[6] = {{x, y}, {x, y + height}, {x + width, y + height}, {x, y}, {x + width, y + height}, {x + width, y}};
+    for (int k = 0; k < 6; k++) {
+        rlTexCoord2f(0.0f, 0.0f);
+        rlVertex2f(corners[k].x, corners[k].y);
+    }
+    Raylib_EndShapeTriangles();
+}
+
+static void Raylib_DrawRoundedRectangleCached(Rectangle rec, float radius, Color color) {
+    radius = fminf(radius, fminf(rec.width, rec.height) / 2);
+    if (radius <= 0) {
+        Raylib_DrawRectangleBatched(rec.x, rec.y, rec.width, rec.height, color);
+        return;
+    }
+    Raylib_DrawCachedShape(Raylib_GetCachedShape(RAYLIB_SHAPE_ROUNDED_RECTANGLE, rec.width, rec.height, radius), (Vector2){rec.x, rec.y}, color);
+}
+
+// A quarter ring starting at startAngle, same as DrawRing over 90 degrees
+static void Raylib_DrawCornerCached(Vector2 center, float innerRadius, float outerRadius, float startAngle, Color color) {
+    innerRadius = fmaxf(innerRadius, 0.0f);
+    if (outerRadius <= innerRadius) return;
+    Raylib_DrawCachedShape(Raylib_GetCachedShape(RAYLIB_SHAPE_RING, innerRadius, outerRadius, startAngle), center, color);
+}
+
+// Draws a run the pre-pass resolved as textured quads straight into rlgl's batch, in the same places
+// Raylib_DrawTextSlice would put them; the quads only split into another draw where the glyph page changes.
+void Raylib_DrawGlyphRun(FontAtlas* atlas, const int* glyphs, int count, Vector2 position, float fontSize, float spacing, Color tint) {
+    atlas = ResolveFontAtlasFace(atlas);
+    const Font* font = &atlas->font;
+    const GlyphAtlas* glyphAtlas = atlas->glyphAtlas;
+
+    float scaleFactor = fontSize / (float) font->baseSize;
+    float recScale = scaleFactor / atlas->texelScale;
+    float padding = (float) font->glyphPadding;
+    float texelSize = 1.0f / (float) glyphAtlas->pageSize;
+    float penX = position.x;
+    float penY = position.y;
+    unsigned int boundTexture = 0;
+
+    for (int k = 0; k < count; k++) {
+        int index = glyphs[k];
+        if (index == RAYLIB_GLYPH_RUN_NEWLINE) {
+            penY += fontSize + RAYLIB_TEXT_LINE_SPACING;
+            penX = position.x;
+            continue;
+        }
+
+        uint32_t slot = atlas->glyphSlots[index];
+        if (IsGlyphSlotResident(glyphAtlas, slot)) {
+            unsigned int texture = glyphAtlas->pages[GetGlyphSlotPage(slot)].texture.id;
+            if (texture != boundTexture) {
+                if (boundTexture) rlEnd();
+                Raylib_SetTexture(texture);
+                rlBegin(RL_QUADS);
+                rlColor4ub(tint.r, tint.g, tint.b, tint.a);
+                rlNormal3f(0.0f, 0.0f, 1.0f);
+                boundTexture = texture;
+            }
+            Raylib_CheckRenderBatchLimit(4);
+
+            Rectangle rec = font->recs[index];
+            float u0 = (rec.x - padding) * texelSize;
+            float v0 = (rec.y - padding) * texelSize;
+            float u1 = (rec.x + rec.width + padding) * texelSize;
+            float v1 = (rec.y + rec.height + padding) * texelSize;
+
+            float x0 = penX + font->glyphs[index].offsetX * scaleFactor - padding * recScale;
+            float y0 = penY + font->glyphs[index].offsetY * scaleFactor - padding * recScale;
+            float x1 = x0 + (rec.width + 2.0f * padding) * recScale;
+            float y1 = y0 + (rec.height + 2.0f * padding) * recScale;
+
+            rlTexCoord2f(u0, v0);
+            rlVertex2f(x0, y0);
+            rlTexCoord2f(u0, v1);
+            rlVertex2f(x0, y1);
+            rlTexCoord2f(u1, v1);
+            rlVertex2f(x1, y1);
+            rlTexCoord2f(u1, v0);
+            rlVertex2f(x1, y0);
+        }
+
+        penX += font->glyphs[index].advanceX * scaleFactor + spacing;
+    }
+
+    if (boundTexture) {
+        rlEnd();
+        rlSetTexture(0);
+    }
+}
+
 void Clay_Raylib_Initialize(int width, int height, const char* title, unsigned int flags) {
     SetConfigFlags(flags);
     InitWindow(width, height, title);
-    //    EnableEventWaiting();
 }
 
-// A MALLOC'd buffer, that we keep modifying inorder to save from so many Malloc and Free Calls.
-// Call Clay_Raylib_Close() to free
-static char* temp_render_buffer = NULL;
-static int temp_render_buffer_len = 0;
-
-// Call after closing the window to clean up the render buffer
+// Call after closing the window
 void Clay_Raylib_Close() {
-    if (temp_render_buffer) free(temp_render_buffer);
-    temp_render_buffer_len = 0;
-
+    FreeMeasureCache(&Raylib_measureCache);
+    DYNARRAY_FREE(Raylib_queuedGlyphs);
+    DYNARRAY_FREE(Raylib_glyphRuns);
+    DYNARRAY_FREE(Raylib_runGlyphs);
+    DYNARRAY_FREE(Raylib_commandVisible);
+    Raylib_ClearShapeCache();
     CloseWindow();
 }
 
 
-void Clay_Raylib_Render(Clay_RenderCommandArray renderCommands, Font* fonts) {
+// Shader a text command has to be drawn with, NULL for the default font
+static const Shader* Raylib_GetTextShader(FontAtlas* atlas) {
+    atlas = ResolveFontAtlasFace(atlas);
+    if (!atlas->glyphAtlas) return NULL;
+    return atlas->distanceField ? &atlas->glyphAtlas->distanceFieldShader : &atlas->glyphAtlas->coverageShader;
+}
+
+void Clay_Raylib_Render(Clay_RenderCommandArray renderCommands, FontAtlas* fonts) {
+    Raylib_CullRenderCommands(renderCommands);
+    Raylib_PrepareGlyphs(renderCommands, fonts);
+
+    // consecutive text commands share one shader switch instead of flushing the batch each time
+    const Shader* activeTextShader = NULL;
+
+    // scissors nest, ending one goes back to the one around it
+    Clay_BoundingBox scissorStack[RAYLIB_MAX_SCISSOR_DEPTH];
+    int scissorDepth = 0;
+
     for (int j = 0; j < renderCommands.length; j++) {
+        if (!Raylib_commandVisible[j]) continue;
+
         Clay_RenderCommand* renderCommand = Clay_RenderCommandArray_Get(&renderCommands, j);
         Clay_BoundingBox boundingBox = {roundf(renderCommand->boundingBox.x), roundf(renderCommand->boundingBox.y), roundf(renderCommand->boundingBox.width), roundf(renderCommand->boundingBox.height)};
+
+        const Shader* wantedTextShader = NULL;
+        if (renderCommand->commandType == CLAY_RENDER_COMMAND_TYPE_TEXT) {
+            wantedTextShader = Raylib_GetTextShader(&fonts[renderCommand->renderData.text.fontId]);
+        }
+        if (wantedTextShader != activeTextShader) {
+            if (activeTextShader) EndShaderMode();
+            if (wantedTextShader) BeginShaderMode(*wantedTextShader);
+            activeTextShader = wantedTextShader;
+            Raylib_CountBatchFlush();
+        }
+
         switch (renderCommand->commandType) {
             case CLAY_RENDER_COMMAND_TYPE_TEXT: {
                 Clay_TextRenderData* textData = &renderCommand->renderData.text;
-                Font fontToUse = fonts[textData->fontId];
-
-                int strlen = textData->stringContents.length + 1;
+                FontAtlas* atlas = &fonts[textData->fontId];
+                Raylib_GlyphRun run = Raylib_glyphRuns[j];
 
-                if (strlen > temp_render_buffer_len) {
-                    // Grow the temp buffer if we need a larger string
-                    if (temp_render_buffer) free(temp_render_buffer);
-                    temp_render_buffer = (char*) malloc(strlen);
-                    temp_render_buffer_len = strlen;
+                if (run.count >= 0) {
+                    Raylib_DrawGlyphRun(atlas, &Raylib_runGlyphs[run.first], run.count, (Vector2){boundingBox.x, boundingBox.y}, (float) textData->fontSize, (float) textData->letterSpacing, CLAY_COLOR_TO_RAYLIB_COLOR(textData->textColor));
+                    break;
                 }
-
-                // Raylib uses standard C strings so isn't compatible with cheap slices, we need to clone the string to append null terminator
-                memcpy(temp_render_buffer, textData->stringContents.chars, textData->stringContents.length);
-                temp_render_buffer[textData->stringContents.length] = '\0';
-                DrawTextEx(fontToUse, temp_render_buffer, (Vector2){boundingBox.x, boundingBox.y}, (float) textData->fontSize, (float) textData->letterSpacing, CLAY_COLOR_TO_RAYLIB_COLOR(textData->textColor));
+                Raylib_DrawTextSlice(atlas, textData->stringContents.chars, textData->stringContents.length, (Vector2){boundingBox.x, boundingBox.y}, (float) textData->fontSize, (float) textData->letterSpacing, CLAY_COLOR_TO_RAYLIB_COLOR(textData->textColor));
 
                 break;
             }
@@ -183,55 +812,70 @@ void Clay_Raylib_Render(Clay_RenderCommandArray renderCommands, Font* fonts) {
                         (Vector2){},
                         0,
                         CLAY_COLOR_TO_RAYLIB_COLOR(tintColor));
+                Raylib_NoteTexture(imageTexture.id);
                 break;
             }
             case CLAY_RENDER_COMMAND_TYPE_SCISSOR_START: {
-                BeginScissorMode((int) roundf(boundingBox.x), (int) roundf(boundingBox.y), (int) roundf(boundingBox.width), (int) roundf(boundingBox.height));
+                // scissors nested past the limit aren't applied, the deepest one kept goes on clipping (as the cull
+                // pass assumes), and their ends have nothing to restore
+                if (scissorDepth < RAYLIB_MAX_SCISSOR_DEPTH) {
+                    scissorStack[scissorDepth] = boundingBox;
+                    Raylib_CountBatchFlush();
+                    BeginScissorMode((int) roundf(boundingBox.x), (int) roundf(boundingBox.y), (int) roundf(boundingBox.width), (int) roundf(boundingBox.height));
+                }
+                scissorDepth++;
                 break;
             }
             case CLAY_RENDER_COMMAND_TYPE_SCISSOR_END: {
-                EndScissorMode();
+                if (scissorDepth == 0) break;
+                scissorDepth--;
+                if (scissorDepth >= RAYLIB_MAX_SCISSOR_DEPTH) break;
+
+                Raylib_CountBatchFlush();
+                if (scissorDepth > 0) {
+                    Clay_BoundingBox outer = scissorStack[scissorDepth - 1];
+                    BeginScissorMode((int) outer.x, (int) outer.y, (int) outer.width, (int) outer.height);
+                } else {
+                    EndScissorMode();
+                }
                 break;
             }
             case CLAY_RENDER_COMMAND_TYPE_RECTANGLE: {
                 Clay_RectangleRenderData* config = &renderCommand->renderData.rectangle;
-                if (config->cornerRadius.topLeft > 0) {
-                    float radius = (config->cornerRadius.topLeft * 2) / (float) ((boundingBox.width > boundingBox.height) ? boundingBox.height : boundingBox.width);
-                    DrawRectangleRounded((Rectangle){boundingBox.x, boundingBox.y, boundingBox.width, boundingBox.height}, radius, 8, CLAY_COLOR_TO_RAYLIB_COLOR(config->backgroundColor));
-                } else {
-                    DrawRectangle(boundingBox.x, boundingBox.y, boundingBox.width, boundingBox.height, CLAY_COLOR_TO_RAYLIB_COLOR(config->backgroundColor));
-                }
+                Rectangle rec = {boundingBox.x, boundingBox.y, boundingBox.width, boundingBox.height};
+                Raylib_DrawRoundedRectangleCached(rec, config->cornerRadius.topLeft, CLAY_COLOR_TO_RAYLIB_COLOR(config->backgroundColor));
                 break;
             }
             case CLAY_RENDER_COMMAND_TYPE_BORDER: {
                 Clay_BorderRenderData* config = &renderCommand->renderData.border;
+                Color color = CLAY_COLOR_TO_RAYLIB_COLOR(config->color);
                 // Left border
                 if (config->width.left > 0) {
-                    DrawRectangle((int) roundf(boundingBox.x), (int) roundf(boundingBox.y + config->cornerRadius.topLeft), (int) config->width.left, (int) roundf(boundingBox.height - config->cornerRadius.topLeft - config->cornerRadius.bottomLeft), CLAY_COLOR_TO_RAYLIB_COLOR(config->color));
+                    Raylib_DrawRectangleBatched(roundf(boundingBox.x), roundf(boundingBox.y + config->cornerRadius.topLeft), config->width.left, roundf(boundingBox.height - config->cornerRadius.topLeft - config->cornerRadius.bottomLeft), color);
                 }
                 // Right border
                 if (config->width.right > 0) {
-                    DrawRectangle((int) roundf(boundingBox.x + boundingBox.width - config->width.right), (int) roundf(boundingBox.y + config->cornerRadius.topRight), (int) config->width.right, (int) roundf(boundingBox.height - config->cornerRadius.topRight - config->cornerRadius.bottomRight), CLAY_COLOR_TO_RAYLIB_COLOR(config->color));
+                    Raylib_DrawRectangleBatched(roundf(boundingBox.x + boundingBox.width - config->width.right), roundf(boundingBox.y + config->cornerRadius.topRight), config->width.right, roundf(boundingBox.height - config->cornerRadius.topRight - config->cornerRadius.bottomRight), color);
                 }
                 // Top border
                 if (config->width.top > 0) {
-                    DrawRectangle((int) roundf(boundingBox.x + config->cornerRadius.topLeft), (int) roundf(boundingBox.y), (int) roundf(boundingBox.width - config->cornerRadius.topLeft - config->cornerRadius.topRight), (int) config->width.top, CLAY_COLOR_TO_RAYLIB_COLOR(config->color));
+                    Raylib_DrawRectangleBatched(roundf(boundingBox.x + config->cornerRadius.topLeft), roundf(boundingBox.y), roundf(boundingBox.width - config->cornerRadius.topLeft - config->cornerRadius.topRight), config->width.top, color);
                 }
                 // Bottom border
                 if (config->width.bottom > 0) {
-                    DrawRectangle((int) roundf(boundingBox.x + config->cornerRadius.bottomLeft), (int) roundf(boundingBox.y + boundingBox.height - config->width.bottom), (int) roundf(boundingBox.width - config->cornerRadius.bottomLeft - config->cornerRadius.bottomRight), (int) config->width.bottom, CLAY_COLOR_TO_RAYLIB_COLOR(config->color));
+                    Raylib_DrawRectangleBatched(roundf(boundingBox.x + config->cornerRadius.bottomLeft), roundf(boundingBox.y + boundingBox.height - config->width.bottom), roundf(boundingBox.width - config->cornerRadius.bottomLeft - config->cornerRadius.bottomRight), config->width.bottom, color);
                 }
                 if (config->cornerRadius.topLeft > 0) {
-                    DrawRing((Vector2){roundf(boundingBox.x + config->cornerRadius.topLeft), roundf(boundingBox.y + config->cornerRadius.topLeft)}, roundf(config->cornerRadius.topLeft - config->width.top), config->cornerRadius.topLeft, 180, 270, 10, CLAY_COLOR_TO_RAYLIB_COLOR(config->color));
+                    Raylib_DrawCornerCached((Vector2){roundf(boundingBox.x + config->cornerRadius.topLeft), roundf(boundingBox.y + config->cornerRadius.topLeft)}, roundf(config->cornerRadius.topLeft - config->width.top), config->cornerRadius.topLeft, 180, color);
                 }
                 if (config->cornerRadius.topRight > 0) {
-                    DrawRing((Vector2){roundf(boundingBox.x + boundingBox.width - config->cornerRadius.topRight), roundf(boundingBox.y + config->cornerRadius.topRight)}, roundf(config->cornerRadius.topRight - config->width.top), config->cornerRadius.topRight, 270, 360, 10, CLAY_COLOR_TO_RAYLIB_COLOR(config->color));
+                    Raylib_DrawCornerCached((Vector2){roundf(boundingBox.x + boundingBox.width - config->cornerRadius.topRight), roundf(boundingBox.y + config->cornerRadius.topRight)}, roundf(config->cornerRadius.topRight - config->width.top), config->cornerRadius.topRight, 270, color);
                 }
                 if (config->cornerRadius.bottomLeft > 0) {
-                    DrawRing((Vector2){roundf(boundingBox.x + config->cornerRadius.bottomLeft), roundf(boundingBox.y + boundingBox.height - config->cornerRadius.bottomLeft)}, roundf(config->cornerRadius.bottomLeft - config->width.bottom), config->cornerRadius.bottomLeft, 90, 180, 10, CLAY_COLOR_TO_RAYLIB_COLOR(config->color));
+                    Raylib_DrawCornerCached((Vector2){roundf(boundingBox.x + config->cornerRadius.bottomLeft), roundf(boundingBox.y + boundingBox.height - config->cornerRadius.bottomLeft)}, roundf(config->cornerRadius.bottomLeft - config->width.bottom), config->cornerRadius.bottomLeft, 90, color);
                 }
                 if (config->cornerRadius.bottomRight > 0) {
-                    DrawRing((Vector2){roundf(boundingBox.x + boundingBox.width - config->cornerRadius.bottomRight), roundf(boundingBox.y + boundingBox.height - config->cornerRadius.bottomRight)}, roundf(config->cornerRadius.bottomRight - config->width.bottom), config->cornerRadius.bottomRight, 0.1, 90, 10, CLAY_COLOR_TO_RAYLIB_COLOR(config->color));
+                    Raylib_DrawCornerCached((Vector2){roundf(boundingBox.x + boundingBox.width - config->cornerRadius.bottomRight), roundf(boundingBox.y + boundingBox.height - config->cornerRadius.bottomRight)}, roundf(config->cornerRadius.bottomRight - config->width.bottom), config->cornerRadius.bottomRight, 0, color);
                 }
                 break;
             }
@@ -260,4 +904,9 @@ void Clay_Raylib_Render(Clay_RenderCommandArray renderCommands, Font* fonts) {
             }
         }
     }
+
+    if (activeTextShader) {
+        EndShaderMode();
+        Raylib_CountBatchFlush();
+    }
 }
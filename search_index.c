@@ -0,0 +1,238 @@
+#include "search_index.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Decodes one UTF-8 sequence, malformed bytes come out as themselves one at a time
+static int DecodeUtf8(const unsigned char* text, size_t length, int* outBytes) {
+    unsigned char lead = text[0];
+    int count = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    if (count == 1 || (size_t) count > length) {
+        *outBytes = 1;
+        return lead;
+    }
+
+    int codepoint = lead & (0x7F >> count);
+    for (int i = 1; i < count; i++) {
+        if ((text[i] & 0xC0) != 0x80) {
+            *outBytes = 1;
+            return lead;
+        }
+        codepoint = (codepoint << 6) | (text[i] & 0x3F);
+    }
+    *outBytes = count;
+    return codepoint;
+}
+
+static Bool IsCjkCodepoint(int codepoint) {
+    return (codepoint >= 0x3040 && codepoint <= 0x30FF) || // kana
+           (codepoint >= 0x3400 && codepoint <= 0x4DBF) || // CJK extension A
+           (codepoint >= 0x4E00 && codepoint <= 0x9FFF) || // CJK unified ideographs
+           (codepoint >= 0xAC00 && codepoint <= 0xD7AF) || // hangul syllables
+           (codepoint >= 0xF900 && codepoint <= 0xFAFF);   // CJK compatibility ideographs
+}
+
+static Bool IsWordByte(unsigned char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static void PushToken(SearchToken* tokens, int* count, int maxTokens, const char* text, int length, Bool prefix) {
+    if (*count >= maxTokens) return;
+    SearchToken* token = &tokens[(*count)++];
+    token->length = length < SEARCH_MAX_TOKEN_LENGTH ? length : SEARCH_MAX_TOKEN_LENGTH;
+    memcpy(token->text, text, token->length);
+    token->prefix = prefix;
+}
+
+int TokenizeSearchQuery(const char* query, size_t length, SearchToken* outTokens, int maxTokens) {
+    const unsigned char* text = (const unsigned char*) query;
+    int count = 0;
+    size_t i = 0;
+
+    while (i < length) {
+        if (IsWordByte(text[i])) {
+            char word[SEARCH_MAX_TOKEN_LENGTH];
+            int wordLength = 0;
+            for (; i < length && IsWordByte(text[i]); i++) {
+                if (wordLength < SEARCH_MAX_TOKEN_LENGTH) {
+                    word[wordLength++] = (char) (text[i] >= 'A' && text[i] <= 'Z' ? text[i] + 32 : text[i]);
+                }
+            }
+            // the word at the very end may be only partly typed
+            PushToken(outTokens, &count, maxTokens, word, wordLength, i == length);
+            continue;
+        }
+
+        int bytes;
+        int codepoint = DecodeUtf8(text + i, length - i, &bytes);
+        if (!IsCjkCodepoint(codepoint)) {
+            i += bytes;
+            continue;
+        }
+
+        // a run of CJK characters becomes its bigrams, matching how the index was built
+        size_t runStart = i;
+        size_t previous = i;
+        int runLength = 0;
+        while (i < length) {
+            int nextBytes;
+            if (!IsCjkCodepoint(DecodeUtf8(text + i, length - i, &nextBytes))) break;
+            if (runLength > 0) {
+                PushToken(outTokens, &count, maxTokens, query + previous, (int) (i + nextBytes - previous), FALSE);
+            }
+            previous = i;
+            i += nextBytes;
+            runLength++;
+        }
+        if (runLength == 1) {
+            // a single character is matched against every bigram it starts
+            PushToken(outTokens, &count, maxTokens, query + runStart, (int) (i - runStart), TRUE);
+        }
+    }
+
+    return count;
+}
+
+static SearchTermRecord GetTerm(const SearchIndex* index, int i) {
+    SearchTermRecord term;
+    memcpy(&term, index->terms + (size_t) i * sizeof(SearchTermRecord), sizeof(term));
+    return term;
+}
+
+Bool LoadSearchIndex(unsigned char* blob, size_t length, SearchIndex* outIndex) {
+    SearchIndexHeader header;
+    if (length < sizeof(header)) {
+        printf("Search index too short\n");
+        return FALSE;
+    }
+    memcpy(&header, blob, sizeof(header));
+
+    if (memcmp(header.magic, SEARCH_INDEX_MAGIC, 4) != 0 || header.headerSize != sizeof(header)) {
+        printf("Not a search index\n");
+        return FALSE;
+    }
+    if (header.version != SEARCH_INDEX_VERSION) {
+        printf("Search index version %d, expected %d\n", header.version, SEARCH_INDEX_VERSION);
+        return FALSE;
+    }
+    uint64_t expected = sizeof(header) + (uint64_t) header.termCount * sizeof(SearchTermRecord) +
+                        header.stringPoolSize + header.postingsSize;
+    if (expected != length) {
+        printf("Search index size mismatch\n");
+        return FALSE;
+    }
+    if (HashBytes(blob + sizeof(header), length - sizeof(header)) != header.checksum) {
+        printf("Search index checksum mismatch\n");
+        return FALSE;
+    }
+
+    SearchIndex index = {
+            .blob = blob,
+            .length = length,
+            .terms = blob + sizeof(header),
+            .documentCount = (int) header.documentCount,
+            .termCount = (int) header.termCount,
+            .stringPoolSize = header.stringPoolSize,
+            .postingsSize = header.postingsSize,
+    };
+    index.strings = (const char*) index.terms + (size_t) header.termCount * sizeof(SearchTermRecord);
+    index.postings = (const unsigned char*) index.strings + header.stringPoolSize;
+
+    // postings are still bounds checked while decoding, only the term strings have to be sound for the binary search
+    for (int i = 0; i < index.termCount; i++) {
+        SearchTermRecord term = GetTerm(&index, i);
+        if ((uint64_t) term.stringOffset + term.length > header.stringPoolSize || term.postingOffset >= header.postingsSize) {
+            printf("Search index term %d is malformed\n", i);
+            return FALSE;
+        }
+    }
+
+    index.scratch = (uint8_t*) malloc(index.documentCount ? index.documentCount : 1);
+    *outIndex = index;
+    return TRUE;
+}
+
+void FreeSearchIndex(SearchIndex* index) {
+    free(index->blob);
+    free(index->scratch);
+    memset(index, 0, sizeof(*index));
+}
+
+static int CompareTerm(const SearchIndex* index, const SearchTermRecord* term, const SearchToken* token, Bool prefix) {
+    int length = term->length;
+    if (prefix && length > token->length) {
+        length = token->length;
+    }
+    int common = length < token->length ? length : token->length;
+    int order = memcmp(index->strings + term->stringOffset, token->text, common);
+    if (order != 0) return order;
+    return length - token->length;
+}
+
+static void MarkPostings(const SearchIndex* index, const SearchTermRecord* term) {
+    const unsigned char* p = index->postings + term->postingOffset;
+    const unsigned char* end = index->postings + index->postingsSize;
+    uint32_t document = 0;
+
+    for (uint32_t n = 0; n < term->documentFrequency; n++) {
+        uint32_t value = 0;
+        int shift = 0;
+        while (p < end && shift < 32) {
+            unsigned char byte = *p++;
+            value |= (uint32_t) (byte & 0x7F) << shift;
+            shift += 7;
+            if (!(byte & 0x80)) break;
+        }
+
+        document = n == 0 ? value : document + value;
+        if (document >= (uint32_t) index->documentCount) return;
+        index->scratch[document] = 1;
+    }
+}
+
+// Marks in scratch the documents holding the token, or any term it starts when it's a prefix
+static void MatchToken(const SearchIndex* index, const SearchToken* token) {
+    memset(index->scratch, 0, index->documentCount);
+
+    // first term not ordered before the token; with a prefix, every term it starts follows in a row
+    int lo = 0;
+    int hi = index->termCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        SearchTermRecord term = GetTerm(index, mid);
+        if (CompareTerm(index, &term, token, token->prefix) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (int i = lo; i < index->termCount; i++) {
+        SearchTermRecord term = GetTerm(index, i);
+        if (CompareTerm(index, &term, token, token->prefix) != 0) break;
+        MarkPostings(index, &term);
+    }
+}
+
+int QuerySearchIndex(SearchIndex* index, const char* query, uint8_t* outMatches) {
+    SearchToken tokens[SEARCH_MAX_QUERY_TOKENS];
+    int tokenCount = TokenizeSearchQuery(query, strlen(query), tokens, SEARCH_MAX_QUERY_TOKENS);
+    if (tokenCount == 0) {
+        return -1;
+    }
+
+    memset(outMatches, 1, index->documentCount);
+    for (int t = 0; t < tokenCount; t++) {
+        MatchToken(index, &tokens[t]);
+        for (int d = 0; d < index->documentCount; d++) {
+            outMatches[d] &= index->scratch[d];
+        }
+    }
+
+    int matches = 0;
+    for (int d = 0; d < index->documentCount; d++) {
+        matches += outMatches[d];
+    }
+    return matches;
+}
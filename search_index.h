@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "util.h"
+
+// Inverted index over every post, written by gen_archive_list.py next to the archive manifest; document i is entry i
+// there.
+// Layout (little endian): header, term records sorted by their bytes, term string pool, posting lists. Each posting
+// list is the ascending document ids as LEB128 varints, the first one as is and the rest as deltas.
+// Bump the version whenever the format or the tokenizer (kept in step with the python one) changes.
+#define SEARCH_INDEX_MAGIC "BSIX"
+#define SEARCH_INDEX_VERSION 1
+
+// Latin words are cut to this many bytes, in the index and in queries alike
+#define SEARCH_MAX_TOKEN_LENGTH 32
+#define SEARCH_MAX_QUERY_TOKENS 32
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t documentCount;
+    uint32_t termCount;
+    uint32_t stringPoolSize;
+    uint32_t postingsSize;
+    uint64_t checksum; // HashBytes over everything after the header
+} SearchIndexHeader;
+
+typedef struct {
+    uint32_t stringOffset;
+    uint16_t length;
+    uint16_t reserved;
+    uint32_t postingOffset;    // into the posting lists
+    uint32_t documentFrequency; // number of ids in the list
+} SearchTermRecord;
+
+typedef struct {
+    unsigned char* blob;
+    size_t length;
+
+    const unsigned char* terms;
+    const char* strings;
+    const unsigned char* postings;
+    int documentCount;
+    int termCount;
+    uint32_t stringPoolSize;
+    uint32_t postingsSize;
+
+    uint8_t* scratch; // documents matched by the token being looked up
+} SearchIndex;
+
+// A query word: lowercase ASCII letters and digits, or one or two CJK characters
+typedef struct {
+    char text[SEARCH_MAX_TOKEN_LENGTH];
+    int length;
+    Bool prefix; // still being typed (or a lone CJK character), so it matches every term it starts
+} SearchToken;
+
+// Latin text splits into lowercase words, runs of CJK into overlapping character bigrams (a lone character stays a
+// unigram); anything else separates tokens. Returns the number of tokens written.
+int TokenizeSearchQuery(const char* query, size_t length, SearchToken* outTokens, int maxTokens);
+
+// Validates the blob and takes ownership of it on success; on failure the caller still owns it
+Bool LoadSearchIndex(unsigned char* blob, size_t length, SearchIndex* outIndex);
+void FreeSearchIndex(SearchIndex* index);
+
+// Sets outMatches[d] (documentCount entries) for every document holding all of the query's tokens and returns how
+// many do, or -1 if the query has no tokens at all and nothing should be filtered
+int QuerySearchIndex(SearchIndex* index, const char* query, uint8_t* outMatches);
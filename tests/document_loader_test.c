@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "document_loader.h"
+#include "util.h"
+
+// Drives the file-backed document loader the way main.c drives the fetch one: requests for display and prefetch,
+// deduplication, the prefetch cap, cancellation, and delivery on poll, both whole and streamed a piece at a time.
+//
+// usage: burogu_loader_test <directory with the posts, ending in '/'>
+
+static int failures = 0;
+
+#define CHECK(condition)                                                          \
+    do {                                                                          \
+        if (!(condition)) {                                                       \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            failures++;                                                           \
+        }                                                                         \
+    } while (0)
+
+static DocumentLoader loader;
+
+typedef struct {
+    int requestId;
+    char* path;
+    int chunkCount;
+    LoadPurpose purpose;
+    char* content; // NULL when the load failed
+    size_t length;
+    Bool ended;
+} Delivery;
+
+static Delivery deliveries[DOCUMENT_LOADER_MAX_LOADS * 2];
+static int deliveryCount = 0;
+
+static Delivery* FindDelivery(int requestId) {
+    for (int i = 0; i < deliveryCount; i++) {
+        if (deliveries[i].requestId == requestId) {
+            return &deliveries[i];
+        }
+    }
+    return NULL;
+}
+
+static void ClearDeliveries() {
+    for (int i = 0; i < deliveryCount; i++) {
+        free(deliveries[i].path);
+        free(deliveries[i].content);
+    }
+    memset(deliveries, 0, sizeof(deliveries));
+    deliveryCount = 0;
+}
+
+static void OnLoaded(int requestId, char* content, size_t length) {
+    DocumentLoad load;
+    if (!FinishDocumentLoad(&loader, requestId, &load)) {
+        // cancelled while it was on its way
+        free(content);
+        return;
+    }
+
+    deliveries[deliveryCount++] = (Delivery){
+            .requestId = requestId,
+            .path = load.path,
+            .purpose = load.purpose,
+            .content = content,
+            .length = length,
+            .ended = TRUE,
+    };
+}
+
+static void OnChunk(int requestId, const char* bytes, size_t length) {
+    const DocumentLoad* load = PeekDocumentLoad(&loader, requestId);
+    CHECK(load != NULL);
+    if (!load) return;
+
+    Delivery* delivery = FindDelivery(requestId);
+    if (!delivery) {
+        delivery = &deliveries[deliveryCount++];
+        *delivery = (Delivery){.requestId = requestId, .path = strdup(load->path), .purpose = load->purpose};
+    }
+    delivery->content = (char*) realloc(delivery->content, delivery->length + length + 1);
+    memcpy(delivery->content + delivery->length, bytes, length);
+    delivery->length += length;
+    delivery->content[delivery->length] = '\0';
+    delivery->chunkCount++;
+}
+
+static void OnStreamEnd(int requestId, Bool ok) {
+    DocumentLoad load;
+    if (!FinishDocumentLoad(&loader, requestId, &load)) {
+        return;
+    }
+
+    Delivery* delivery = FindDelivery(requestId);
+    if (!delivery) {
+        // nothing arrived: an empty file, or one that couldn't be opened
+        delivery = &deliveries[deliveryCount++];
+        *delivery = (Delivery){.requestId = requestId, .path = strdup(load.path), .purpose = load.purpose};
+    }
+    if (!ok) {
+        free(delivery->content);
+        delivery->content = NULL;
+        delivery->length = 0;
+    }
+    delivery->ended = TRUE;
+    free(load.path);
+}
+
+static char* ReadExpected(const char* root, const char* path, size_t* outLength) {
+    char fullPath[1024];
+    snprintf(fullPath, sizeof(fullPath), "%s%s", root, path);
+    FILE* file = fopen(fullPath, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* buffer = (char*) malloc(fileSize + 1);
+    size_t read = fread(buffer, 1, fileSize, file);
+    buffer[read] = '\0';
+    *outLength = read;
+    fclose(file);
+    return buffer;
+}
+
+static void CheckDeliveredFile(const char* root, const Delivery* delivery) {
+    CHECK(delivery != NULL);
+    if (!delivery) return;
+
+    size_t length = 0;
+    char* expected = ReadExpected(root, delivery->path, &length);
+    CHECK(expected != NULL);
+    CHECK(delivery->ended);
+    CHECK(delivery->content != NULL);
+    if (expected && delivery->content) {
+        CHECK(delivery->length == length);
+        CHECK(delivery->length == length && memcmp(delivery->content, expected, length) == 0);
+    }
+    free(expected);
+}
+
+static void PollUntilIdle() {
+    // every load is read within a bounded number of polls, or the backend is stuck
+    for (int i = 0; i < 64; i++) {
+        Bool pending = FALSE;
+        for (int l = 0; l < DOCUMENT_LOADER_MAX_LOADS; l++) {
+            pending |= loader.loads[l].id != 0;
+        }
+        if (!pending) return;
+        PollDocumentLoader(&loader);
+    }
+    CHECK(!"loads still pending after 64 polls");
+}
+
+static void TestRequests(const char* root) {
+    InitDocumentLoader(&loader, GetFileLoaderBackend(), OnLoaded);
+    loader.fileRoot = root;
+
+    // the same path is only requested once
+    int headings = RequestDocumentLoad(&loader, "headings.md", LOAD_PURPOSE_PREFETCH);
+    CHECK(headings != 0);
+    CHECK(RequestDocumentLoad(&loader, "headings.md", LOAD_PURPOSE_PREFETCH) == headings);
+    CHECK(IsDocumentLoadPending(&loader, "headings.md"));
+
+    // prefetches are capped, a click never is
+    int lists = RequestDocumentLoad(&loader, "lists.md", LOAD_PURPOSE_PREFETCH);
+    CHECK(lists != 0 && lists != headings);
+    CHECK(RequestDocumentLoad(&loader, "code.md", LOAD_PURPOSE_PREFETCH) == 0);
+    CHECK(!IsDocumentLoadPending(&loader, "code.md"));
+
+    // a cancelled prefetch frees its place and is never delivered
+    CancelDocumentPrefetch(&loader, "lists.md");
+    CHECK(!IsDocumentLoadPending(&loader, "lists.md"));
+    CHECK(PeekDocumentLoad(&loader, lists) == NULL);
+
+    // displaying a path in flight upgrades the load instead of starting another
+    CHECK(RequestDocumentLoad(&loader, "headings.md", LOAD_PURPOSE_DISPLAY) == headings);
+    CHECK(PeekDocumentLoad(&loader, headings)->purpose == LOAD_PURPOSE_DISPLAY);
+    CancelDocumentPrefetch(&loader, "headings.md");
+    CHECK(IsDocumentLoadPending(&loader, "headings.md"));
+
+    // a newer click turns the older one into a prefetch
+    int code = RequestDocumentLoad(&loader, "code.md", LOAD_PURPOSE_DISPLAY);
+    CHECK(code != 0);
+    CHECK(PeekDocumentLoad(&loader, headings)->purpose == LOAD_PURPOSE_PREFETCH);
+    CHECK(PeekDocumentLoad(&loader, code)->purpose == LOAD_PURPOSE_DISPLAY);
+
+    int missing = RequestDocumentLoad(&loader, "no-such-post.md", LOAD_PURPOSE_PREFETCH);
+    CHECK(missing != 0);
+
+    // nothing arrives before the first poll, like fetch; then one load per poll
+    CHECK(deliveryCount == 0);
+    PollDocumentLoader(&loader);
+    CHECK(deliveryCount == 1);
+    PollUntilIdle();
+    CHECK(deliveryCount == 3);
+
+    CheckDeliveredFile(root, FindDelivery(headings));
+    CheckDeliveredFile(root, FindDelivery(code));
+    CHECK(FindDelivery(lists) == NULL);
+    CHECK(FindDelivery(missing) != NULL && FindDelivery(missing)->content == NULL);
+    CHECK(!IsDocumentLoadPending(&loader, "headings.md"));
+
+    // once finished, the path can be requested again
+    int again = RequestDocumentLoad(&loader, "headings.md", LOAD_PURPOSE_PREFETCH);
+    CHECK(again != 0 && again != headings);
+    PollUntilIdle();
+    CheckDeliveredFile(root, FindDelivery(again));
+
+    ClearDeliveries();
+}
+
+static void TestStreaming(const char* root) {
+    InitDocumentLoader(&loader, GetFileLoaderBackend(), OnLoaded);
+    loader.fileRoot = root;
+    loader.onChunk = OnChunk;
+    loader.onStreamEnd = OnStreamEnd;
+
+    int prefetch = RequestDocumentLoad(&loader, "long.md", LOAD_PURPOSE_PREFETCH);
+    int display = RequestDocumentLoad(&loader, "mixed.md", LOAD_PURPOSE_DISPLAY);
+    int missing = RequestDocumentLoad(&loader, "no-such-post.md", LOAD_PURPOSE_PREFETCH);
+    CHECK(prefetch != 0 && display != 0 && missing != 0);
+
+    // the load being waited for is read ahead of the prefetches
+    PollDocumentLoader(&loader);
+    CHECK(deliveryCount == 1 && deliveries[0].requestId == display);
+
+    // a prefetch cancelled halfway through stops getting pieces
+    int cancelled = RequestDocumentLoad(&loader, "cjk.md", LOAD_PURPOSE_PREFETCH);
+    CHECK(cancelled == 0); // two prefetches already in flight
+    CancelDocumentPrefetch(&loader, "no-such-post.md");
+    cancelled = RequestDocumentLoad(&loader, "cjk.md", LOAD_PURPOSE_PREFETCH);
+    CHECK(cancelled != 0);
+    CancelDocumentPrefetch(&loader, "cjk.md");
+
+    PollUntilIdle();
+    CheckDeliveredFile(root, FindDelivery(display));
+    CheckDeliveredFile(root, FindDelivery(prefetch));
+    CHECK(FindDelivery(missing) == NULL);
+    CHECK(FindDelivery(cancelled) == NULL);
+
+    ClearDeliveries();
+}
+
+static void TestStreamingPieces() {
+    // larger than the first piece, so it arrives over several polls in growing pieces
+    const char* path = "burogu_loader_test.tmp";
+    size_t length = DOCUMENT_LOADER_FIRST_PIECE * 3 + 17;
+    FILE* file = fopen(path, "wb");
+    CHECK(file != NULL);
+    if (!file) return;
+    for (size_t i = 0; i < length; i++) {
+        fputc('a' + (int) (i % 23), file);
+    }
+    fclose(file);
+
+    InitDocumentLoader(&loader, GetFileLoaderBackend(), OnLoaded);
+    loader.fileRoot = "";
+    loader.onChunk = OnChunk;
+    loader.onStreamEnd = OnStreamEnd;
+
+    int request = RequestDocumentLoad(&loader, path, LOAD_PURPOSE_DISPLAY);
+    PollDocumentLoader(&loader);
+    Delivery* delivery = FindDelivery(request);
+    CHECK(delivery != NULL && delivery->length == DOCUMENT_LOADER_FIRST_PIECE && !delivery->ended);
+
+    PollUntilIdle();
+    CheckDeliveredFile("", FindDelivery(request));
+    // 64K, 128K, then the rest
+    CHECK(FindDelivery(request) && FindDelivery(request)->chunkCount == 3);
+
+    ClearDeliveries();
+    remove(path);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        printf("usage: %s <directory with the posts, ending in '/'>\n", argv[0]);
+        return 1;
+    }
+
+    TestRequests(argv[1]);
+    TestStreaming(argv[1]);
+    TestStreamingPieces();
+
+    if (failures > 0) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("document loader: all checks passed\n");
+    return 0;
+}
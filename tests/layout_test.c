@@ -0,0 +1,431 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <clay.h>
+
+#include "util.h"
+
+// the viewer itself, so the test lays out the same root container; its entry point is never called
+#define main BuroguViewerMain
+#include "main.c"
+#undef main
+
+// Layout regression test: loads one corpus post headlessly the way the native viewer does (the file loader streams
+// it into a MarkdownStream), lays out the viewer's whole window (MainContainer, sidebar included) at one viewport
+// size, and checks the render commands' bounding boxes against a checked-in snapshot. Fonts are fixed-metric
+// stand-ins for the canvas atlases, so positions don't depend on the machine. The snapshot also keeps the layout
+// time it was recorded with; running more than --time-threshold times slower than that fails, so on a machine other
+// than the one that recorded the snapshots the threshold wants raising, or 0 to skip the check.
+//
+// usage: burogu_layout_test <post.md> <snapshot> [--width W] [--height H] [--time-threshold RATIO] [--update]
+// A missing snapshot fails the run; --update (or BUROGU_UPDATE_SNAPSHOTS=1) records or rewrites it.
+
+#define LAYOUT_TEST_CJK_BASE 0x4E00
+#define LAYOUT_TEST_CJK_END 0xA000
+
+// frames the virtualized layout gets to replace its height estimates with measured ones before it has to be stable
+#define LAYOUT_TEST_MAX_SETTLE_FRAMES 8
+// steady-state frames timed after that, the median is what's compared
+#define LAYOUT_TEST_TIMED_FRAMES 31
+// slower than baseline * ratio + this many ms fails, so sub-millisecond posts don't trip over timer noise
+#define LAYOUT_TEST_TIME_SLACK_MS 0.25
+// generous, scheduling noise on a busy machine shouldn't fail the suite
+#define LAYOUT_TEST_DEFAULT_TIME_THRESHOLD 2.0
+
+static double NowMilliseconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static char* ReadTextFile(const char* path, size_t* outLength) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buffer = (char*) malloc(fileSize + 1);
+    size_t read = fread(buffer, 1, fileSize, file);
+    buffer[read] = '\0';
+    *outLength = read;
+
+    fclose(file);
+    return buffer;
+}
+
+/* ---------- fonts ---------- */
+
+static void LoadTestFonts() {
+    int* codepoints;
+    DYNARRAY_INIT(codepoints, LAYOUT_TEST_CJK_END - LAYOUT_TEST_CJK_BASE + 512);
+    for (int cp = 32; cp < 127; cp++) DYNARRAY_PUSHBACK(codepoints, cp);
+    for (int cp = 0x3000; cp < 0x3040; cp++) DYNARRAY_PUSHBACK(codepoints, cp);
+    for (int cp = LAYOUT_TEST_CJK_BASE; cp < LAYOUT_TEST_CJK_END; cp++) DYNARRAY_PUSHBACK(codepoints, cp);
+    for (int cp = 0xFF00; cp < 0xFF5F; cp++) DYNARRAY_PUSHBACK(codepoints, cp);
+
+    // like the viewer's distance field faces: one per family, weight and style at SDF_TEXT_BASE_SIZE, which the big
+    // slots share with the normal ones and every text size scales from
+    int normalIds[] = {ZHCN_FONT_NORMAL, ZHCN_FONT_NORMAL_BOLD, ZHCN_FONT_NORMAL_ITALIC, ZHCN_FONT_NORMAL_BOLD_ITALIC};
+    int bigIds[] = {ZHCN_FONT_BIG, ZHCN_FONT_BIG_BOLD, ZHCN_FONT_BIG_ITALIC, ZHCN_FONT_BIG_BOLD_ITALIC};
+    for (int i = 0; i < 4; i++) {
+        embeddedFonts[normalIds[i]] = LoadFixedMetricFont(SDF_TEXT_BASE_SIZE, codepoints, DYNARRAY_SIZE(codepoints));
+        embeddedFonts[bigIds[i]] = ShareFontAtlasFace(&embeddedFonts[normalIds[i]]);
+    }
+    embeddedFonts[CODE_FONT_MONOSPACE] = LoadFixedMetricFont(SDF_TEXT_BASE_SIZE, codepoints, DYNARRAY_SIZE(codepoints));
+
+    DYNARRAY_FREE(codepoints);
+}
+
+static void UnloadTestFonts() {
+    for (int i = 0; i < 16; i++) {
+        if (embeddedFonts[i].font.glyphs) {
+            UnloadFontAtlas(&embeddedFonts[i]);
+        }
+    }
+}
+
+/* ---------- viewer ---------- */
+
+// the sidebar's rows: the corpus posts in a fixed order, so adding a post doesn't move every other snapshot
+static const char* const corpusPosts[] = {"headings", "lists", "code", "cjk", "mixed", "long"};
+
+static void LoadTestArchiveList(const char* postFile) {
+    InitArchiveList(&archiveList);
+    for (int i = 0; i < (int) (sizeof(corpusPosts) / sizeof(corpusPosts[0])); i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s.md", corpusPosts[i]);
+        AddArchiveEntry(corpusPosts[i], path);
+        if (strcmp(path, postFile) == 0) {
+            archiveList.activeIndex = i;
+        }
+    }
+}
+
+// Opens the post as if its row had been clicked: requested for display, streamed in by the file loader and parsed
+// as it arrives; NULL if it never made it on screen
+static MarkdownDocument* LoadTestDocument(const char* postPath) {
+    const char* slash = strrchr(postPath, '/');
+    const char* postFile = slash ? slash + 1 : postPath;
+    // the loader keeps the pointer
+    static char root[1024];
+    snprintf(root, sizeof(root), "%.*s", slash ? (int) (slash + 1 - postPath) : 0, postPath);
+
+    InitDocumentCache(&documentCache, DOCUMENT_CACHE_DEFAULT_BUDGET);
+    InitDocumentLoader(&documentLoader, GetFileLoaderBackend(), OnFileLoaded);
+    documentLoader.fileRoot = root;
+    documentLoader.onChunk = OnFileChunk;
+    documentLoader.onStreamEnd = OnFileStreamEnd;
+    parseThreadCount = GetDefaultParseThreadCount();
+
+    LoadTestArchiveList(postFile);
+    RequireMarkdownReparse(postFile);
+
+    // a piece per poll, so this is bounded by the post's size
+    for (int i = 0; i < 64 && pendingDocumentPath; i++) {
+        PollDocumentLoader(&documentLoader);
+    }
+    return pendingDocumentPath ? NULL : currentDocument;
+}
+
+static void UnloadTestDocument() {
+    currentDocument = NULL;
+    needsParse = 1;
+    FreeDocumentCache(&documentCache);
+    FreeArchiveList(&archiveList);
+}
+
+/* ---------- clay ---------- */
+
+static void* clayMemory = NULL;
+static Bool clayFailed = FALSE;
+
+static void HandleTestClayError(Clay_ErrorData errorData) {
+    fprintf(stderr, "Clay error: %.*s\n", errorData.errorText.length, errorData.errorText.chars);
+    clayFailed = TRUE;
+}
+
+static void InitClay(int commandCount, float width, float height) {
+    // every command may become an element, and clay splits text into words for measuring
+    Clay_SetMaxElementCount(commandCount + 1024);
+    Clay_SetMaxMeasureTextCacheWordCount(commandCount * 16 + 16384);
+
+    uint64_t clayMemorySize = Clay_MinMemorySize();
+    clayMemory = malloc(clayMemorySize);
+
+    Clay_Arena arena = Clay_CreateArenaWithCapacityAndMemory(clayMemorySize, clayMemory);
+    Clay_Initialize(arena, (Clay_Dimensions){width, height}, (Clay_ErrorHandler){HandleTestClayError});
+    Clay_SetMeasureTextFunction(Raylib_MeasureText, embeddedFonts);
+}
+
+// What MainLoop lays out, with the pointer outside the window so nothing is hovered
+static Clay_RenderCommandArray LayoutFrame() {
+    hoveredArchiveIndex = -1;
+    Clay_SetPointerState((Clay_Vector2){-1.0f, -1.0f}, FALSE);
+    Clay_UpdateScrollContainers(FALSE, (Clay_Vector2){0.0f, 0.0f}, 0.0f);
+
+    Clay_BeginLayout();
+    MainContainer();
+    return Clay_EndLayout();
+}
+
+/* ---------- snapshots ---------- */
+
+static const char* const renderCommandTypeNames[] = {
+        "none",
+        "rectangle",
+        "border",
+        "text",
+        "image",
+        "scissor-start",
+        "scissor-end",
+        "custom",
+};
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} SnapshotText;
+
+static void AppendSnapshot(SnapshotText* text, const char* line) {
+    size_t length = strlen(line);
+    if (text->length + length + 1 > text->capacity) {
+        while (text->length + length + 1 > text->capacity) {
+            text->capacity = text->capacity ? text->capacity * 2 : 4096;
+        }
+        text->data = (char*) realloc(text->data, text->capacity);
+    }
+    memcpy(text->data + text->length, line, length + 1);
+    text->length += length;
+}
+
+// One line per render command; two decimals, so a change has to move something by at least a hundredth of a pixel
+static SnapshotText FormatRenderCommands(Clay_RenderCommandArray renderCommands) {
+    SnapshotText text = {0};
+    AppendSnapshot(&text, "");
+    for (int i = 0; i < renderCommands.length; i++) {
+        Clay_RenderCommand* command = Clay_RenderCommandArray_Get(&renderCommands, i);
+        Clay_BoundingBox box = command->boundingBox;
+        int type = command->commandType;
+
+        char line[160];
+        snprintf(line, sizeof(line), "%d %s %.2f %.2f %.2f %.2f\n", i,
+                 type < (int) (sizeof(renderCommandTypeNames) / sizeof(renderCommandTypeNames[0])) ? renderCommandTypeNames[type] : "unknown",
+                 box.x, box.y, box.width, box.height);
+        AppendSnapshot(&text, line);
+    }
+    return text;
+}
+
+// Splits a snapshot file into the layout time it was recorded with and the render commands after the header
+static const char* ParseSnapshot(const char* snapshot, double* outLayoutMs) {
+    *outLayoutMs = 0.0;
+    const char* line = snapshot;
+    while (*line == '#' || strncmp(line, "layout_ms ", 10) == 0) {
+        if (*line != '#') {
+            *outLayoutMs = strtod(line + 10, NULL);
+        }
+        const char* next = strchr(line, '\n');
+        if (!next) return line + strlen(line);
+        line = next + 1;
+    }
+    return line;
+}
+
+static void PrintSnapshotLine(const char* label, const char* line, size_t length, const char* pastEnd) {
+    if (*line) {
+        printf("  %-9s %.*s\n", label, (int) length, line);
+    } else {
+        printf("  %-9s %s\n", label, pastEnd);
+    }
+}
+
+// Prints the first line the two differ on; TRUE if they're the same
+static Bool CompareSnapshotLines(const char* expected, const char* actual) {
+    int lineNumber = 1;
+    while (*expected || *actual) {
+        size_t expectedLength = strcspn(expected, "\n");
+        size_t actualLength = strcspn(actual, "\n");
+        if (expectedLength != actualLength || memcmp(expected, actual, expectedLength) != 0) {
+            printf("first difference at render command line %d:\n", lineNumber);
+            PrintSnapshotLine("expected", expected, expectedLength, "(end of snapshot)");
+            PrintSnapshotLine("actual", actual, actualLength, "(end of layout)");
+            return FALSE;
+        }
+        expected += expectedLength + (expected[expectedLength] == '\n');
+        actual += actualLength + (actual[actualLength] == '\n');
+        lineNumber++;
+    }
+    return TRUE;
+}
+
+static Bool WriteSnapshot(const char* path, const char* postPath, float width, float height, double layoutMs, const SnapshotText* commands) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        printf("Failed to write snapshot: %s\n", path);
+        return FALSE;
+    }
+
+    const char* postName = strrchr(postPath, '/');
+    fprintf(file, "# burogu layout snapshot: %s at %.0fx%.0f\n", postName ? postName + 1 : postPath, width, height);
+    fprintf(file, "# regenerate with `cmake --build <build> --target burogu_layout_snapshots` after an intended change\n");
+    fprintf(file, "layout_ms %.4f\n", layoutMs);
+    fwrite(commands->data, 1, commands->length, file);
+    fclose(file);
+    return TRUE;
+}
+
+/* ---------- runner ---------- */
+
+typedef struct {
+    const char* postPath;
+    const char* snapshotPath;
+    float width;
+    float height;
+    double timeThreshold; // allowed ratio over the recorded layout time, 0 skips the timing check
+    Bool update;
+} LayoutTestOptions;
+
+static int CompareDoubles(const void* a, const void* b) {
+    double x = *(const double*) a;
+    double y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+static int RunLayoutTest(const LayoutTestOptions* options) {
+    const MarkdownDocument* document = LoadTestDocument(options->postPath);
+    if (!document) {
+        printf("Failed to load markdown file: %s\n", options->postPath);
+        UnloadTestDocument();
+        return 1;
+    }
+    if (document->commandCount == 0) {
+        printf("%s: parsing produced no commands\n", options->postPath);
+        UnloadTestDocument();
+        return 1;
+    }
+
+    InitClay(document->commandCount, options->width, options->height);
+
+    // blocks start out with estimated heights and pick up measured ones a frame later, so lay out until two frames
+    // in a row agree
+    SnapshotText previous = {0};
+    SnapshotText current = {0};
+    int frame = 0;
+    for (; frame < LAYOUT_TEST_MAX_SETTLE_FRAMES; frame++) {
+        free(previous.data);
+        previous = current;
+        current = FormatRenderCommands(LayoutFrame());
+        if (previous.data && strcmp(previous.data, current.data) == 0) break;
+    }
+    free(previous.data);
+
+    int result = 0;
+    if (clayFailed) {
+        result = 1;
+    } else if (frame == LAYOUT_TEST_MAX_SETTLE_FRAMES) {
+        printf("layout still changing after %d frames\n", LAYOUT_TEST_MAX_SETTLE_FRAMES);
+        result = 1;
+    }
+
+    double frameMs[LAYOUT_TEST_TIMED_FRAMES];
+    for (int i = 0; i < LAYOUT_TEST_TIMED_FRAMES; i++) {
+        double start = NowMilliseconds();
+        LayoutFrame();
+        frameMs[i] = NowMilliseconds() - start;
+    }
+    qsort(frameMs, LAYOUT_TEST_TIMED_FRAMES, sizeof(double), CompareDoubles);
+    double layoutMs = frameMs[LAYOUT_TEST_TIMED_FRAMES / 2];
+
+    size_t snapshotLength = 0;
+    char* snapshot = ReadTextFile(options->snapshotPath, &snapshotLength);
+    if (result == 0 && !options->update && !snapshot) {
+        printf("%s: no snapshot, record it with --update or BUROGU_UPDATE_SNAPSHOTS=1\n", options->snapshotPath);
+        result = 1;
+    } else if (result == 0 && options->update) {
+        if (!WriteSnapshot(options->snapshotPath, options->postPath, options->width, options->height, layoutMs, &current)) {
+            result = 1;
+        } else {
+            printf("%s: %s snapshot, layout %.3f ms\n", options->snapshotPath, snapshot ? "updated" : "recorded new", layoutMs);
+        }
+    } else if (result == 0) {
+        double baselineMs = 0.0;
+        const char* expected = ParseSnapshot(snapshot, &baselineMs);
+        if (!CompareSnapshotLines(expected, current.data)) {
+            printf("%s: element positions changed at %.0fx%.0f\n", options->postPath, options->width, options->height);
+            result = 1;
+        }
+
+        double limitMs = baselineMs * options->timeThreshold + LAYOUT_TEST_TIME_SLACK_MS;
+        if (options->timeThreshold > 0.0) {
+            printf("layout %.3f ms (recorded %.3f ms, limit %.3f ms)\n", layoutMs, baselineMs, limitMs);
+        } else {
+            printf("layout %.3f ms (recorded %.3f ms, not checked)\n", layoutMs, baselineMs);
+        }
+        if (options->timeThreshold > 0.0 && baselineMs > 0.0 && layoutMs > limitMs) {
+            printf("%s: layout regressed from %.3f ms to %.3f ms at %.0fx%.0f\n", options->postPath, baselineMs, layoutMs,
+                   options->width, options->height);
+            result = 1;
+        }
+    }
+
+    free(snapshot);
+    free(current.data);
+    UnloadTestDocument();
+    return result;
+}
+
+static void PrintUsage(const char* program) {
+    printf("usage: %s <post.md> <snapshot> [--width W] [--height H] [--time-threshold RATIO] [--update]\n", program);
+    printf("  --time-threshold fails runs slower than RATIO times the recorded layout time (default 2, 0 disables)\n");
+    printf("  --update rewrites the snapshot instead of checking it, as does BUROGU_UPDATE_SNAPSHOTS=1\n");
+}
+
+int main(int argc, char** argv) {
+    const char* update = getenv("BUROGU_UPDATE_SNAPSHOTS");
+    LayoutTestOptions options = {
+            .width = 1280,
+            .height = 800,
+            .timeThreshold = LAYOUT_TEST_DEFAULT_TIME_THRESHOLD,
+            .update = update && strcmp(update, "0") != 0,
+    };
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            options.width = (float) atof(argv[++i]);
+        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            options.height = (float) atof(argv[++i]);
+        } else if (strcmp(argv[i], "--time-threshold") == 0 && i + 1 < argc) {
+            options.timeThreshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--update") == 0) {
+            options.update = TRUE;
+        } else if (argv[i][0] != '-' && positional == 0) {
+            options.postPath = argv[i];
+            positional++;
+        } else if (argv[i][0] != '-' && positional == 1) {
+            options.snapshotPath = argv[i];
+            positional++;
+        } else {
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (positional != 2 || options.width <= 0 || options.height <= 0) {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    LoadTestFonts();
+    int result = RunLayoutTest(&options);
+    UnloadTestFonts();
+    free(clayMemory);
+    return result;
+}
@@ -0,0 +1,366 @@
+#include <math.h>
+#include <raylib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "font_bundle.h"
+
+// Bakes the embedded font atlases from TTF/OTF files, so the runtime loads one bundle instead of
+// rasterizing every face on a canvas at startup.
+//   burogu_bake_fonts <fonts.txt> <glyph_range.txt> <out.bundle>
+// fonts.txt has one face per line, `<slot> <size> <font file> [oblique] [sdf]`, paths relative to the manifest;
+// # starts a comment. `oblique` slants an upright face the way browsers synthesize italics, `sdf` stores distance
+// fields instead of coverage so the face can be drawn at any size.
+
+#define BAKE_GLYPH_PADDING 4
+// horizontal shift per pixel of height, same slant skia uses for fake italics
+#define BAKE_OBLIQUE_SLANT 0.25f
+
+typedef struct {
+    int fontId;
+    int fontSize;
+    Bool oblique;
+    Bool distanceField;
+    char path[1024];
+} FaceSpec;
+
+typedef struct {
+    FaceSpec spec;
+    GlyphInfo* glyphs;
+    Rectangle* recs;
+    int glyphCount;
+    Image atlas;
+} BakedFace;
+
+static unsigned char* ReadFile(const char* path, size_t* outLength) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    unsigned char* buffer = (unsigned char*) malloc(fileSize + 1);
+    size_t read = fread(buffer, 1, fileSize, file);
+    buffer[read] = '\0';
+    fclose(file);
+
+    *outLength = read;
+    return buffer;
+}
+
+static int ReadManifest(const char* manifestPath, FaceSpec* specs, int maxSpecs) {
+    FILE* file = fopen(manifestPath, "r");
+    if (!file) {
+        printf("Failed to open %s\n", manifestPath);
+        return -1;
+    }
+
+    // font paths are relative to the manifest
+    char directory[1024];
+    snprintf(directory, sizeof(directory), "%s", manifestPath);
+    char* slash = strrchr(directory, '/');
+    if (slash) {
+        slash[1] = '\0';
+    } else {
+        directory[0] = '\0';
+    }
+
+    int count = 0;
+    int lineNumber = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        int fontId, fontSize;
+        char fontFile[768];
+        char flags[2][16] = {"", ""};
+        int fields = sscanf(line, "%d %d %767s %15s %15s", &fontId, &fontSize, fontFile, flags[0], flags[1]);
+        if (fields <= 0) continue;
+
+        Bool oblique = FALSE;
+        Bool distanceField = FALSE;
+        Bool flagsValid = TRUE;
+        for (int f = 0; f < fields - 3; f++) {
+            if (strcmp(flags[f], "oblique") == 0) {
+                oblique = TRUE;
+            } else if (strcmp(flags[f], "sdf") == 0) {
+                distanceField = TRUE;
+            } else {
+                flagsValid = FALSE;
+            }
+        }
+
+        if (fields < 3 || fontId < 0 || fontId >= FONT_BUNDLE_MAX_FACES || fontSize <= 0 || !flagsValid) {
+            printf("%s:%d: expected `<slot> <size> <font file> [oblique] [sdf]`\n", manifestPath, lineNumber);
+            fclose(file);
+            return -1;
+        }
+        if (count == maxSpecs) {
+            printf("%s: more than %d faces\n", manifestPath, maxSpecs);
+            fclose(file);
+            return -1;
+        }
+
+        specs[count].fontId = fontId;
+        specs[count].fontSize = fontSize;
+        specs[count].oblique = oblique;
+        specs[count].distanceField = distanceField;
+        if (fontFile[0] == '/') {
+            snprintf(specs[count].path, sizeof(specs[count].path), "%s", fontFile);
+        } else {
+            snprintf(specs[count].path, sizeof(specs[count].path), "%s%s", directory, fontFile);
+        }
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+// Baseline measured off a glyph that sits on it, LoadFontData doesn't hand out the font's ascent
+static float FindBaseline(const GlyphInfo* glyphs, int glyphCount, int fontSize) {
+    const int probes[] = {'H', 'x', '0'};
+    for (int p = 0; p < 3; p++) {
+        for (int i = 0; i < glyphCount; i++) {
+            if (glyphs[i].value == probes[p] && glyphs[i].image.height > 0) {
+                return (float) (glyphs[i].offsetY + glyphs[i].image.height);
+            }
+        }
+    }
+    return fontSize * 0.8f;
+}
+
+// Shears every glyph around the baseline; the images are the 8-bit grayscale ones LoadFontData returns
+static void SlantGlyphs(GlyphInfo* glyphs, int glyphCount, int fontSize) {
+    float baseline = FindBaseline(glyphs, glyphCount, fontSize);
+
+    for (int i = 0; i < glyphCount; i++) {
+        Image* image = &glyphs[i].image;
+        if (!image->data || image->width == 0 || image->height == 0) continue;
+
+        float topShift = (baseline - glyphs[i].offsetY) * BAKE_OBLIQUE_SLANT;
+        float bottomShift = (baseline - glyphs[i].offsetY - image->height + 1) * BAKE_OBLIQUE_SLANT;
+        int minShift = (int) floorf(bottomShift);
+        int width = image->width + (int) ceilf(topShift) - minShift + 1;
+
+        const unsigned char* src = (const unsigned char*) image->data;
+        unsigned char* dst = (unsigned char*) RL_CALLOC((size_t) width * image->height, 1);
+        for (int y = 0; y < image->height; y++) {
+            float shift = (baseline - glyphs[i].offsetY - y) * BAKE_OBLIQUE_SLANT - minShift;
+            int whole = (int) floorf(shift);
+            float frac = shift - whole;
+
+            // each source pixel spreads over two destination pixels
+            unsigned char* row = dst + y * width + whole;
+            for (int x = 0; x < image->width; x++) {
+                float value = src[y * image->width + x];
+                int left = row[x] + (int) (value * (1.0f - frac) + 0.5f);
+                row[x] = (unsigned char) (left > 255 ? 255 : left);
+                row[x + 1] = (unsigned char) (value * frac + 0.5f);
+            }
+        }
+
+        RL_FREE(image->data);
+        image->data = dst;
+        image->width = width;
+        glyphs[i].offsetX += minShift;
+    }
+}
+
+// Replaces every glyph image with its distance field, GLYPH_SDF_SPREAD texels bigger on each side; empty glyphs
+// get one too so every rec can be shrunk back by the same amount
+static void BuildDistanceFields(GlyphInfo* glyphs, int glyphCount) {
+    for (int i = 0; i < glyphCount; i++) {
+        Image* image = &glyphs[i].image;
+        int width = image->data ? image->width : 0;
+        int height = image->data ? image->height : 0;
+        int fieldWidth = width + 2 * GLYPH_SDF_SPREAD;
+        int fieldHeight = height + 2 * GLYPH_SDF_SPREAD;
+
+        unsigned char* field = (unsigned char*) RL_CALLOC((size_t) fieldWidth * fieldHeight, 1);
+        BuildGlyphDistanceField((const unsigned char*) image->data, width, height, width, GLYPH_SDF_SPREAD, field);
+
+        RL_FREE(image->data);
+        image->data = field;
+        image->width = fieldWidth;
+        image->height = fieldHeight;
+        image->format = PIXELFORMAT_UNCOMPRESSED_GRAYSCALE;
+        image->mipmaps = 1;
+    }
+}
+
+static Bool BakeFace(const FaceSpec* spec, int* codepoints, int codepointCount, BakedFace* out) {
+    int dataSize = 0;
+    unsigned char* fontData = LoadFileData(spec->path, &dataSize);
+    if (!fontData) {
+        printf("Failed to open %s\n", spec->path);
+        return FALSE;
+    }
+
+    GlyphInfo* glyphs = LoadFontData(fontData, dataSize, spec->fontSize, codepoints, codepointCount, FONT_DEFAULT);
+    UnloadFileData(fontData);
+    if (!glyphs) {
+        printf("Failed to rasterize %s\n", spec->path);
+        return FALSE;
+    }
+    if (spec->oblique) {
+        SlantGlyphs(glyphs, codepointCount, spec->fontSize);
+    }
+    if (spec->distanceField) {
+        BuildDistanceFields(glyphs, codepointCount);
+    }
+
+    // skyline packing, the CJK range is too big for raylib's default row packer to stay compact
+    Rectangle* recs = NULL;
+    Image atlas = GenImageFontAtlas(glyphs, &recs, codepointCount, spec->fontSize, BAKE_GLYPH_PADDING, 1);
+    if (!atlas.data || atlas.width > 0xFFFF || atlas.height > 0xFFFF) {
+        printf("Failed to pack %s at %dpx\n", spec->path, spec->fontSize);
+        UnloadFontData(glyphs, codepointCount);
+        UnloadImage(atlas);
+        RL_FREE(recs);
+        return FALSE;
+    }
+
+    *out = (BakedFace){
+            .spec = *spec,
+            .glyphs = glyphs,
+            .recs = recs,
+            .glyphCount = codepointCount,
+            .atlas = atlas,
+    };
+    return TRUE;
+}
+
+static void UnloadBakedFace(BakedFace* face) {
+    UnloadFontData(face->glyphs, face->glyphCount);
+    RL_FREE(face->recs);
+    UnloadImage(face->atlas);
+}
+
+static unsigned char* SerializeFontBundle(const BakedFace* faces, int faceCount, size_t* outLength) {
+    size_t length = sizeof(FontBundleHeader) + faceCount * sizeof(FontBundleFace);
+    for (int i = 0; i < faceCount; i++) {
+        length += faces[i].glyphCount * sizeof(FontBundleGlyph);
+        length += (size_t) faces[i].atlas.width * faces[i].atlas.height;
+    }
+
+    unsigned char* bundle = (unsigned char*) calloc(1, length);
+    size_t cursor = sizeof(FontBundleHeader) + faceCount * sizeof(FontBundleFace);
+
+    for (int i = 0; i < faceCount; i++) {
+        const BakedFace* baked = &faces[i];
+        // distance field recs are stored without their falloff, the runtime copies it along
+        int spread = baked->spec.distanceField ? GLYPH_SDF_SPREAD : 0;
+        FontBundleFace face = {
+                .fontId = (uint16_t) baked->spec.fontId,
+                .baseSize = (uint16_t) baked->spec.fontSize,
+                .glyphPadding = BAKE_GLYPH_PADDING,
+                .atlasWidth = (uint16_t) baked->atlas.width,
+                .atlasHeight = (uint16_t) baked->atlas.height,
+                .distanceFieldSpread = (uint16_t) spread,
+                .glyphCount = (uint32_t) baked->glyphCount,
+        };
+
+        face.glyphOffset = (uint32_t) cursor;
+        for (int g = 0; g < baked->glyphCount; g++) {
+            FontBundleGlyph glyph = {
+                    .codepoint = baked->glyphs[g].value,
+                    .offsetX = (int16_t) baked->glyphs[g].offsetX,
+                    .offsetY = (int16_t) baked->glyphs[g].offsetY,
+                    .advanceX = (int16_t) baked->glyphs[g].advanceX,
+                    .x = (uint16_t) (baked->recs[g].x + spread),
+                    .y = (uint16_t) (baked->recs[g].y + spread),
+                    .width = (uint16_t) (baked->recs[g].width - 2 * spread),
+                    .height = (uint16_t) (baked->recs[g].height - 2 * spread),
+            };
+            memcpy(bundle + cursor, &glyph, sizeof(glyph));
+            cursor += sizeof(glyph);
+        }
+
+        // raylib hands back gray + alpha with the coverage (or distance) in alpha, keep just that
+        face.pixelOffset = (uint32_t) cursor;
+        const unsigned char* pixels = (const unsigned char*) baked->atlas.data;
+        int pixelCount = baked->atlas.width * baked->atlas.height;
+        for (int p = 0; p < pixelCount; p++) {
+            bundle[cursor++] = pixels[p * 2 + 1];
+        }
+
+        memcpy(bundle + sizeof(FontBundleHeader) + i * sizeof(FontBundleFace), &face, sizeof(face));
+    }
+
+    FontBundleHeader header = {
+            .magic = FONT_BUNDLE_MAGIC,
+            .version = FONT_BUNDLE_VERSION,
+            .headerSize = sizeof(FontBundleHeader),
+            .faceCount = (uint32_t) faceCount,
+            .checksum = HashBytes(bundle + sizeof(FontBundleHeader), length - sizeof(FontBundleHeader)),
+    };
+    memcpy(bundle, &header, sizeof(header));
+
+    *outLength = length;
+    return bundle;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        printf("usage: %s <fonts.txt> <glyph_range.txt> <out.bundle>\n", argv[0]);
+        return 1;
+    }
+
+    SetTraceLogLevel(LOG_WARNING);
+
+    FaceSpec specs[FONT_BUNDLE_MAX_FACES];
+    int faceCount = ReadManifest(argv[1], specs, FONT_BUNDLE_MAX_FACES);
+    if (faceCount <= 0) {
+        return 1;
+    }
+
+    size_t rangeLength = 0;
+    char* glyphRange = (char*) ReadFile(argv[2], &rangeLength);
+    if (!glyphRange) {
+        printf("Failed to open %s\n", argv[2]);
+        return 1;
+    }
+    int codepointCount = 0;
+    int* codepoints = LoadCodepoints(glyphRange, &codepointCount);
+    free(glyphRange);
+
+    BakedFace faces[FONT_BUNDLE_MAX_FACES];
+    int baked = 0;
+    for (int i = 0; i < faceCount; i++) {
+        if (!BakeFace(&specs[i], codepoints, codepointCount, &faces[baked])) {
+            break;
+        }
+        printf("slot %d: %s at %dpx%s%s, %d glyphs in %dx%d\n", specs[i].fontId, specs[i].path, specs[i].fontSize,
+               specs[i].oblique ? " oblique" : "", specs[i].distanceField ? " sdf" : "", codepointCount,
+               faces[baked].atlas.width, faces[baked].atlas.height);
+        baked++;
+    }
+    UnloadCodepoints(codepoints);
+
+    Bool written = FALSE;
+    if (baked == faceCount) {
+        size_t length = 0;
+        unsigned char* bundle = SerializeFontBundle(faces, baked, &length);
+
+        // make sure the runtime will accept what we're about to ship
+        if (ValidateFontBundle(bundle, length)) {
+            FILE* out = fopen(argv[3], "wb");
+            written = out && fwrite(bundle, 1, length, out) == length;
+            if (out) fclose(out);
+            printf(written ? "%s: %zu bytes\n" : "Failed to write %s (%zu bytes)\n", argv[3], length);
+        }
+        free(bundle);
+    }
+
+    for (int i = 0; i < baked; i++) {
+        UnloadBakedFace(&faces[i]);
+    }
+    return written ? 0 : 1;
+}
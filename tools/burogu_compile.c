@@ -0,0 +1,140 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binary_document.h"
+#include "markdown.h"
+#include "preprocess.h"
+
+// Compiles posts into binary documents ahead of time, so the runtime loads them without running cmark.
+//   burogu_compile <post.md> [out.bdoc]
+//   burogu_compile <directory>            every .md in it, written next to the source
+
+static char* ReadFile(const char* path, size_t* outLength) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buffer = (char*) malloc(fileSize + 1);
+    size_t read = fread(buffer, 1, fileSize, file);
+    buffer[read] = '\0';
+    fclose(file);
+
+    *outLength = read;
+    return buffer;
+}
+
+static Bool CompilePost(const char* inputPath, const char* outputPath) {
+    size_t rawLength = 0;
+    char* raw = ReadFile(inputPath, &rawLength);
+    if (!raw) {
+        printf("Failed to open %s\n", inputPath);
+        return FALSE;
+    }
+
+    // same pipeline as a fetched post at runtime
+    size_t sourceLength = 0;
+    char* source = PreprocessMarkdown(raw, rawLength, &sourceLength);
+    free(raw);
+
+    MarkdownDocument document = AdoptMarkdownDocument(source, sourceLength);
+    if (!document.commands) {
+        printf("Failed to parse %s\n", inputPath);
+        FreeMarkdownDocument(&document);
+        return FALSE;
+    }
+
+    size_t blobLength = 0;
+    char* blob = SerializeMarkdownDocument(&document, &blobLength);
+
+    // make sure the runtime will accept what we're about to ship
+    char* check = (char*) malloc(blobLength);
+    memcpy(check, blob, blobLength);
+    MarkdownDocument loaded;
+    if (!LoadBinaryDocument(check, blobLength, &loaded)) {
+        printf("Compiled %s doesn't load back\n", inputPath);
+        free(check);
+        free(blob);
+        FreeMarkdownDocument(&document);
+        return FALSE;
+    }
+    FreeMarkdownDocument(&loaded);
+
+    FILE* out = fopen(outputPath, "wb");
+    Bool written = out && fwrite(blob, 1, blobLength, out) == blobLength;
+    if (out) fclose(out);
+
+    if (written) {
+        printf("%s -> %s: %zu -> %zu bytes, %d commands, %d styles\n",
+               inputPath, outputPath, rawLength, blobLength, document.commandCount, document.styleCount);
+    } else {
+        printf("Failed to write %s\n", outputPath);
+    }
+
+    free(blob);
+    FreeMarkdownDocument(&document);
+    return written;
+}
+
+static void ReplaceExtension(const char* path, char* out, size_t outSize) {
+    snprintf(out, outSize, "%s", path);
+    char* dot = strrchr(out, '.');
+    char* slash = strrchr(out, '/');
+    if (dot && (!slash || dot > slash)) {
+        *dot = '\0';
+    }
+    strncat(out, BINARY_DOCUMENT_EXTENSION, outSize - strlen(out) - 1);
+}
+
+static int CompileDirectory(const char* directory) {
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        return -1;
+    }
+
+    int failures = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t nameLength = strlen(entry->d_name);
+        if (nameLength < 3 || strcmp(entry->d_name + nameLength - 3, ".md") != 0) {
+            continue;
+        }
+
+        char inputPath[1024];
+        char outputPath[1024];
+        snprintf(inputPath, sizeof(inputPath), "%s/%s", directory, entry->d_name);
+        ReplaceExtension(inputPath, outputPath, sizeof(outputPath));
+        if (!CompilePost(inputPath, outputPath)) {
+            failures++;
+        }
+    }
+
+    closedir(dir);
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("usage: %s <post.md> [out%s] | <directory>\n", argv[0], BINARY_DOCUMENT_EXTENSION);
+        return 1;
+    }
+
+    int failures = CompileDirectory(argv[1]);
+    if (failures >= 0) {
+        return failures == 0 ? 0 : 1;
+    }
+
+    char outputPath[1024];
+    if (argc >= 3) {
+        snprintf(outputPath, sizeof(outputPath), "%s", argv[2]);
+    } else {
+        ReplaceExtension(argv[1], outputPath, sizeof(outputPath));
+    }
+    return CompilePost(argv[1], outputPath) ? 0 : 1;
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 typedef unsigned char Bool;
 #ifndef TRUE
 #define TRUE 1
@@ -69,4 +73,25 @@ typedef unsigned char Bool;
     } while (0)
 
 #define STACK_TOP(arr) \
-    ((arr##_count > 0) ? &arr[arr##_count - 1] : NULL)
\ No newline at end of file
+    ((arr##_count > 0) ? &arr[arr##_count - 1] : NULL)
+
+// FNV-1a style hash that consumes 8 bytes per step; good enough for cache keys, not for anything adversarial
+static inline uint64_t HashBytes(const void* data, size_t length) {
+    const unsigned char* bytes = (const unsigned char*) data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        hash = (hash ^ word) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+        bytes += 8;
+        length -= 8;
+    }
+    while (length > 0) {
+        hash = (hash ^ *bytes++) * 0x100000001b3ull;
+        length--;
+    }
+
+    return hash ^ (hash >> 32);
+}